@@ -0,0 +1,317 @@
+#include "bbo.hpp"
+
+namespace orderbook {
+namespace bbo {
+
+    namespace {
+
+        // Rows found in a block, as a bit each from its first row
+        inline void Emit(unsigned bits, std::size_t row, InstrumentID * out, std::size_t capacity, std::size_t & found) {
+            while (bits) {
+                if (found < capacity) {
+                    out[found] = static_cast<InstrumentID>(row + static_cast<std::size_t>(__builtin_ctz(bits)));
+                }
+                ++found;
+                bits &= bits - 1;
+            }
+        }
+
+        std::size_t CrossedScalar(const Tick * bids, const Tick * asks, std::size_t rows, bool locked, InstrumentID * out, std::size_t capacity) {
+            std::size_t found{0};
+            for (std::size_t row = 0; row < rows; ++row) {
+                Emit(bids[row] > asks[row] || (locked && bids[row] == asks[row]), row, out, capacity, found);
+            }
+            return found;
+        }
+
+        std::size_t WiderScalar(const Tick * bids, const Tick * asks, std::size_t rows, Tick spread, InstrumentID * out, std::size_t capacity) {
+            std::size_t found{0};
+            for (std::size_t row = 0; row < rows; ++row) {
+                Emit(bids[row] != BboTable::NO_BID && asks[row] != BboTable::NO_ASK && asks[row] - bids[row] > spread, row, out, capacity, found);
+            }
+            return found;
+        }
+
+        std::size_t MovedScalar(const uint64_t * updated, std::size_t rows, uint64_t sequence, InstrumentID * out, std::size_t capacity) {
+            std::size_t found{0};
+            for (std::size_t row = 0; row < rows; ++row) {
+                Emit(updated[row] > sequence, row, out, capacity, found);
+            }
+            return found;
+        }
+
+        void StatsScalar(const Tick * bids, const Tick * asks, std::size_t rows, BboStats & stats) {
+            for (std::size_t row = 0; row < rows; ++row) {
+                auto bid = bids[row] != BboTable::NO_BID;
+                auto ask = asks[row] != BboTable::NO_ASK;
+                if (bid && ask) {
+                    ++stats.twoSided_;
+                    stats.crossed_ += bids[row] > asks[row];
+                    stats.locked_ += bids[row] == asks[row];
+                    stats.spread_ += bids[row] < asks[row] ? asks[row] - bids[row] : 0;
+                } else {
+                    stats.oneSided_ += bid || ask;
+                }
+            }
+        }
+
+#ifdef ORDERBOOK_X86
+
+        using simd::Sum;
+
+        __attribute__((target("sse4.2")))
+        unsigned Mask(__m128i v) {
+            return static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(v)));
+        }
+
+        __attribute__((target("avx2")))
+        unsigned Mask(__m256i v) {
+            return static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(v)));
+        }
+
+        __attribute__((target("sse4.2")))
+        std::size_t CrossedSse(const Tick * bids, const Tick * asks, std::size_t rows, bool locked, InstrumentID * out, std::size_t capacity) {
+            std::size_t found{0};
+            for (std::size_t row = 0; row < rows; row += 2) {
+                auto bid = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bids + row));
+                auto ask = _mm_loadu_si128(reinterpret_cast<const __m128i *>(asks + row));
+                auto hit = _mm_cmpgt_epi64(bid, ask);
+                if (locked) {
+                    hit = _mm_or_si128(hit, _mm_cmpeq_epi64(bid, ask));
+                }
+                Emit(Mask(hit), row, out, capacity, found);
+            }
+            return found;
+        }
+
+        __attribute__((target("avx2")))
+        std::size_t CrossedAvx2(const Tick * bids, const Tick * asks, std::size_t rows, bool locked, InstrumentID * out, std::size_t capacity) {
+            std::size_t found{0};
+            for (std::size_t row = 0; row < rows; row += 4) {
+                auto bid = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bids + row));
+                auto ask = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(asks + row));
+                auto hit = _mm256_cmpgt_epi64(bid, ask);
+                if (locked) {
+                    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi64(bid, ask));
+                }
+                if (!_mm256_testz_si256(hit, hit)) {
+                    Emit(Mask(hit), row, out, capacity, found);
+                }
+            }
+            _mm256_zeroupper();
+            return found;
+        }
+
+        // Empty sides are masked out, the difference they make having wrapped around
+        __attribute__((target("sse4.2")))
+        std::size_t WiderSse(const Tick * bids, const Tick * asks, std::size_t rows, Tick spread, InstrumentID * out, std::size_t capacity) {
+            auto noBid = _mm_set1_epi64x(BboTable::NO_BID);
+            auto noAsk = _mm_set1_epi64x(BboTable::NO_ASK);
+            auto limit = _mm_set1_epi64x(spread);
+            std::size_t found{0};
+            for (std::size_t row = 0; row < rows; row += 2) {
+                auto bid = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bids + row));
+                auto ask = _mm_loadu_si128(reinterpret_cast<const __m128i *>(asks + row));
+                auto empty = _mm_or_si128(_mm_cmpeq_epi64(bid, noBid), _mm_cmpeq_epi64(ask, noAsk));
+                auto hit = _mm_andnot_si128(empty, _mm_cmpgt_epi64(_mm_sub_epi64(ask, bid), limit));
+                Emit(Mask(hit), row, out, capacity, found);
+            }
+            return found;
+        }
+
+        __attribute__((target("avx2")))
+        std::size_t WiderAvx2(const Tick * bids, const Tick * asks, std::size_t rows, Tick spread, InstrumentID * out, std::size_t capacity) {
+            auto noBid = _mm256_set1_epi64x(BboTable::NO_BID);
+            auto noAsk = _mm256_set1_epi64x(BboTable::NO_ASK);
+            auto limit = _mm256_set1_epi64x(spread);
+            std::size_t found{0};
+            for (std::size_t row = 0; row < rows; row += 4) {
+                auto bid = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bids + row));
+                auto ask = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(asks + row));
+                auto empty = _mm256_or_si256(_mm256_cmpeq_epi64(bid, noBid), _mm256_cmpeq_epi64(ask, noAsk));
+                auto hit = _mm256_andnot_si256(empty, _mm256_cmpgt_epi64(_mm256_sub_epi64(ask, bid), limit));
+                if (!_mm256_testz_si256(hit, hit)) {
+                    Emit(Mask(hit), row, out, capacity, found);
+                }
+            }
+            _mm256_zeroupper();
+            return found;
+        }
+
+        // Sequences stay far below 2^63, so they compare as signed
+        __attribute__((target("sse4.2")))
+        std::size_t MovedSse(const uint64_t * updated, std::size_t rows, uint64_t sequence, InstrumentID * out, std::size_t capacity) {
+            auto since = _mm_set1_epi64x(static_cast<long long>(sequence));
+            std::size_t found{0};
+            for (std::size_t row = 0; row < rows; row += 2) {
+                auto hit = _mm_cmpgt_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i *>(updated + row)), since);
+                Emit(Mask(hit), row, out, capacity, found);
+            }
+            return found;
+        }
+
+        __attribute__((target("avx2")))
+        std::size_t MovedAvx2(const uint64_t * updated, std::size_t rows, uint64_t sequence, InstrumentID * out, std::size_t capacity) {
+            auto since = _mm256_set1_epi64x(static_cast<long long>(sequence));
+            std::size_t found{0};
+            for (std::size_t row = 0; row < rows; row += 4) {
+                auto hit = _mm256_cmpgt_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(updated + row)), since);
+                if (!_mm256_testz_si256(hit, hit)) {
+                    Emit(Mask(hit), row, out, capacity, found);
+                }
+            }
+            _mm256_zeroupper();
+            return found;
+        }
+
+        // Counts are kept a lane at a time by subtracting the all ones of each match
+        __attribute__((target("sse4.2")))
+        void StatsSse(const Tick * bids, const Tick * asks, std::size_t rows, BboStats & stats) {
+            auto noBid = _mm_set1_epi64x(BboTable::NO_BID);
+            auto noAsk = _mm_set1_epi64x(BboTable::NO_ASK);
+            auto zero = _mm_setzero_si128();
+            auto twoSided = zero, oneSided = zero, crossed = zero, locked = zero, spread = zero;
+            for (std::size_t row = 0; row < rows; row += 2) {
+                auto bid = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bids + row));
+                auto ask = _mm_loadu_si128(reinterpret_cast<const __m128i *>(asks + row));
+                auto hasBid = _mm_xor_si128(_mm_cmpeq_epi64(bid, noBid), _mm_set1_epi64x(-1));
+                auto hasAsk = _mm_xor_si128(_mm_cmpeq_epi64(ask, noAsk), _mm_set1_epi64x(-1));
+                auto both = _mm_and_si128(hasBid, hasAsk);
+                auto difference = _mm_sub_epi64(ask, bid);
+                auto open = _mm_and_si128(both, _mm_cmpgt_epi64(difference, zero));
+                twoSided = _mm_sub_epi64(twoSided, both);
+                oneSided = _mm_sub_epi64(oneSided, _mm_xor_si128(hasBid, hasAsk));
+                crossed = _mm_sub_epi64(crossed, _mm_and_si128(both, _mm_cmpgt_epi64(bid, ask)));
+                locked = _mm_sub_epi64(locked, _mm_and_si128(both, _mm_cmpeq_epi64(bid, ask)));
+                spread = _mm_add_epi64(spread, _mm_and_si128(open, difference));
+            }
+            stats.twoSided_ += static_cast<std::size_t>(Sum(twoSided));
+            stats.oneSided_ += static_cast<std::size_t>(Sum(oneSided));
+            stats.crossed_ += static_cast<std::size_t>(Sum(crossed));
+            stats.locked_ += static_cast<std::size_t>(Sum(locked));
+            stats.spread_ += Sum(spread);
+        }
+
+        __attribute__((target("avx2")))
+        void StatsAvx2(const Tick * bids, const Tick * asks, std::size_t rows, BboStats & stats) {
+            auto noBid = _mm256_set1_epi64x(BboTable::NO_BID);
+            auto noAsk = _mm256_set1_epi64x(BboTable::NO_ASK);
+            auto ones = _mm256_set1_epi64x(-1);
+            auto zero = _mm256_setzero_si256();
+            auto twoSided = zero, oneSided = zero, crossed = zero, locked = zero, spread = zero;
+            for (std::size_t row = 0; row < rows; row += 4) {
+                auto bid = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bids + row));
+                auto ask = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(asks + row));
+                auto hasBid = _mm256_xor_si256(_mm256_cmpeq_epi64(bid, noBid), ones);
+                auto hasAsk = _mm256_xor_si256(_mm256_cmpeq_epi64(ask, noAsk), ones);
+                auto both = _mm256_and_si256(hasBid, hasAsk);
+                auto difference = _mm256_sub_epi64(ask, bid);
+                auto open = _mm256_and_si256(both, _mm256_cmpgt_epi64(difference, zero));
+                twoSided = _mm256_sub_epi64(twoSided, both);
+                oneSided = _mm256_sub_epi64(oneSided, _mm256_xor_si256(hasBid, hasAsk));
+                crossed = _mm256_sub_epi64(crossed, _mm256_and_si256(both, _mm256_cmpgt_epi64(bid, ask)));
+                locked = _mm256_sub_epi64(locked, _mm256_and_si256(both, _mm256_cmpeq_epi64(bid, ask)));
+                spread = _mm256_add_epi64(spread, _mm256_and_si256(open, difference));
+            }
+            stats.twoSided_ += static_cast<std::size_t>(Sum(twoSided));
+            stats.oneSided_ += static_cast<std::size_t>(Sum(oneSided));
+            stats.crossed_ += static_cast<std::size_t>(Sum(crossed));
+            stats.locked_ += static_cast<std::size_t>(Sum(locked));
+            stats.spread_ += Sum(spread);
+            _mm256_zeroupper();
+        }
+
+#endif
+
+        struct Kernels {
+            Isa isa_;
+            std::size_t (*crossed_)(const Tick *, const Tick *, std::size_t, bool, InstrumentID *, std::size_t);
+            std::size_t (*wider_)(const Tick *, const Tick *, std::size_t, Tick, InstrumentID *, std::size_t);
+            std::size_t (*moved_)(const uint64_t *, std::size_t, uint64_t, InstrumentID *, std::size_t);
+            void (*stats_)(const Tick *, const Tick *, std::size_t, BboStats &);
+        };
+
+        Kernels Select(Isa isa) {
+#ifdef ORDERBOOK_X86
+            switch (isa) {
+                case Isa::AVX2: return Kernels{isa, CrossedAvx2, WiderAvx2, MovedAvx2, StatsAvx2};
+                case Isa::SSE42: return Kernels{isa, CrossedSse, WiderSse, MovedSse, StatsSse};
+                case Isa::SCALAR: break;
+            }
+#endif
+            return Kernels{Isa::SCALAR, CrossedScalar, WiderScalar, MovedScalar, StatsScalar};
+        }
+
+        simd::Dispatch<Kernels, Select> active;
+
+    } // namespace
+
+    Isa Active() {
+        return active.Active();
+    }
+
+    bool Use(Isa isa) {
+        return active.Use(isa);
+    }
+
+} // namespace bbo
+
+    BboTable::BboTable(std::size_t capacity)
+        : capacity_(capacity),
+          bids_((capacity + BLOCK - 1) / BLOCK * BLOCK, NO_BID),
+          asks_(bids_.size(), NO_ASK),
+          bidVolumes_(bids_.size(), 0),
+          askVolumes_(bids_.size(), 0),
+          updated_(bids_.size(), 0) {
+    }
+
+    void BboTable::Set(InstrumentID instrument, Tick bid, int64_t bidVolume, Tick ask, int64_t askVolume) {
+        if (instrument >= capacity_) {
+            return;
+        }
+        if (bids_[instrument] == bid && asks_[instrument] == ask && bidVolumes_[instrument] == bidVolume && askVolumes_[instrument] == askVolume) {
+            return;
+        }
+        bids_[instrument] = bid;
+        asks_[instrument] = ask;
+        bidVolumes_[instrument] = bidVolume;
+        askVolumes_[instrument] = askVolume;
+        updated_[instrument] = ++sequence_;
+    }
+
+    void BboTable::Clear() {
+        for (std::size_t instrument = 0; instrument < capacity_; ++instrument) {
+            Set(static_cast<InstrumentID>(instrument), NO_BID, 0, NO_ASK, 0);
+        }
+    }
+
+    Bbo BboTable::Get(InstrumentID instrument) const {
+        if (instrument >= capacity_) {
+            return Bbo{NO_BID, 0, NO_ASK, 0, 0};
+        }
+        return Bbo{bids_[instrument], bidVolumes_[instrument], asks_[instrument], askVolumes_[instrument], updated_[instrument]};
+    }
+
+    std::size_t BboTable::Crossed(InstrumentID * out, std::size_t capacity, bool locked) const {
+        return bbo::active->crossed_(bids_.data(), asks_.data(), bids_.size(), locked, out, capacity);
+    }
+
+    std::size_t BboTable::WiderThan(Tick spread, InstrumentID * out, std::size_t capacity) const {
+        return bbo::active->wider_(bids_.data(), asks_.data(), bids_.size(), spread, out, capacity);
+    }
+
+    std::size_t BboTable::MovedSince(uint64_t sequence, InstrumentID * out, std::size_t capacity) const {
+        return bbo::active->moved_(updated_.data(), updated_.size(), sequence, out, capacity);
+    }
+
+    BboStats BboTable::Statistics() const {
+        BboStats stats;
+        bbo::active->stats_(bids_.data(), asks_.data(), bids_.size(), stats);
+        return stats;
+    }
+
+    std::size_t BboTable::Bytes() const {
+        return bids_.capacity() * (2 * sizeof(Tick) + 2 * sizeof(int64_t) + sizeof(uint64_t));
+    }
+
+} // namespace orderbook
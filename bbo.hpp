@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "price.hpp"
+#include "simd.hpp"
+#include "symbols.hpp"
+
+namespace orderbook {
+namespace bbo {
+
+    // The scans below run on whichever simd::Isa is active, the widest supported to start with
+    using Isa = simd::Isa;
+
+    Isa Active();
+    bool Use(Isa isa);
+
+} // namespace bbo
+
+    // One instrument's best bid and offer
+    struct Bbo {
+        Tick BidPrice_;
+        int64_t BidVolume_;
+        Tick AskPrice_;
+        int64_t AskVolume_;
+        uint64_t Sequence_;         // The table's sequence when it last changed, 0 if it never has
+    };
+
+    // Counts over the whole market, for end of interval statistics
+    struct BboStats {
+        std::size_t twoSided_{0};
+        std::size_t oneSided_{0};
+        std::size_t crossed_{0};    // Two sided with the bid above the ask
+        std::size_t locked_{0};     // Two sided with the bid at the ask
+        int64_t spread_{0};         // Total spread in ticks of the two sided books that are neither
+
+        double MeanSpread() const {
+            auto open = twoSided_ - crossed_ - locked_;
+            return open ? static_cast<double>(spread_) / static_cast<double>(open) : 0.0;
+        }
+    };
+
+    // Every instrument's best bid and offer in one contiguous table indexed by InstrumentID, held as a
+    // structure of arrays so that questions about the whole market are vectorised sweeps over a
+    // column or two rather than a visit to each security's levels. An empty side holds NO_BID or
+    // NO_ASK, which never compare as crossed. Each change takes the next sequence, so the instruments
+    // that moved over an interval are those updated after the sequence it started at.
+    //
+    // The capacity is fixed at construction, with instruments beyond it not kept. Only the book thread
+    // may use the table, so scans run between messages.
+    class BboTable {
+        public:
+            static constexpr Tick NO_BID = std::numeric_limits<Tick>::min();
+            static constexpr Tick NO_ASK = std::numeric_limits<Tick>::max();
+
+            explicit BboTable(std::size_t capacity);
+
+            std::size_t Capacity() const { return capacity_; }
+            // Changes so far, the sequence the latest one took
+            uint64_t Sequence() const { return sequence_; }
+
+            // Sets an instrument's best prices and volumes, a change only if they differ from what it held
+            void Set(InstrumentID instrument, Tick bid, int64_t bidVolume, Tick ask, int64_t askVolume);
+            // Empties every instrument, each that held a price counting as a change
+            void Clear();
+            Bbo Get(InstrumentID instrument) const;
+
+            // Each scan writes the instruments it finds, in InstrumentID order, to out until capacity is
+            // reached, and returns how many it found in all
+            std::size_t Crossed(InstrumentID * out, std::size_t capacity, bool locked = false) const;
+            std::size_t WiderThan(Tick spread, InstrumentID * out, std::size_t capacity) const;
+            std::size_t MovedSince(uint64_t sequence, InstrumentID * out, std::size_t capacity) const;
+            BboStats Statistics() const;
+
+            std::size_t Bytes() const;
+
+        private:
+            // Rows are padded to whole blocks of empty ones, so the scans never have a tail to finish
+            static constexpr std::size_t BLOCK = 4;
+
+            std::size_t capacity_;
+            uint64_t sequence_{0};
+            std::vector<Tick> bids_;
+            std::vector<Tick> asks_;
+            std::vector<int64_t> bidVolumes_;
+            std::vector<int64_t> askVolumes_;
+            std::vector<uint64_t> updated_;
+    };
+
+} // namespace orderbook
@@ -0,0 +1,537 @@
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "engine.hpp"
+#include "generator.hpp"
+#include "orderbook.hpp"
+
+// Measures Implementation::Process, Top and Get on a synthetic market at a range of security counts.
+// Each scale builds a fresh book, fills it to its working size, then replays a pregenerated stream:
+// the first half untimed per message for throughput, the second half timed per message for latency.
+// Matching is measured separately, with aggressive orders that sweep a given number of levels.
+// With -a the depth analytics a risk check runs are timed both by walking levels through Get and with
+// the vectorised kernels over the depth arrays. With -s the whole market BBO scans are timed on every
+// instruction set the CPU supports. With -e the engine's throughput is measured on the same stream with
+// 1 up to the given number of shards.
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        std::vector<std::size_t> scales_{1000, 1000000};
+        std::size_t messages_{2000000};
+        std::size_t orders_{0};         // Live orders, or 0 to scale with the number of securities
+        std::size_t queries_{200000};
+        uint64_t seed_{1};
+        std::size_t batch_{0};          // Messages per ProcessBatch call in the throughput run, 0 for Process
+        bool coalesce_{false};
+        bool deltas_{false};            // Publish level deltas during the throughput run
+        bool conflate_{false};
+        bool quotes_{false};            // Publish top of book snapshots during the throughput run
+        bool depth_{false};             // Keep depth arrays from the throughput run on and time queries on them
+        int64_t fill_{20000};           // Quantity the cost to fill and VWAP queries fill
+        std::string isa_;               // Depth kernels to use, the widest supported if empty
+        bool scans_{false};             // Keep a BBO table from the throughput run on and time scans over it
+        std::vector<std::size_t> sweeps_{1, 10, 100, 1000};   // Levels each aggressive order sweeps
+        std::size_t perLevel_{4};                               // Resting orders at each swept level
+        std::size_t shards_{0};         // Time the engine with 1 up to this many shards, 0 for none
+    };
+
+    struct Percentiles {
+        std::size_t count_{0};
+        double p50_{0}, p90_{0}, p99_{0}, p999_{0}, max_{0};
+    };
+
+    Percentiles Summarise(std::vector<double> & samples) {
+        Percentiles result;
+        result.count_ = samples.size();
+        if (samples.empty()) {
+            return result;
+        }
+        std::sort(samples.begin(), samples.end());
+        auto at = [&samples] (double q) { return samples[static_cast<std::size_t>(q * (samples.size() - 1))]; };
+        result.p50_ = at(0.5);
+        result.p90_ = at(0.9);
+        result.p99_ = at(0.99);
+        result.p999_ = at(0.999);
+        result.max_ = samples.back();
+        return result;
+    }
+
+    void PrintRow(const std::string & name, std::vector<double> & samples) {
+        auto p = Summarise(samples);
+        std::cout << "  " << std::left << std::setw(8) << name << std::right
+                  << std::setw(10) << p.count_
+                  << std::fixed << std::setprecision(0)
+                  << std::setw(9) << p.p50_ << std::setw(9) << p.p90_ << std::setw(9) << p.p99_
+                  << std::setw(9) << p.p999_ << std::setw(10) << p.max_ << '\n';
+    }
+
+    double Nanos(Clock::time_point start, Clock::time_point end) {
+        return std::chrono::duration<double, std::nano>(end - start).count();
+    }
+
+    long PeakRssMB() {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss / 1024;
+    }
+
+    // Times each scan over the whole table with every instruction set, the instruments that moved being
+    // those the latency run changed
+    void Scan(const orderbook::BboTable & table, uint64_t interval) {
+        using namespace orderbook;
+
+        std::vector<InstrumentID> found(table.Capacity());
+        auto repeats = std::max<std::size_t>(5, 20000000 / std::max<std::size_t>(1, table.Capacity()));
+        auto time = [repeats] (auto && scan) {
+            std::size_t matches{0};
+            auto start = Clock::now();
+            for (std::size_t i = 0; i < repeats; ++i) {
+                matches = scan();
+            }
+            return std::make_pair(Nanos(start, Clock::now()) / static_cast<double>(repeats) / 1e3, matches);
+        };
+
+        auto isa = bbo::Active();
+        std::cout << "  " << std::left << std::setw(8) << "scan us" << std::right << std::setw(10) << "crossed"
+                  << std::setw(10) << "locked" << std::setw(10) << "wide" << std::setw(10) << "moved" << std::setw(10) << "stats" << '\n';
+        for (auto kernels : {bbo::Isa::SCALAR, bbo::Isa::SSE42, bbo::Isa::AVX2}) {
+            if (!bbo::Use(kernels)) {
+                continue;
+            }
+            auto crossed = time([&] { return table.Crossed(found.data(), found.size()); });
+            auto locked = time([&] { return table.Crossed(found.data(), found.size(), true); });
+            auto wide = time([&] { return table.WiderThan(20, found.data(), found.size()); });
+            auto moved = time([&] { return table.MovedSince(interval, found.data(), found.size()); });
+            auto stats = time([&] { return table.Statistics().twoSided_; });
+            std::cout << "  " << std::left << std::setw(8) << simd::Name(kernels) << std::right << std::setprecision(1)
+                      << std::setw(10) << crossed.first << std::setw(10) << locked.first << std::setw(10) << wide.first
+                      << std::setw(10) << moved.first << std::setw(10) << stats.first << '\n';
+            if (kernels == bbo::Isa::SCALAR) {
+                std::cout << "  " << std::left << std::setw(8) << "matches" << std::right << std::setw(10) << crossed.second
+                          << std::setw(10) << locked.second << std::setw(10) << wide.second << std::setw(10) << moved.second
+                          << std::setw(10) << stats.second << '\n';
+            }
+        }
+        bbo::Use(isa);
+        std::cout << "  bbo table " << table.Bytes() / (1024 * 1024) << " MB\n";
+    }
+
+    void Run(std::size_t securities, const Options & options) {
+        using namespace orderbook;
+
+        orderbook::GeneratorConfig config;
+        config.seed_ = options.seed_;
+        config.securities_ = securities;
+        config.liveOrders_ = options.orders_ ? options.orders_ : std::max<std::size_t>(100000, securities / 4);
+
+        std::cout << ORDERBOOK_LAYOUT::NAME << " layout, securities " << securities << ", live orders " << config.liveOrders_
+                  << ", messages " << options.messages_ << '\n';
+
+        // Register every security up front, as a securities master would, so ids match the generator's
+        auto setupStart = Clock::now();
+        Implementation book;
+        book.Reserve(securities);
+        book.ReserveOrders(config.liveOrders_ + config.liveOrders_ / 4);
+        for (std::size_t i = 0; i < securities; ++i) {
+            auto symbol = Generator::Symbol(static_cast<InstrumentID>(i));
+            book.Register(symbol.data(), symbol.size());
+        }
+
+        Generator generator(config);
+        for (std::size_t i = 0; i < config.liveOrders_; ++i) {
+            book.Process(generator.Next());
+        }
+        std::cout << "  setup " << std::fixed << std::setprecision(2)
+                  << std::chrono::duration<double>(Clock::now() - setupStart).count() << "s\n";
+
+        std::vector<Message> messages;
+        messages.reserve(options.messages_);
+        for (std::size_t i = 0; i < options.messages_; ++i) {
+            messages.push_back(generator.Next());
+        }
+
+        auto half = messages.size() / 2;
+        std::size_t rejected{0};
+
+        // Nothing reads the ring, the publisher never waits for readers so that doesn't change its cost
+        DeltaPublisher publisher;
+        if (options.deltas_ && publisher.Open("", 1 << 16, options.conflate_) == SUCCESS) {
+            book.PublishDeltas(&publisher);
+        }
+        std::unique_ptr<QuoteBoard> board;
+        std::unique_ptr<DepthBook> view;
+        std::unique_ptr<BboTable> table;
+        if (options.scans_) {
+            table.reset(new BboTable(securities));
+            book.PublishBbo(table.get());
+        }
+        if (options.depth_) {
+            view.reset(new DepthBook);
+            book.PublishDepth(view.get());
+        }
+        if (options.quotes_) {
+            board.reset(new QuoteBoard(securities));
+            book.PublishQuotes(board.get());
+        }
+
+        auto start = Clock::now();
+        if (options.batch_) {
+            for (std::size_t i = 0; i < half; i += options.batch_) {
+                rejected += book.ProcessBatch(&messages[i], std::min(options.batch_, half - i), nullptr, options.coalesce_);
+            }
+        } else {
+            for (std::size_t i = 0; i < half; ++i) {
+                rejected += book.Process(messages[i]) != SUCCESS;
+            }
+        }
+        auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if (options.batch_) {
+            std::cout << "  batches of " << options.batch_ << (options.coalesce_ ? ", coalesced" : "") << '\n';
+        }
+        if (options.deltas_) {
+            std::cout << "  published " << publisher.Published() << " deltas" << (options.conflate_ ? ", conflated" : "") << '\n';
+            book.PublishDeltas(nullptr);
+        }
+        if (options.quotes_) {
+            std::cout << "  published top of book snapshots\n";
+            book.PublishQuotes(nullptr);
+        }
+        if (options.depth_) {
+            std::cout << "  kept depth arrays, " << simd::Name(depth::Active()) << " kernels\n";
+        }
+        std::cout << "  throughput " << std::setprecision(2) << (half / seconds / 1e6) << "M msgs/s ("
+                  << std::setprecision(1) << (seconds * 1e9 / half) << " ns/msg)\n";
+
+        auto interval = table ? table->Sequence() : 0;
+        std::vector<double> adds, modifies, deletes, tops, gets, levels, withins, walks, costs, vwaps, bands;
+        adds.reserve(half);
+        modifies.reserve(half);
+        deletes.reserve(half);
+        for (std::size_t i = half; i < messages.size(); ++i) {
+            const auto & message = messages[i];
+            auto begin = Clock::now();
+            rejected += book.Process(message) != SUCCESS;
+            auto elapsed = Nanos(begin, Clock::now());
+            switch (message.OrderAction_) {
+                case OrderAction_t::Add: adds.push_back(elapsed); break;
+                case OrderAction_t::Modify: modifies.push_back(elapsed); break;
+                case OrderAction_t::Delete: deletes.push_back(elapsed); break;
+            }
+        }
+
+        // Query the securities the feed is busy in, so the popular names dominate as they would in practice
+        std::size_t sink{0};
+        for (std::size_t i = 0; i < options.queries_ && !messages.empty(); ++i) {
+            const auto & message = messages[(i * 7919) % messages.size()];
+            auto direction = (i & 1) ? OrderDirection_t::SELL : OrderDirection_t::BUY;
+
+            auto begin = Clock::now();
+            auto top = book.Top(message.Instrument_, direction);
+            auto middle = Clock::now();
+            auto level = book.Get(message.Instrument_, direction, static_cast<int>(i % 5));
+            auto end = Clock::now();
+
+            sink += (top.first != top.second) + (level.first != level.second);
+            tops.push_back(Nanos(begin, middle));
+            gets.push_back(Nanos(middle, end));
+
+            // The aggregated forms a risk check would use, which read level totals instead of orders
+            Quote quote;
+            begin = Clock::now();
+            auto found = book.LevelAt(message.Instrument_, direction, i % 5, quote);
+            middle = Clock::now();
+            auto volume = book.VolumeWithin(message.Instrument_, direction, 10);
+            end = Clock::now();
+
+            sink += found + (volume != 0);
+            levels.push_back(Nanos(begin, middle));
+            withins.push_back(Nanos(middle, end));
+
+            if (!options.depth_) {
+                continue;
+            }
+
+            // Cost to fill as it was computed before, level by level through Get, then from the depth arrays
+            begin = Clock::now();
+            auto remaining = options.fill_;
+            int64_t walked{0};
+            for (int index = 0; remaining > 0; ++index) {
+                auto level = book.Get(message.Instrument_, direction, index);
+                if (level.first == level.second) {
+                    break;
+                }
+                for (auto it = level.first; it != level.second && remaining > 0; ++it) {
+                    auto take = std::min<int64_t>(it->Volume_, remaining);
+                    walked += it->Price_ * take;
+                    remaining -= take;
+                }
+            }
+            middle = Clock::now();
+            auto side = direction == OrderDirection_t::BUY ? DeltaSide::BID : DeltaSide::ASK;
+            int64_t filled;
+            auto cost = view->CostToFill(message.Instrument_, side, options.fill_, filled);
+            end = Clock::now();
+
+            sink += cost == walked;
+            walks.push_back(Nanos(begin, middle));
+            costs.push_back(Nanos(middle, end));
+
+            begin = Clock::now();
+            auto vwap = view->Vwap(message.Instrument_, side, options.fill_);
+            middle = Clock::now();
+            int64_t band;
+            auto within = view->LevelsWithin(message.Instrument_, side, 10, band);
+            end = Clock::now();
+
+            sink += (vwap != 0) + (within != 0);
+            vwaps.push_back(Nanos(begin, middle));
+            bands.push_back(Nanos(middle, end));
+        }
+
+        std::cout << "  " << std::left << std::setw(8) << "ns" << std::right << std::setw(10) << "count"
+                  << std::setw(9) << "p50" << std::setw(9) << "p90" << std::setw(9) << "p99"
+                  << std::setw(9) << "p99.9" << std::setw(10) << "max" << '\n';
+        PrintRow("add", adds);
+        PrintRow("modify", modifies);
+        PrintRow("delete", deletes);
+        PrintRow("top", tops);
+        PrintRow("get", gets);
+        PrintRow("level", levels);
+        PrintRow("within", withins);
+        if (options.depth_) {
+            PrintRow("walk", walks);
+            PrintRow("cost", costs);
+            PrintRow("vwap", vwaps);
+            PrintRow("band", bands);
+            std::cout << "  depth arrays " << view->Bytes() / (1024 * 1024) << " MB\n";
+            book.PublishDepth(nullptr);
+        }
+        if (options.scans_) {
+            Scan(*table, interval);
+            book.PublishBbo(nullptr);
+        }
+        std::cout << "  rejected " << rejected << ", non-empty queries " << sink << '\n';
+        auto memory = book.Memory();
+        std::cout << "  book " << memory.Total() / (1024 * 1024) << " MB, " << std::setprecision(1)
+                  << memory.PerSecurity() << " bytes per security, " << memory.PerOrder() << " bytes per order, "
+                  << memory.levelBytes_ / (1024 * 1024) << " MB of spilled levels\n";
+        std::cout << "  peak RSS " << PeakRssMB() << " MB\n\n";
+    }
+
+    // Refills the asks untimed, then times a single buy that takes out every one of them
+    void Sweep(std::size_t levels, const Options & options) {
+        using namespace orderbook;
+
+        auto resting = levels * options.perLevel_;
+        Implementation book;
+        book.ReserveOrders(resting + 1);
+        auto symbol = Generator::Symbol(0);
+        auto instrument = book.Register(symbol.data(), symbol.size());
+
+        std::vector<Fill> fills(resting);
+        book.EnableMatching(fills.data(), fills.size());
+
+        const Tick base{10000};
+        auto iterations = std::max<std::size_t>(200, 2000000 / resting);
+        std::vector<double> sweeps;
+        sweeps.reserve(iterations);
+        int_fast64_t id{1};
+        std::size_t filled{0};
+        double total{0};
+
+        for (std::size_t i = 0; i < iterations; ++i) {
+            for (std::size_t level = 0; level < levels; ++level) {
+                for (std::size_t order = 0; order < options.perLevel_; ++order) {
+                    book.Process(Message{id++, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, instrument, base + static_cast<Tick>(level), 100});
+                }
+            }
+            book.ClearFills();
+
+            Message taker{id++, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, instrument, base + static_cast<Tick>(levels), static_cast<int_fast64_t>(resting) * 100};
+            auto begin = Clock::now();
+            book.Process(taker);
+            auto elapsed = Nanos(begin, Clock::now());
+
+            sweeps.push_back(elapsed);
+            filled += book.FillCount();
+            total += elapsed;
+        }
+
+        PrintRow(std::to_string(levels), sweeps);
+        std::cout << "  " << std::setw(18) << std::setprecision(1) << (total / static_cast<double>(filled)) << " ns/fill, "
+                  << std::setprecision(2) << (static_cast<double>(filled) / total * 1e3) << "M fills/s\n";
+    }
+
+    // Times the engine from dispatch until every shard has applied the stream. Adds carry their security
+    // and modifies and deletes only their order id, as a feed would, the strings being built untimed
+    void Scale(std::size_t securities, std::size_t shards, const Options & options) {
+        using namespace orderbook;
+
+        GeneratorConfig config;
+        config.seed_ = options.seed_;
+        config.securities_ = securities;
+        config.liveOrders_ = options.orders_ ? options.orders_ : std::max<std::size_t>(100000, securities / 4);
+
+        Generator generator(config);
+        std::vector<Order> orders;
+        orders.reserve(config.liveOrders_ + options.messages_);
+        for (std::size_t i = 0; i < config.liveOrders_ + options.messages_; ++i) {
+            auto message = generator.Next();
+            auto security = message.OrderAction_ == OrderAction_t::Add ? Generator::Symbol(message.Instrument_) : std::string();
+            orders.push_back(Order{message.OrderID_, message.OrderAction_, message.OrderDirection_, message.OrderConstraints_,
+                                   security, ToPrice(message.Price_), message.Volume_});
+        }
+
+        Engine::Config sharding;
+        sharding.shards_ = shards;
+        Engine engine(sharding);
+        engine.Start();
+        for (std::size_t i = 0; i < config.liveOrders_; ++i) {
+            engine.Dispatch(orders[i]);
+        }
+        engine.Drain();
+
+        auto start = Clock::now();
+        for (std::size_t i = config.liveOrders_; i < orders.size(); ++i) {
+            engine.Dispatch(orders[i]);
+        }
+        engine.Drain();
+        auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        engine.Stop();
+
+        std::size_t rejected{0};
+        for (std::size_t shard = 0; shard < engine.Shards(); ++shard) {
+            rejected += engine.Rejected(shard);
+        }
+        std::cout << "  " << std::left << std::setw(8) << shards << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(10) << (options.messages_ / seconds / 1e6) << std::setprecision(1)
+                  << std::setw(10) << (seconds * 1e9 / options.messages_) << std::setw(10) << rejected << '\n';
+    }
+
+    std::vector<std::size_t> ParseScales(const std::string & list) {
+        std::vector<std::size_t> scales;
+        std::stringstream stream(list);
+        std::string item;
+        while (std::getline(stream, item, ',')) {
+            scales.push_back(std::stoul(item));
+        }
+        return scales;
+    }
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:m:o:q:r:b:cdfuax:i:sw:l:e:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                options.scales_ = ParseScales(optarg);
+            break;
+            case 'm':
+                options.messages_ = std::stoul(optarg);
+            break;
+            case 'o':
+                options.orders_ = std::stoul(optarg);
+            break;
+            case 'q':
+                options.queries_ = std::stoul(optarg);
+            break;
+            case 'r':
+                options.seed_ = std::stoull(optarg);
+            break;
+            case 'b':
+                options.batch_ = std::stoul(optarg);
+            break;
+            case 'c':
+                options.coalesce_ = true;
+            break;
+            case 'd':
+                options.deltas_ = true;
+            break;
+            case 'f':
+                options.conflate_ = true;
+            break;
+            case 'u':
+                options.quotes_ = true;
+            break;
+            case 'a':
+                options.depth_ = true;
+            break;
+            case 'x':
+                options.fill_ = std::stoll(optarg);
+            break;
+            case 'i':
+                options.isa_ = optarg;
+            break;
+            case 's':
+                options.scans_ = true;
+            break;
+            case 'w':
+                options.sweeps_ = ParseScales(optarg);
+            break;
+            case 'l':
+                options.perLevel_ = std::max<std::size_t>(1, std::stoul(optarg));
+            break;
+            case 'e':
+                options.shards_ = std::stoul(optarg);
+            break;
+            case 'h':
+            default:
+                std::cout<<argv[0]<<" -n (securities) <1000,1000000,21000000> -m (messages) <n> -o (live orders) <n> -q (queries) <n> -r (seed) <n> -b (batch size) <n> -c (coalesce batches) -d (publish level deltas) -f (conflate deltas) -u (publish top of book) -a (depth analytics) -x (quantity to fill) <n> -i (depth kernels) <scalar,sse4.2,avx2> -s (bbo scans) -w (levels swept) <1,10,100,1000> -l (orders per level) <n> -e (most engine shards) <n>"<<'\n';
+                return 0;
+        }
+    }
+
+    if (!options.isa_.empty()) {
+        auto isa = options.isa_ == "avx2" ? orderbook::depth::Isa::AVX2 : options.isa_ == "sse4.2" ? orderbook::depth::Isa::SSE42 : orderbook::depth::Isa::SCALAR;
+        if (!orderbook::depth::Use(isa)) {
+            std::cerr << options.isa_ << " kernels aren't supported here\n";
+            return 1;
+        }
+    }
+
+    // Peak RSS only grows, so run the smaller scales first
+    std::sort(options.scales_.begin(), options.scales_.end());
+    for (auto securities : options.scales_) {
+        Run(securities, options);
+    }
+
+    if (!options.sweeps_.empty()) {
+        std::cout << "sweeps, " << options.perLevel_ << " orders per level\n";
+        std::cout << "  " << std::left << std::setw(8) << "levels" << std::right << std::setw(10) << "count"
+                  << std::setw(9) << "p50" << std::setw(9) << "p90" << std::setw(9) << "p99"
+                  << std::setw(9) << "p99.9" << std::setw(10) << "max" << '\n';
+        for (auto levels : options.sweeps_) {
+            Sweep(levels, options);
+        }
+    }
+
+    for (auto securities : options.scales_) {
+        if (!options.shards_) {
+            break;
+        }
+        std::cout << "engine, securities " << securities << ", messages " << options.messages_ << '\n';
+        std::cout << "  " << std::left << std::setw(8) << "shards" << std::right << std::setw(10) << "M msgs/s"
+                  << std::setw(10) << "ns/msg" << std::setw(10) << "rejected" << '\n';
+        for (std::size_t shards = 1; shards <= options.shards_; ++shards) {
+            Scale(securities, shards, options);
+        }
+    }
+
+    return 0;
+}
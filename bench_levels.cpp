@@ -0,0 +1,162 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "levels.hpp"
+#include "orderbook.hpp"
+
+// Compares the std::map levels, the price ladder and the ladder behind inline levels on one side of a
+// book. Orders are placed a geometrically distributed number of ticks behind a slowly walking mid, so
+// most of the activity is near the top of the book with a long thin tail, as in a real market.
+
+namespace {
+
+    struct Profile {
+        std::string name_;
+        double nearness_;       // Chance an order lands on each next tick closer to the mid
+        std::size_t orders_;    // Resting orders to keep in the book
+    };
+
+    struct Result {
+        double add_;
+        double delete_;
+        double top_;
+        double get_;
+        std::size_t depth_;
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    double Nanos(Clock::duration elapsed, std::size_t count) {
+        return count ? std::chrono::duration<double, std::nano>(elapsed).count() / count : 0.0;
+    }
+
+    template<typename Levels>
+    Result Run(const Profile & profile, std::size_t operations, uint64_t seed) {
+        using namespace orderbook;
+
+        Levels levels;
+        OrderPool pool;
+        std::vector<uint32_t> resting;
+        resting.reserve(profile.orders_ * 2);
+        pool.Reserve(profile.orders_ * 2);
+
+        std::mt19937_64 rng(seed);
+        std::geometric_distribution<int> distance(1.0 - profile.nearness_);
+        std::uniform_real_distribution<double> coin(0.0, 1.0);
+        Tick mid = ToTick(100.0f);
+        int_fast64_t id = 0;
+
+        auto add = [&] () {
+            Tick price = mid - distance(rng);
+            auto level = levels.Insert(price);
+            auto node = pool.Allocate();
+            pool[node] = RestingOrder{++id, 100, price, 0, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, NIL, NIL};
+            pool.Append(*level, node);
+            resting.push_back(node);
+        };
+
+        auto remove = [&] (std::size_t index) {
+            auto node = resting[index];
+            auto price = pool[node].Price_;
+            auto level = levels.Find(price);
+            pool.Remove(*level, node);
+            if (level->empty()) {
+                levels.Erase(price);
+            }
+            pool.Release(node);
+            resting[index] = resting.back();
+            resting.pop_back();
+        };
+
+        // Build the book up to its working depth before timing
+        while (resting.size() < profile.orders_) {
+            add();
+        }
+
+        Clock::duration addTime{}, deleteTime{}, topTime{}, getTime{};
+        std::size_t adds{0}, deletes{0}, tops{0}, gets{0};
+        std::size_t depth{0};
+        volatile std::size_t sink{0};
+
+        for (std::size_t op = 0; op < operations; ++op) {
+            if (op % 1000 == 0) {
+                mid += coin(rng) < 0.5 ? -1 : 1;
+            }
+
+            auto action = coin(rng);
+            if (action < 0.45 || resting.empty()) {
+                auto start = Clock::now();
+                add();
+                addTime += Clock::now() - start;
+                ++adds;
+            } else if (action < 0.9) {
+                auto index = static_cast<std::size_t>(coin(rng) * resting.size());
+                auto start = Clock::now();
+                remove(index);
+                deleteTime += Clock::now() - start;
+                ++deletes;
+            } else if (action < 0.95) {
+                Tick price;
+                auto start = Clock::now();
+                auto level = levels.At(0, price);
+                topTime += Clock::now() - start;
+                sink = sink + (level ? level->size() : 0);
+                ++tops;
+            } else {
+                Tick price;
+                auto index = static_cast<std::size_t>(coin(rng) * std::min<std::size_t>(levels.Size(), 10));
+                auto start = Clock::now();
+                auto level = levels.At(index, price);
+                getTime += Clock::now() - start;
+                sink = sink + (level ? level->size() : 0);
+                ++gets;
+            }
+            depth += levels.Size();
+        }
+
+        return {Nanos(addTime, adds), Nanos(deleteTime, deletes), Nanos(topTime, tops), Nanos(getTime, gets), depth / operations};
+    }
+
+    void Print(const std::string & profile, const std::string & container, const Result & result) {
+        std::cout << std::left << std::setw(10) << profile << std::setw(10) << container
+                  << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(10) << result.depth_
+                  << std::setw(10) << result.add_
+                  << std::setw(10) << result.delete_
+                  << std::setw(10) << result.top_
+                  << std::setw(10) << result.get_ << '\n';
+    }
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    using namespace orderbook;
+
+    std::size_t operations = argc > 1 ? std::stoul(argv[1]) : 2000000;
+
+    const std::vector<Profile> profiles {
+        { "thin", 0.1, 2 },
+        { "shallow", 0.5, 50 },
+        { "typical", 0.9, 1000 },
+        { "deep", 0.99, 20000 },
+    };
+
+    std::cout << std::left << std::setw(10) << "profile" << std::setw(10) << "levels"
+              << std::right << std::setw(10) << "depth"
+              << std::setw(10) << "add ns" << std::setw(10) << "delete ns"
+              << std::setw(10) << "top ns" << std::setw(10) << "get ns" << '\n';
+    std::cout << std::setw(70) << std::setfill('-') << '-' << std::setfill(' ') << '\n';
+
+    for (const auto & profile : profiles) {
+        Print(profile.name_, "map", Run<MapLevels<BidSide, Level>>(profile, operations, 42));
+        Print(profile.name_, "ladder", Run<PriceLadder<BidSide, Level>>(profile, operations, 42));
+        Print(profile.name_, "inline", Run<InlineLevels<BidSide, Level, PriceLadder<BidSide, Level>>>(profile, operations, 42));
+    }
+
+    return 0;
+}
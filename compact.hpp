@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 namespace compact {
 
     constexpr unsigned short ORDER_ACTION_ADD = 1;
@@ -1,11 +1,24 @@
 #pragma once
 
+#include <unistd.h>
+
+#include <algorithm>
 #include <assert.h> 
+#include <fstream>
 #include <limits>
+#include <map>
 #include <math.h>
+#include <sstream>
+#include <thread>
+#include <tuple>
 #include <vector>
 
+#include "engine.hpp"
+#include "harness.hpp"
 #include "orderbook.hpp"
+#include "persist.hpp"
+#include "pipeline.hpp"
+#include "text.hpp"
 
 namespace orderbook {
 
@@ -45,67 +58,1169 @@ void TestBook(const orderbook::Implementation & book) {
 
     // 2 entries at 100.0
     auto buyElement1 = book.Get("US30303M1027", OrderDirection_t::BUY, 0).first;
-    assert(buyElement1->Price_ == 100.0f && "The price should be 100.0");
+    assert(buyElement1->Price_ == ToTick(100.0f) && "The price should be 100.0");
     assert(buyElement1->Volume_ == 500 && "The volume should be 500");
-    auto buyElement2 = buyElement1 + 1;
-    assert(buyElement2->Price_ == 100.0f && "The price should be 100.0");
+    auto buyElement2 = std::next(buyElement1);
+    assert(buyElement2->Price_ == ToTick(100.0f) && "The price should be 100.0");
     assert(buyElement2->Volume_ == 5000 && "The volume should be 5000");
 
     // 1 entry at 99.9
     buyElement1 = book.Get("US30303M1027", OrderDirection_t::BUY, 1).first;
-    assert(buyElement1->Price_ == 99.9f && "The price should be 99.9");
+    assert(buyElement1->Price_ == ToTick(99.9f) && "The price should be 99.9");
     assert(buyElement1->Volume_ == 2000 && "The volume should be 2000");
 
     // Ask side - US30303M1027
 
     // 1 entry at 100.1
     buyElement1 = book.Get("US30303M1027", OrderDirection_t::SELL, 0).first;
-    assert(buyElement1->Price_ == 100.1f && "The price should be 100.1");
+    assert(buyElement1->Price_ == ToTick(100.1f) && "The price should be 100.1");
     assert(buyElement1->Volume_ == 10000 && "The volume should be 10000");
 
     // 1 entry at 100.5
     buyElement1 = book.Get("US30303M1027", OrderDirection_t::SELL, 1).first;
-    assert(buyElement1->Price_ == 100.5f && "The price should be 100.5");
+    assert(buyElement1->Price_ == ToTick(100.5f) && "The price should be 100.5");
     assert(buyElement1->Volume_ == 7000 && "The volume should be 7000");
 
     // 1 entry at 100.8
     buyElement1 = book.Get("US30303M1027", OrderDirection_t::SELL, 2).first;
-    assert(buyElement1->Price_ == 100.8f && "The price should be 100.8");
+    assert(buyElement1->Price_ == ToTick(100.8f) && "The price should be 100.8");
     assert(buyElement1->Volume_ == 500 && "The volume should be 500");
+
+    // Aggregated levels - US30303M1027
+    [[maybe_unused]] auto instrument = book.Instrument("US30303M1027");
+    [[maybe_unused]] Quote level;
+    assert(book.LevelAt(instrument, OrderDirection_t::BUY, 0, level) && level.Price_ == ToTick(100.0f) && "The best bid should be 100.0");
+    assert(level.Volume_ == 5500 && level.Orders_ == 2 && "The best bid should total 5500 over 2 orders");
+    assert(!book.LevelAt(instrument, OrderDirection_t::BUY, 2, level) && "There should be no third bid");
+    [[maybe_unused]] Quote levels[4];
+    assert(book.TopLevels(instrument, OrderDirection_t::SELL, levels, 4) == 3 && "There should be 3 ask levels");
+    assert(levels[1].Price_ == ToTick(100.5f) && levels[1].Volume_ == 7000 && levels[1].Orders_ == 1 && "The second ask should be 7000 at 100.5");
+    assert(book.VolumeWithin(instrument, OrderDirection_t::SELL, ToTick(100.5f) - ToTick(100.1f)) == 17000 && "The asks within 0.4 should total 17000");
+    assert(book.VolumeWithin(instrument, OrderDirection_t::BUY, 0) == 5500 && "Only the best bid should be within 0");
     // Bid side - US02079K1079
 
     // 2 entries at 100.0
     buyElement1 = book.Get("US02079K1079", OrderDirection_t::BUY, 0).first;
-    assert(buyElement1->Price_ == 100.0f && "The price should be 100.0");
+    assert(buyElement1->Price_ == ToTick(100.0f) && "The price should be 100.0");
     assert(buyElement1->Volume_ == 500 && "The volume should be 500");
-    buyElement2 = buyElement1 + 1;
-    assert(buyElement2->Price_ == 100.0f && "The price should be 100.0");
+    buyElement2 = std::next(buyElement1);
+    assert(buyElement2->Price_ == ToTick(100.0f) && "The price should be 100.0");
     assert(buyElement2->Volume_ == 5000 && "The volume should be 5000");
 
     // 1 entry at 99.9
     buyElement1 = book.Get("US02079K1079", OrderDirection_t::BUY, 1).first;
-    assert(buyElement1->Price_ == 99.9f && "The price should be 99.9");
+    assert(buyElement1->Price_ == ToTick(99.9f) && "The price should be 99.9");
     assert(buyElement1->Volume_ == 2000 && "The volume should be 2000");
 
     // Ask side - US02079K1079
 
     // 1 entry at 100.1
     buyElement1 = book.Get("US02079K1079", OrderDirection_t::SELL, 0).first;
-    assert(buyElement1->Price_ == 100.1f && "The price should be 100.1");
+    assert(buyElement1->Price_ == ToTick(100.1f) && "The price should be 100.1");
     assert(buyElement1->Volume_ == 10000 && "The volume should be 10000");
 
     // 1 entry at 100.5
     buyElement1 = book.Get("US02079K1079", OrderDirection_t::SELL, 1).first;
-    assert(buyElement1->Price_ == 100.5f && "The price should be 100.5");
+    assert(buyElement1->Price_ == ToTick(100.5f) && "The price should be 100.5");
     assert(buyElement1->Volume_ == 7000 && "The volume should be 7000");
 
     // 1 entry at 100.8
     buyElement1 = book.Get("US02079K1079", OrderDirection_t::SELL, 2).first;
-    assert(buyElement1->Price_ == 100.8f && "The price should be 100.8");
+    assert(buyElement1->Price_ == ToTick(100.8f) && "The price should be 100.8");
     assert(buyElement1->Volume_ == 500 && "The volume should be 500");
 
     std::cout<<"All tests passed...."<<std::endl;
 }    
+
+void TestOrderIndex() {
+    orderbook::Implementation book;
+    const std::string security{"US5949181045"};
+
+    book.Process({ 21, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 50.0, 100 });
+    book.Process({ 20, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 50.0, 200 });
+    book.Process({ 22, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 50.0, 300 });
+    [[maybe_unused]] int rc = book.Process({ 22, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 50.0, 300 });
+    assert(rc == ERR_ORD_ORDERID && "Duplicate OrderIDs should be rejected");
+
+    // Deletes don't need a price and order ids don't have to be increasing
+    rc = book.Process({ 20, OrderAction_t::Delete, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, "", 0.0, 0 });
+    assert(rc == SUCCESS && "Delete by OrderID should succeed");
+    rc = book.Process({ 20, OrderAction_t::Delete, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, "", 0.0, 0 });
+    assert(rc == ERR_ORD_ORDERID && "Deleted order should be unknown");
+    auto level = book.Top(security, OrderDirection_t::BUY);
+    assert(std::distance(level.first, level.second) == 2 && "There should be 2 orders at 50.0");
+
+    // Moving the first order in the queue to a new price loses priority
+    rc = book.Process({ 21, OrderAction_t::Modify, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 50.5, 150 });
+    assert(rc == SUCCESS && "Price changing modify should succeed");
+    rc = book.Process({ 21, OrderAction_t::Modify, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 50.0, 150 });
+    assert(rc == SUCCESS && "Price changing modify should succeed");
+    assert(book.BookDepth(security, OrderDirection_t::BUY) == 1 && "The book depth should be 1");
+    level = book.Top(security, OrderDirection_t::BUY);
+    assert(level.first->OrderID_ == 22 && "Order 22 should now be first in the queue");
+    assert(std::next(level.first)->OrderID_ == 21 && "Order 21 should now be last in the queue");
+    assert(std::next(level.first)->Volume_ == 150 && "The volume should be 150");
+
+    // End of day clears every order, the securities stay registered
+    book.Reset();
+    assert(book.Exists(security) && "Security should still be registered after Reset");
+    assert(book.BookDepth(security, OrderDirection_t::SELL) == 0 && "The book should be empty after Reset");
+    rc = book.Process({ 21, OrderAction_t::Delete, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, "", 0.0, 0 });
+    assert(rc == ERR_ORD_ORDERID && "Orders should be cleared by Reset");
+    rc = book.Process({ 21, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, security, 51.0, 100 });
+    assert(rc == SUCCESS && "Order ids can be reused after Reset");
+
+    std::cout<<"Order index tests passed...."<<std::endl;
+}
+
+void TestEngine(const orderbook::Engine & engine) {
+    // Each security's messages all land on one shard, so its book matches the single threaded one
+    for (const std::string security : { "US30303M1027", "US02079K1079" }) {
+        [[maybe_unused]] const auto & book = engine.Book(engine.ShardOf(security));
+        assert(book.BookDepth(security, OrderDirection_t::BUY) == 2 && "The book depth should be 2");
+        assert(book.BookDepth(security, OrderDirection_t::SELL) == 3 && "The book depth should be 3");
+        assert(book.Top(security, OrderDirection_t::BUY).first->Volume_ == 500 && "The volume should be 500");
+    }
+
+    std::size_t processed{0};
+    for (std::size_t shard = 0; shard < engine.Shards(); ++shard) {
+        processed += engine.Processed(shard);
+        assert(engine.Rejected(shard) == 0 && "No messages should be rejected");
+    }
+    assert(processed == datafeed.size() && "Every message should be processed");
+
+    std::cout<<"Engine tests passed...."<<std::endl;
+}
+
+void TestEngineRouting() {
+    Engine::Config config;
+    config.shards_ = 4;
+    config.capacity_ = 64;
+    Engine engine(config);
+    const std::string security{"US30303M1027"};
+    auto shard = engine.ShardOf(security);
+
+    // Nothing consumes the rings yet, so dispatching must fail rather than wait for room forever
+    [[maybe_unused]] int rc = engine.Dispatch({ 1, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 50.0, 100 });
+    assert(rc == ERR_NOT_RUNNING && "Dispatch before Start should fail");
+
+    // Modifies and deletes carrying only the order id follow their add to its shard
+    engine.Start();
+    rc = engine.Dispatch({ 1, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 50.0, 100 });
+    assert(rc == SUCCESS && "The add should be dispatched");
+    rc = engine.Dispatch({ 2, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 49.0, 100 });
+    assert(rc == SUCCESS && "The add should be dispatched");
+    rc = engine.Dispatch({ 1, OrderAction_t::Modify, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, "", 50.0, 300 });
+    assert(rc == SUCCESS && "An id only modify should be routed");
+    rc = engine.Dispatch({ 2, OrderAction_t::Delete, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, "", 0.0, 0 });
+    assert(rc == SUCCESS && "An id only delete should be routed");
+    engine.Drain();
+
+    [[maybe_unused]] const auto & book = engine.Book(shard);
+    assert(book.BookDepth(security, OrderDirection_t::BUY) == 1 && "The delete should have reached the order's shard");
+    assert(book.Top(security, OrderDirection_t::BUY).first->Volume_ == 300 && "The modify should have reached the order's shard");
+    for (std::size_t i = 0; i < engine.Shards(); ++i) {
+        assert(engine.Rejected(i) == 0 && "No messages should be rejected");
+    }
+
+    engine.Stop();
+    rc = engine.Dispatch({ 1, OrderAction_t::Delete, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, "", 0.0, 0 });
+    assert(rc == ERR_NOT_RUNNING && "Dispatch after Stop should fail");
+
+    std::cout<<"Engine routing tests passed...."<<std::endl;
+}
+
+void TestSymbols() {
+    SymbolRegistry symbols;
+
+    [[maybe_unused]] auto id = symbols.Intern("US30303M1027");
+    assert(id == 0 && "The first symbol should be instrument 0");
+    id = symbols.Intern("US02079K1079");
+    assert(id == 1 && "The second symbol should be instrument 1");
+    id = symbols.Intern("US30303M1027");
+    assert(id == 0 && "Interning a symbol again should return its id");
+    assert(symbols.Find("UK01234X5789") == NO_INSTRUMENT && "Unknown symbols should not be found");
+    id = symbols.Intern("AN_IDENTIFIER_TOO_LONG");
+    assert(id == NO_INSTRUMENT && "Symbols longer than a key should be rejected");
+    assert(symbols.Symbol(1) == "US02079K1079" && "The symbol should round trip");
+
+    // A book can be driven by instrument id without a string lookup per message
+    orderbook::Implementation book;
+    auto instrument = book.Register("US5949181045", 12);
+    [[maybe_unused]] int rc = book.Process(instrument, { 1, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, {}, 10.0, 100 });
+    assert(rc == SUCCESS && "Add by instrument id should succeed");
+    assert(book.BookDepth("US5949181045", OrderDirection_t::SELL) == 1 && "The book depth should be 1");
+    rc = book.Process(instrument + 1, { 2, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, {}, 10.0, 100 });
+    assert(rc == ERR_ORD_SECID && "Unknown instruments should be rejected");
+
+    std::cout<<"Symbol tests passed...."<<std::endl;
+}
+
+void TestPriceLadder() {
+    PriceLadder<AskSide, Level> asks;
+    [[maybe_unused]] Tick price;
+
+    // Prices far apart force the ladder to grow and re-center around the levels it holds
+    asks.Insert(ToTick(100.1f));
+    asks.Insert(ToTick(99.5f));
+    asks.Insert(ToTick(105.0f));
+    asks.Insert(ToTick(90.0f));
+    assert(asks.Size() == 4 && "The ladder should hold 4 levels");
+    assert(asks.At(0, price) && price == ToTick(90.0f) && "The best ask should be 90.0");
+    assert(asks.At(3, price) && price == ToTick(105.0f) && "The worst ask should be 105.0");
+    assert(asks.At(4, price) == nullptr && "There should be no fifth level");
+
+    asks.Erase(ToTick(90.0f));
+    assert(asks.At(0, price) && price == ToTick(99.5f) && "The best ask should move to 99.5");
+    assert(asks.Find(ToTick(90.0f)) == nullptr && "The level at 90.0 should be gone");
+
+    // Prices too far from the rest for one window are held apart, in order either side of it
+    auto behind = ToTick(100.1f) + static_cast<Tick>(PriceLadder<AskSide, Level>::MAX_SPAN);
+    auto ahead = ToTick(99.5f) - static_cast<Tick>(PriceLadder<AskSide, Level>::MAX_SPAN);
+    [[maybe_unused]] auto * far = asks.Insert(behind);
+    assert(far != nullptr && asks.Insert(behind) == far && asks.Insert(ahead) != nullptr && asks.Size() == 5 && "Prices beyond the maximum span should still be held");
+    assert(asks.At(0, price) && price == ahead && asks.At(1, price) && price == ToTick(99.5f) && asks.At(4, price) && price == behind && "Held prices should be visited in order");
+    std::vector<Tick> visited;
+    asks.ForEach([&visited] (Tick at, const Level &) { visited.push_back(at); });
+    assert(visited == std::vector<Tick>({ahead, ToTick(99.5f), ToTick(100.1f), ToTick(105.0f), behind}) && "Held prices should be walked in order");
+    asks.Erase(ahead);
+    asks.Erase(behind);
+    assert(asks.Size() == 3 && asks.Find(behind) == nullptr && asks.At(0, price) && price == ToTick(99.5f) && "Held prices should be erased");
+
+    PriceLadder<BidSide, Level> bids;
+    bids.Insert(ToTick(99.9f));
+    bids.Insert(ToTick(100.0f));
+    bids.Insert(ToTick(1.0f));
+    assert(bids.At(0, price) && price == ToTick(100.0f) && "The best bid should be 100.0");
+    assert(bids.At(2, price) && price == ToTick(1.0f) && "The worst bid should be 1.0");
+
+    // Levels spread over many bitmap words are found by index the same as walking them in order
+    for (Tick tick = 0; tick < 600; tick += 3) {
+        bids.Insert(ToTick(50.0f) + tick);
+    }
+    for (Tick tick = 0; tick < 600; tick += 5) {
+        asks.Insert(ToTick(101.0f) + tick);
+    }
+    std::size_t index{0};
+    bids.ForEach([&bids, &index] ([[maybe_unused]] Tick expected, const Level &) {
+        [[maybe_unused]] Tick at;
+        assert(bids.At(index++, at) && at == expected && "Bids found by index should match their order");
+    });
+    index = 0;
+    asks.ForEach([&asks, &index] ([[maybe_unused]] Tick expected, const Level &) {
+        [[maybe_unused]] Tick at;
+        assert(asks.At(index++, at) && at == expected && "Asks found by index should match their order");
+    });
+    std::size_t within{0};
+    asks.ForWithin(ToTick(100.1f) - ToTick(99.5f), [&within] (Tick, const Level &) { ++within; });
+    assert(within == 2 && "Only the asks within 0.6 of the best should be visited");
+
+    // A book takes a valid order however far it is from the rest, and a re-centered window takes in
+    // the held levels it reaches
+    orderbook::Implementation book;
+    book.Process({ 1, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, "US5949181045", 10.0, 100 });
+    book.Process({ 4, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, "US5949181045", 10.5, 100 });
+    [[maybe_unused]] int rc = book.Process({ 2, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, "US5949181045", 20000.0, 100 });
+    assert(rc == SUCCESS && book.BookDepth("US5949181045", OrderDirection_t::SELL) == 3 && "A far price should be accepted");
+    book.Process({ 1, OrderAction_t::Delete, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, "", 0.0, 0 });
+    book.Process({ 4, OrderAction_t::Delete, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, "", 0.0, 0 });
+    book.Process({ 3, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, "US5949181045", 19999.0, 100 });
+    assert(book.BookDepth("US5949181045", OrderDirection_t::SELL) == 2 && book.Top("US5949181045", OrderDirection_t::SELL).first->OrderID_ == 3 && "The held level should join the window");
+    rc = book.Process({ 2, OrderAction_t::Delete, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, "", 0.0, 0 });
+    assert(rc == SUCCESS && book.BookDepth("US5949181045", OrderDirection_t::SELL) == 1 && "The held level should be deleted");
+
+    std::cout<<"Price ladder tests passed...."<<std::endl;
+}
+
+void TestInlineLevels() {
+    using Ladder = PriceLadder<BidSide, Level>;
+    InlineLevels<BidSide, Level, Ladder> bids;
+    [[maybe_unused]] Tick price;
+
+    bids.Insert(ToTick(99.0f))->volume_ = 10;
+    bids.Insert(ToTick(100.0f))->volume_ = 20;
+    assert(!bids.Spilled() && bids.Bytes() == 0 && "Two levels should be held inline");
+    assert(bids.Best(price) && price == ToTick(100.0f) && "The best bid should be 100.0");
+    assert(bids.At(1, price)->volume_ == 10 && price == ToTick(99.0f) && "The second bid should be 99.0");
+
+    // A third level moves them all into the ladder, keeping what each level held
+    bids.Insert(ToTick(99.5f))->volume_ = 30;
+    assert(bids.Spilled() && bids.Bytes() > 0 && bids.Size() == 3 && "A third level should spill the side");
+    assert(bids.Find(ToTick(100.0f))->volume_ == 20 && bids.Find(ToTick(99.0f))->volume_ == 10 && "Spilled levels should keep their volume");
+    assert(bids.At(1, price) && price == ToTick(99.5f) && "The spilled levels should stay in order");
+
+    bids.Erase(ToTick(100.0f));
+    bids.Erase(ToTick(99.5f));
+    assert(bids.Spilled() && "The side should stay spilled while it holds levels");
+    bids.Erase(ToTick(99.0f));
+    assert(!bids.Spilled() && bids.Empty() && "An emptied side should free its ladder");
+
+    // Levels further apart than a ladder spans still spill, the outlier held apart in order
+    bids.Insert(ToTick(1.0f));
+    bids.Insert(ToTick(1.0f) + static_cast<Tick>(Ladder::MAX_SPAN));
+    [[maybe_unused]] auto * level = bids.Insert(ToTick(2.0f));
+    assert(level != nullptr && bids.Spilled() && bids.Size() == 3 && "A side too wide for a ladder should still spill");
+    assert(bids.At(0, price) && price == ToTick(1.0f) + static_cast<Tick>(Ladder::MAX_SPAN) && bids.At(2, price) && price == ToTick(1.0f) && "The spilled levels should stay in order");
+
+    orderbook::BasicImplementation<LowMemoryLayout> book;
+    book.Process({ 1, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, "US5949181045", 10.0, 100 });
+    book.Process({ 2, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, "US5949181045", 11.0, 100 });
+    [[maybe_unused]] auto memory = book.Memory();
+    assert(memory.securities_ == 1 && memory.orders_ == 2 && "Memory should count the securities and orders");
+    assert(memory.levelBytes_ == 0 && "A level a side should need no memory beyond the security");
+    assert(memory.PerOrder() >= sizeof(RestingOrder) && memory.Total() > memory.securityBytes_ && "Memory should account for the orders and symbols");
+
+    std::cout<<"Inline level tests passed...."<<std::endl;
+}
+
+// Plays a deterministic stream of adds, modifies and deletes that cross and trade, and returns each
+// message's result followed by every level each security ends up with
+template<typename Layout>
+std::vector<std::tuple<int, Tick, int64_t, uint32_t>> PlayLayout() {
+    orderbook::BasicImplementation<Layout> book;
+    std::vector<Fill> fills(64);
+    book.EnableMatching(fills.data(), fills.size());
+    std::vector<std::tuple<int, Tick, int64_t, uint32_t>> played;
+
+    uint64_t seed{42};
+    auto next = [&seed] (uint64_t range) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<int64_t>((seed >> 33) % range);
+    };
+    for (int_fast64_t id = 1; id <= 4000; ++id) {
+        auto instrument = book.Register(id % 3 ? "US5949181045" : "US30303M1027", 12);
+        auto direction = next(2) ? OrderDirection_t::BUY : OrderDirection_t::SELL;
+        auto price = ToTick(100.0f) + next(12) - (direction == OrderDirection_t::BUY ? 6 : 0);
+        auto action = id < 50 ? 0 : next(4);
+        auto target = action ? id - 1 - next(40) : id;
+        Message message{target, action == 0 ? OrderAction_t::Add : action == 1 ? OrderAction_t::Delete : OrderAction_t::Modify,
+                        direction, OrderConstraints_t::LIMIT, instrument, price, 1 + next(500)};
+        played.emplace_back(book.Process(message), 0, 0, 0);
+        book.ClearFills();
+    }
+
+    for (auto instrument : {InstrumentID{0}, InstrumentID{1}}) {
+        for (auto direction : {OrderDirection_t::BUY, OrderDirection_t::SELL}) {
+            Quote levels[64];
+            auto count = book.TopLevels(instrument, direction, levels, 64);
+            for (std::size_t i = 0; i < count; ++i) {
+                played.emplace_back(SUCCESS, levels[i].Price_, levels[i].Volume_, levels[i].Orders_);
+            }
+        }
+    }
+    return played;
+}
+
+void TestLayouts() {
+    // Every layout holds the same book, and the debug layout checks it after each message. The random
+    // stream rejects plenty of messages, which would only bury real failures in the log.
+    Logger::Default().Flush();
+    Logger::Default().Mute(true);
+    auto expected = PlayLayout<StandardLayout>();
+    assert(PlayLayout<DebugLayout>() == expected && "The debug layout should hold the same book");
+    assert(PlayLayout<LowLatencyLayout>() == expected && "The low latency layout should hold the same book");
+    assert(PlayLayout<LowMemoryLayout>() == expected && "The low memory layout should hold the same book");
+    assert(expected.size() > 4000 && "Some levels should be left resting");
+    Logger::Default().Mute(false);
+
+    std::cout<<"Layout tests passed...."<<std::endl;
+}
+
+void TestMatching() {
+    orderbook::Implementation book;
+    const std::string security{"US5949181045"};
+    Fill fills[4];
+    book.EnableMatching(fills, 4);
+
+    book.Process({ 1, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, security, 10.0, 100 });
+    book.Process({ 2, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, security, 10.0, 100 });
+    book.Process({ 3, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, security, 10.5, 100 });
+    book.Process({ 4, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, security, 11.0, 100 });
+    assert(book.FillCount() == 0 && "Orders that don't cross should rest without trading");
+
+    // Sweeps 10.0 oldest first, then part of 10.5, and stops short of 11.0
+    [[maybe_unused]] int rc = book.Process({ 5, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 10.5, 250 });
+    assert(rc == SUCCESS && "A crossing limit order should succeed");
+    assert(book.FillCount() == 3 && "The buy should trade with 3 resting orders");
+    assert(fills[0].MakerID_ == 1 && fills[1].MakerID_ == 2 && "Resting orders should fill in time priority");
+    assert(fills[2].MakerID_ == 3 && fills[2].Price_ == ToTick(10.5f) && fills[2].Volume_ == 50 && fills[2].MakerRemaining_ == 50 && "The last fill should be partial at 10.5");
+    assert(book.BookDepth(security, OrderDirection_t::SELL) == 2 && "Filled levels should be removed");
+    assert(book.BookDepth(security, OrderDirection_t::BUY) == 0 && "A fully filled buy should not rest");
+
+    // A limit remainder rests, a market remainder is cancelled
+    book.ClearFills();
+    rc = book.Process({ 6, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 10.5, 100 });
+    assert(rc == SUCCESS && "A partly crossing limit order should succeed");
+    assert(book.FillCount() == 1 && book.BookDepth(security, OrderDirection_t::BUY) == 1 && "The limit remainder should rest");
+    rc = book.Process({ 7, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::MARKET, security, 0.0, 500 });
+    assert(rc == SUCCESS && "A market order should succeed");
+    assert(book.FillCount() == 2 && book.BookDepth(security, OrderDirection_t::SELL) == 1 && "The market remainder should not rest");
+    rc = book.Process({ 6, OrderAction_t::Delete, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, "", 0.0, 0 });
+    assert(rc == ERR_ORD_ORDERID && "Filled orders should be removed from the index");
+
+    // The buffer is never grown, a sweep that runs out of room stops and cancels the rest
+    book.Process({ 8, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, security, 11.0, 100 });
+    book.Process({ 9, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, security, 11.0, 100 });
+    book.Process({ 10, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, security, 11.0, 100 });
+    rc = book.Process({ 11, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 11.0, 400 });
+    assert(rc == ERR_ORD_FILLS && "A full fill buffer should stop the sweep");
+    assert(book.FillCount() == 4 && book.BookDepth(security, OrderDirection_t::BUY) == 0 && "The unfilled buy should be cancelled");
+    [[maybe_unused]] auto level = book.Top(security, OrderDirection_t::SELL);
+    assert(level.first != level.second && level.first->OrderID_ == 9 && "The unswept orders should still rest");
+
+    std::cout<<"Matching tests passed...."<<std::endl;
+}
+
+void TestBatch() {
+    // A batch applies exactly as the same messages one at a time
+    orderbook::Implementation single;
+    orderbook::Implementation batched;
+    std::vector<int> expected, results(datafeed.size());
+    for (auto & order : datafeed) {
+        expected.push_back(single.Process(order));
+    }
+    [[maybe_unused]] auto rejected = batched.ProcessBatch(datafeed.data(), datafeed.size(), results.data());
+    assert(results == expected && "Batched results should match processing one at a time");
+    assert(rejected == static_cast<std::size_t>(std::count_if(expected.begin(), expected.end(), [] (int rc) { return rc != SUCCESS; })) && "The rejected count should match");
+    for (auto security : {"US30303M1027", "US02079K1079"}) {
+        for (auto direction : {OrderDirection_t::BUY, OrderDirection_t::SELL}) {
+            assert(single.BookDepth(security, direction) == batched.BookDepth(security, direction) && "Batched book depths should match");
+            [[maybe_unused]] auto lhs = single.Top(security, direction);
+            [[maybe_unused]] auto rhs = batched.Top(security, direction);
+            assert(std::distance(lhs.first, lhs.second) == std::distance(rhs.first, rhs.second) && "Batched top levels should match");
+        }
+    }
+
+    // An add deleted again in the same window is never applied, unless the add would have been rejected
+    orderbook::Implementation book;
+    const std::string security{"US5949181045"};
+    std::vector<Order> packet {
+        { 1, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 10.0, 100 },
+        { 2, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 10.0, 100 },
+        { 1, OrderAction_t::Delete, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, "", 0.0, 0 },
+        { 2, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 10.0, 100 },
+        { 2, OrderAction_t::Delete, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, "", 0.0, 0 },
+        { 3, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, security, 11.0, 100 },
+    };
+    results.assign(packet.size(), -1);
+    rejected = book.ProcessBatch(packet.data(), packet.size(), results.data(), true);
+    assert(rejected == 1 && "Only the duplicate add should be rejected");
+    assert(results == std::vector<int>({ SUCCESS, SUCCESS, SUCCESS, ERR_ORD_ORDERID, SUCCESS, SUCCESS }) && "Coalesced messages should report success");
+    assert(book.BookDepth(security, OrderDirection_t::BUY) == 0 && "Order 2 should have been deleted");
+    assert(book.BookDepth(security, OrderDirection_t::SELL) == 1 && "Order 3 should rest");
+
+    std::cout<<"Batch tests passed...."<<std::endl;
+}
+
+void TestPersistence() {
+    auto base = "/tmp/orderbook_test_" + std::to_string(::getpid());
+    auto snapshot = base + ".snapshot";
+    auto journal = base + ".journal";
+
+    // Checkpoint part way through a journalled session, from a fork and synchronously
+    orderbook::Implementation book;
+    persist::Journal log;
+    persist::Checkpointer checkpointer;
+    [[maybe_unused]] int rc = log.Open(journal, true);
+    assert(rc == SUCCESS && "The journal should open");
+    for (std::size_t i = 0; i < datafeed.size(); ++i) {
+        if (i == 5) {
+            rc = checkpointer.Start(snapshot, book, log);
+            assert(rc == SUCCESS && log.Committed() == log.Position() && "The checkpoint should start once the journal is synced");
+            rc = checkpointer.Wait();
+            assert(rc == SUCCESS && "The forked checkpoint should be written");
+        }
+        if (i == 11) {
+            rc = log.Sync();
+            assert(rc == SUCCESS && "The journal should be synced");
+            rc = persist::WriteSnapshot(snapshot, book, log.Committed());
+            assert(rc == SUCCESS && "The snapshot should be written");
+        }
+        log.Append(datafeed[i]);
+        book.Process(datafeed[i]);
+    }
+    rc = log.Flush();
+    assert(rc == SUCCESS && "The journal should be flushed");
+
+    // The recovered book is the snapshot plus only the journal written after it
+    orderbook::Implementation recovered;
+    persist::RecoverStats stats;
+    rc = persist::Recover(snapshot, journal, recovered, stats);
+    assert(rc == SUCCESS && "Recovery should succeed");
+    assert(stats.journal_.messages_ == datafeed.size() - 11 && "Only the journal tail should be replayed");
+    for (auto security : {"US30303M1027", "US02079K1079"}) {
+        for (auto direction : {OrderDirection_t::BUY, OrderDirection_t::SELL}) {
+            assert(book.BookDepth(security, direction) == recovered.BookDepth(security, direction) && "Recovered book depths should match");
+            for (int index = 0; index < static_cast<int>(book.BookDepth(security, direction)); ++index) {
+                auto lhs = book.Get(security, direction, index);
+                auto rhs = recovered.Get(security, direction, index);
+                for (; lhs.first != lhs.second && rhs.first != rhs.second; ++lhs.first, ++rhs.first) {
+                    assert(lhs.first->OrderID_ == rhs.first->OrderID_ && lhs.first->Volume_ == rhs.first->Volume_ && "Recovered queues should match");
+                }
+                assert(lhs.first == lhs.second && rhs.first == rhs.second && "Recovered levels should be the same length");
+            }
+        }
+    }
+
+    // Without a snapshot the whole journal is replayed
+    orderbook::Implementation replayed;
+    persist::RecoverStats full;
+    rc = persist::Recover(base + ".missing", journal, replayed, full);
+    assert(rc == SUCCESS && full.journal_.messages_ == datafeed.size() && "A missing snapshot should replay the whole journal");
+
+    ::unlink(snapshot.c_str());
+    ::unlink(journal.c_str());
+    std::cout<<"Persistence tests passed...."<<std::endl;
+}
+
+void TestDeltas() {
+    // A reader's market by price view, rebuilt from the deltas alone
+    using Key = std::tuple<InstrumentID, DeltaSide, Tick>;
+    std::map<Key, std::pair<int64_t, uint32_t>> view;
+    auto apply = [&view] (DeltaReader & reader) {
+        std::size_t read{0};
+        LevelDelta delta;
+        while (reader.Poll(delta)) {
+            ++read;
+            Key key{delta.Instrument_, delta.Side_, delta.Price_};
+            switch (delta.Action_) {
+                case DeltaAction::INSERT:
+                    assert(view.count(key) == 0 && "An inserted level should be new");
+                    view[key] = {delta.Volume_, delta.Orders_};
+                    break;
+                case DeltaAction::UPDATE:
+                    assert(view.count(key) == 1 && "An updated level should exist");
+                    view[key] = {delta.Volume_, delta.Orders_};
+                    break;
+                case DeltaAction::REMOVE: {
+                    [[maybe_unused]] auto erased = view.erase(key);
+                    assert(erased == 1 && "A removed level should exist");
+                    break;
+                }
+                default:
+                    view.clear();
+                    break;
+            }
+        }
+        return read;
+    };
+    [[maybe_unused]] auto matches = [&view] (const Implementation & book, const std::string & security) {
+        auto instrument = book.Instrument(security);
+        std::size_t levels{0};
+        for (auto direction : {OrderDirection_t::BUY, OrderDirection_t::SELL}) {
+            auto side = direction == OrderDirection_t::BUY ? DeltaSide::BID : DeltaSide::ASK;
+            for (int index = 0; index < static_cast<int>(book.BookDepth(instrument, direction)); ++index) {
+                auto level = book.Get(instrument, direction, index);
+                auto price = level.first->Price_;
+                int64_t volume{0};
+                uint32_t orders{0};
+                for (; level.first != level.second; ++level.first, ++orders) {
+                    volume += level.first->Volume_;
+                }
+                auto found = view.find(Key{instrument, side, price});
+                if (found == view.end() || found->second != std::make_pair(volume, orders)) {
+                    return false;
+                }
+                ++levels;
+            }
+        }
+        return levels == static_cast<std::size_t>(std::count_if(view.begin(), view.end(), [instrument] (const std::pair<const Key, std::pair<int64_t, uint32_t>> & entry) { return std::get<0>(entry.first) == instrument; }));
+    };
+
+    orderbook::Implementation book;
+    DeltaPublisher publisher;
+    DeltaReader reader;
+    [[maybe_unused]] int rc = publisher.Open("", 1024);
+    assert(rc == SUCCESS && "The ring should open");
+    rc = reader.Open(publisher);
+    assert(rc == SUCCESS && "The reader should open");
+    book.PublishDeltas(&publisher);
+    for (auto & order : datafeed) {
+        book.Process(order);
+    }
+    [[maybe_unused]] auto read = apply(reader);
+    assert(read > 0 && matches(book, "US30303M1027") && matches(book, "US02079K1079") && "The view should match the book");
+
+    // A sweep publishes each level it trades through once
+    const std::string security{"US5949181045"};
+    Fill fills[8];
+    book.EnableMatching(fills, 8);
+    book.Process({ 20, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, security, 10.0, 100 });
+    book.Process({ 21, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, security, 10.0, 100 });
+    book.Process({ 22, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, security, 10.5, 100 });
+    apply(reader);
+    book.Process({ 23, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 10.5, 250 });
+    read = apply(reader);
+    assert(read == 2 && matches(book, security) && "The swept levels should be published once each");
+    book.DisableMatching();
+
+    // Conflated, a batch publishes each level it leaves changed once, and nothing for one it put back
+    DeltaPublisher conflated;
+    DeltaReader slow;
+    rc = conflated.Open("", 1024, true);
+    assert(rc == SUCCESS && "The conflated ring should open");
+    rc = slow.Open(conflated);
+    assert(rc == SUCCESS && "The conflated reader should open");
+    book.PublishDeltas(&conflated);
+    std::vector<Order> packet {
+        { 30, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 9.0, 100 },
+        { 31, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 9.0, 100 },
+        { 30, OrderAction_t::Modify, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 9.0, 50 },
+        { 32, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 8.0, 100 },
+        { 32, OrderAction_t::Modify, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 7.0, 100 },
+        { 32, OrderAction_t::Delete, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, "", 0.0, 0 },
+    };
+    book.ProcessBatch(packet.data(), packet.size(), nullptr);
+    read = apply(slow);
+    assert(read == 1 && "Only the level at 9.0 should be published");
+    [[maybe_unused]] auto level = view[Key{book.Instrument(security), DeltaSide::BID, ToTick(9.0f)}];
+    assert(level.first == 150 && level.second == 2 && "The conflated level should be as it was left");
+
+    // A reader that falls a ring behind is told so, and can rebuild from a refresh
+    auto name = "/orderbook_test_" + std::to_string(::getpid());
+    DeltaPublisher small;
+    DeltaReader behind;
+    rc = small.Open(name, 8);
+    assert(rc == SUCCESS && "The shared memory ring should open");
+    rc = behind.Open(name);
+    assert(rc == SUCCESS && "The shared memory reader should open");
+    book.PublishDeltas(&small);
+    for (int i = 0; i < 20; ++i) {
+        book.Process({ 40 + i, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, security, 20.0f + static_cast<float>(i), 10 });
+    }
+    LevelDelta delta;
+    [[maybe_unused]] auto polled = behind.Poll(delta);
+    assert(polled && delta.Action_ == DeltaAction::GAP && behind.Lost() > 0 && "An overwritten reader should see a GAP");
+    book.PublishDeltas(&publisher);
+    book.PublishRefresh(book.Instrument(security));
+    apply(reader);
+    assert(matches(book, security) && "A refresh should rebuild the view");
+    book.PublishDeltas(nullptr);
+
+    std::cout<<"Delta tests passed...."<<std::endl;
+}
+
+void TestQuotes() {
+    orderbook::Implementation book;
+    QuoteBoard board(16);
+    book.PublishQuotes(&board);
+    for (auto & order : datafeed) {
+        book.Process(order);
+    }
+    for (auto security : {"US30303M1027", "US02079K1079"}) {
+        TopOfBook top{};
+        [[maybe_unused]] auto read = board.Read(book.Instrument(security), top);
+        assert(read && top.Updates_ > 0 && "The snapshot should have been published");
+        for (auto direction : {OrderDirection_t::BUY, OrderDirection_t::SELL}) {
+            auto levels = direction == OrderDirection_t::BUY ? top.BidLevels_ : top.AskLevels_;
+            [[maybe_unused]] const auto * quotes = direction == OrderDirection_t::BUY ? top.Bids_ : top.Asks_;
+            assert(levels == std::min(book.BookDepth(security, direction), TopOfBook::DEPTH) && "The snapshot should hold the top levels");
+            for (uint32_t index = 0; index < levels; ++index) {
+                auto level = book.Get(security, direction, static_cast<int>(index));
+                int64_t volume{0};
+                for (auto it = level.first; it != level.second; ++it) {
+                    volume += it->Volume_;
+                }
+                assert(quotes[index].Price_ == level.first->Price_ && quotes[index].Volume_ == volume && "Snapshot levels should match the book");
+            }
+        }
+    }
+
+    // A reader on another thread only ever sees whole snapshots. Every order is for 100, so a level
+    // whose volume isn't 100 a order was torn.
+    const std::string security{"US5949181045"};
+    book.Process({ 100, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 1.0, 100 });
+    auto instrument = book.Instrument(security);
+    std::atomic<bool> done{false};
+    std::size_t reads{0};
+    std::thread reader([&] {
+        TopOfBook top{};
+        while (!done.load(std::memory_order_acquire)) {
+            board.Read(instrument, top);
+            for (uint32_t index = 0; index < top.BidLevels_; ++index) {
+                assert(top.Bids_[index].Volume_ == 100 * static_cast<int64_t>(top.Bids_[index].Orders_) && "A snapshot should never be torn");
+                assert((index == 0 || top.Bids_[index].Price_ < top.Bids_[index - 1].Price_) && "Snapshot levels should be best first");
+            }
+            ++reads;
+        }
+    });
+    for (int i = 0; i < 20000; ++i) {
+        auto price = 10.0f + static_cast<float>(i % 7);
+        book.Process({ 1000 + i, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, price, 100 });
+        if (i >= 10) {
+            book.Process({ 1000 + i - 10, OrderAction_t::Delete, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, "", 0.0, 0 });
+        }
+    }
+    done.store(true, std::memory_order_release);
+    reader.join();
+    assert(reads > 0 && "The reader should have read snapshots");
+    book.PublishQuotes(nullptr);
+
+    std::cout<<"Quote tests passed...."<<std::endl;
+}
+
+void TestDepth() {
+    // Every kernel gives the scalar answer, over lengths that end on and off a vector boundary
+    std::vector<Tick> asks, bids;
+    std::vector<int64_t> volumes;
+    for (int i = 0; i < 37; ++i) {
+        asks.push_back(ToTick(100.0f) + i * (1 + i % 3));
+        bids.push_back(ToTick(100.0f) - i * (1 + i % 3));
+        volumes.push_back(1 + (i * 7919) % 500);
+    }
+    auto isa = depth::Active();
+    std::vector<std::tuple<int64_t, int64_t, std::size_t, int64_t, std::size_t, int64_t>> expected;
+    for (auto kernels : {depth::Isa::SCALAR, depth::Isa::SSE42, depth::Isa::AVX2}) {
+        if (!depth::Use(kernels)) {
+            continue;
+        }
+        [[maybe_unused]] std::size_t check{0};
+        for (std::size_t count = 0; count <= volumes.size(); ++count) {
+            std::vector<int64_t> sums(count);
+            depth::PrefixVolume(volumes.data(), count, sums.data());
+            for (std::size_t i = 0; i < count; ++i) {
+                assert(sums[i] == (i ? sums[i - 1] : 0) + volumes[i] && "The prefix volume should be a running total");
+            }
+            for (int64_t quantity : {int64_t{1}, int64_t{750}, int64_t{4000}, int64_t{1} << 40}) {
+                int64_t filled, askVolume, bidVolume;
+                auto cost = depth::CostToFill(asks.data(), volumes.data(), count, quantity, filled);
+                auto askLevels = depth::LevelsWithin(asks.data(), volumes.data(), count, asks[0] + quantity % 50, true, askVolume);
+                auto bidLevels = depth::LevelsWithin(bids.data(), volumes.data(), count, bids[0] - quantity % 50, false, bidVolume);
+                std::tuple<int64_t, int64_t, std::size_t, int64_t, std::size_t, int64_t> result{cost, filled, askLevels, askVolume, bidLevels, bidVolume};
+                if (kernels == depth::Isa::SCALAR) {
+                    assert(filled == std::min(quantity, count ? sums.back() : 0) && "Filling should stop when the side runs out");
+                    expected.push_back(result);
+                } else {
+                    assert(expected[check++] == result && "Every kernel should agree with the scalar one");
+                }
+            }
+        }
+    }
+    depth::Use(isa);
+
+    // The depth book follows the book through adds, modifies, deletes and a sweep
+    orderbook::Implementation book;
+    DepthBook view;
+    book.PublishDepth(&view);
+    std::vector<Fill> fills(16);
+    for (auto & order : datafeed) {
+        book.Process(order);
+    }
+    const std::string security{"US30303M1027"};
+    auto instrument = book.Instrument(security);
+    book.EnableMatching(fills.data(), fills.size());
+    book.Process({ 500, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, security, 0.0, 150 });
+    book.DisableMatching();
+
+    for (auto direction : {OrderDirection_t::BUY, OrderDirection_t::SELL}) {
+        auto side = direction == OrderDirection_t::BUY ? DeltaSide::BID : DeltaSide::ASK;
+        Quote levels[64];
+        auto count = book.TopLevels(instrument, direction, levels, 64);
+        [[maybe_unused]] const auto & held = view.Levels(instrument, side);
+        assert(held.Size() == count && "The depth book should hold every level");
+        int64_t cost{0}, total{0};
+        for (std::size_t i = 0; i < count; ++i) {
+            assert(held.prices_[i] == levels[i].Price_ && held.volumes_[i] == levels[i].Volume_ && "Depth levels should match the book");
+            cost += levels[i].Price_ * levels[i].Volume_;
+            total += levels[i].Volume_;
+        }
+        [[maybe_unused]] int64_t filled, volume;
+        assert(view.CostToFill(instrument, side, total, filled) == cost && filled == total && "Filling the whole side should cost every level");
+        assert(std::abs(view.Vwap(instrument, side, total) - static_cast<double>(cost) / static_cast<double>(total)) < 1e-9 && "VWAP should be the cost over the volume");
+        assert(view.LevelsWithin(instrument, side, 0, volume) == 1 && volume == levels[0].Volume_ && "The band at the best price should be the top level");
+        assert(volume == book.VolumeWithin(instrument, direction, 0) && "Volume in the band should match the book");
+    }
+
+    // Setting it on a loaded book loads the levels, and a reset clears them
+    DepthBook late;
+    book.PublishDepth(&late);
+    assert(late.Levels(instrument, DeltaSide::BID).prices_ == view.Levels(instrument, DeltaSide::BID).prices_ && "A late depth book should be loaded");
+    book.Reset();
+    assert(late.Levels(instrument, DeltaSide::BID).Size() == 0 && "A reset should clear the depth book");
+    book.PublishDepth(nullptr);
+
+    std::cout<<"Depth tests passed...."<<std::endl;
+}
+
+void TestBbo() {
+    // The table follows each security's best levels, and only moves when they do
+    orderbook::Implementation book;
+    for (auto & order : datafeed) {
+        book.Process(order);
+    }
+    BboTable table(8);
+    book.PublishBbo(&table);
+    for (auto security : {"US30303M1027", "US02079K1079"}) {
+        auto instrument = book.Instrument(security);
+        [[maybe_unused]] auto bbo = table.Get(instrument);
+        [[maybe_unused]] Quote bid, ask;
+        assert(book.LevelAt(instrument, OrderDirection_t::BUY, 0, bid) && book.LevelAt(instrument, OrderDirection_t::SELL, 0, ask) && "The test books should be two sided");
+        assert(bbo.BidPrice_ == bid.Price_ && bbo.BidVolume_ == bid.Volume_ && bbo.AskPrice_ == ask.Price_ && bbo.AskVolume_ == ask.Volume_ && "The table should hold the best levels");
+    }
+
+    const std::string security{"US5949181045"};
+    [[maybe_unused]] auto start = table.Sequence();
+    book.Process({ 100, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 10.0, 100 });
+    book.Process({ 101, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, security, 10.5, 100 });
+    auto instrument = book.Instrument(security);
+    [[maybe_unused]] InstrumentID found[8];
+    assert(table.MovedSince(start, found, 8) == 1 && found[0] == instrument && "Only the security with new orders should have moved");
+    [[maybe_unused]] auto quiet = table.Sequence();
+    book.Process({ 102, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 9.0, 100 });
+    assert(table.Sequence() == quiet && table.MovedSince(quiet, found, 8) == 0 && "A level behind the best shouldn't move it");
+    assert(table.WiderThan(49, found, 8) == 1 && found[0] == instrument && table.WiderThan(50, found, 8) == 0 && "The spread should be 50 ticks");
+
+    book.Process({ 103, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, security, 10.0, 100 });
+    assert(table.Crossed(found, 8) == 0 && table.Crossed(found, 8, true) == 1 && found[0] == instrument && "The book should be locked");
+    book.Process({ 103, OrderAction_t::Modify, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, security, 9.5, 100 });
+    assert(table.Crossed(found, 8) == 1 && found[0] == instrument && "The book should be crossed");
+    [[maybe_unused]] auto stats = table.Statistics();
+    assert(stats.twoSided_ == 3 && stats.crossed_ == 1 && stats.locked_ == 0 && stats.oneSided_ == 0 && "Statistics should count the books");
+
+    book.Process({ 100, OrderAction_t::Delete, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, "", 0.0, 0 });
+    [[maybe_unused]] auto bbo = table.Get(instrument);
+    assert(bbo.BidPrice_ == ToTick(9.0f) && bbo.AskPrice_ == ToTick(9.5f) && "Deleting the best bid should uncover the next");
+    book.Reset();
+    assert(table.Statistics().twoSided_ == 0 && table.Get(instrument).BidPrice_ == BboTable::NO_BID && "A reset should empty the table");
+    book.PublishBbo(nullptr);
+
+    // Every kernel finds what the scalar scans do, over a table whose size isn't a whole block
+    BboTable market(1003);
+    uint64_t seed{7};
+    auto next = [&seed] (uint64_t range) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<int64_t>((seed >> 33) % range);
+    };
+    for (InstrumentID id = 0; id < 1003; ++id) {
+        auto shape = next(8);
+        auto bid = ToTick(50.0f) + next(20);
+        market.Set(id, shape == 0 ? BboTable::NO_BID : bid, 100, shape == 1 ? BboTable::NO_ASK : bid + next(30) - 3, 100);
+    }
+    auto isa = bbo::Active();
+    std::vector<std::vector<InstrumentID>> expected;
+    std::vector<int64_t> totals;
+    for (auto kernels : {bbo::Isa::SCALAR, bbo::Isa::SSE42, bbo::Isa::AVX2}) {
+        if (!bbo::Use(kernels)) {
+            continue;
+        }
+        std::vector<std::vector<InstrumentID>> results;
+        std::vector<InstrumentID> out(1003);
+        auto collect = [&results, &out] (std::size_t count) {
+            results.emplace_back(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(count));
+        };
+        collect(market.Crossed(out.data(), out.size()));
+        collect(market.Crossed(out.data(), out.size(), true));
+        collect(market.WiderThan(20, out.data(), out.size()));
+        collect(market.MovedSince(900, out.data(), out.size()));
+        assert(market.Crossed(out.data(), 3) == results[0].size() && "A full buffer should still count every match");
+        auto summary = market.Statistics();
+        std::vector<int64_t> counts{static_cast<int64_t>(summary.twoSided_), static_cast<int64_t>(summary.oneSided_),
+                                    static_cast<int64_t>(summary.crossed_), static_cast<int64_t>(summary.locked_), summary.spread_};
+        if (kernels == bbo::Isa::SCALAR) {
+            assert(!results[0].empty() && results[1].size() > results[0].size() && results[3].size() == 103 && "The market should have crossed, locked and moved books");
+            assert(summary.twoSided_ + summary.oneSided_ == 1003 && "Every book should have a side");
+            expected = results;
+            totals = counts;
+        } else {
+            assert(results == expected && counts == totals && "Every kernel should agree with the scalar one");
+        }
+    }
+    bbo::Use(isa);
+
+    std::cout<<"BBO tests passed...."<<std::endl;
+}
+
+void TestText() {
+    auto base = "/tmp/orderbook_test_" + std::to_string(::getpid());
+    orderbook::Implementation direct;
+    for (auto & order : datafeed) {
+        direct.Process(order);
+    }
+
+    // The feed written as CSV and as FIX loads into the same book as the feed itself, read or mapped
+    for (auto format : {text::Format::CSV, text::Format::FIX}) {
+        auto path = base + (format == text::Format::FIX ? ".fix" : ".csv");
+        [[maybe_unused]] int rc = text::Write(path, datafeed, format);
+        assert(rc == SUCCESS && "The text file should be written");
+        for (auto map : {false, true}) {
+            orderbook::Implementation book;
+            text::LoadStats stats;
+            rc = text::Load(path, book, stats, text::Format::AUTO, map);
+            assert(rc == SUCCESS && "The text file should load");
+            assert(stats.messages_ == datafeed.size() && stats.malformed_ == 0 && "Every order should be parsed");
+            for (auto security : {"US30303M1027", "US02079K1079"}) {
+                for (auto direction : {OrderDirection_t::BUY, OrderDirection_t::SELL}) {
+                    assert(book.BookDepth(security, direction) == direct.BookDepth(security, direction) && "Loaded book depths should match");
+                    for (int index = 0; index < static_cast<int>(book.BookDepth(security, direction)); ++index) {
+                        auto lhs = book.Get(security, direction, index);
+                        auto rhs = direct.Get(security, direction, index);
+                        for (; lhs.first != lhs.second && rhs.first != rhs.second; ++lhs.first, ++rhs.first) {
+                            assert(lhs.first->OrderID_ == rhs.first->OrderID_ && lhs.first->Price_ == rhs.first->Price_ && lhs.first->Volume_ == rhs.first->Volume_ && "Loaded queues should match");
+                        }
+                        assert(lhs.first == lhs.second && rhs.first == rhs.second && "Loaded levels should be the same length");
+                    }
+                }
+            }
+        }
+        ::unlink(path.c_str());
+    }
+
+    // Headers and blank lines are skipped, bad lines counted, and prices rounded as ToTick does
+    const std::string csv = "OrderID,Action,Direction,Constraints,SecurityID,Price,Volume\r\n"
+                            "1,Add,BUY,LIMIT,US5949181045,100.1,500\r\n"
+                            "\n"
+                            "2,Add,SELL,,US5949181045,99.995,10\n"
+                            "3,Add,BUY,LIMIT,US5949181045,1x.0,10\n"
+                            "4,Delete,,,,,\n"
+                            "5,Modify,SELL,LIMIT,US5949181045,-0.5,7";
+    std::vector<wire::Record> records(8);
+    std::size_t count;
+    text::Parser parser;
+    [[maybe_unused]] auto used = parser.Parse(csv.data(), csv.size(), records.data(), records.size(), count);
+    assert(used < csv.size() && count == 3 && "The last line shouldn't be parsed without a newline");
+    assert(parser.Detected() == text::Format::CSV && "A comma should be detected as CSV");
+    assert(parser.Stats().malformed_ == 1 && "The bad price should be counted");
+    assert(records[0].OrderID_ == 1 && records[0].Price_ == 10010 && records[0].Volume_ == 500 && std::string(records[0].SecurityID_) == "US5949181045" && "The add should be parsed");
+    assert(records[1].Price_ == ToTick(99.995f) && records[1].Price_ == 10000 && records[1].OrderDirection_ == compact::ORDER_DIRECTION_SELL && "The price should round to the nearest tick");
+    assert(records[2].OrderID_ == 4 && records[2].OrderAction_ == compact::ORDER_ACTION_DELETE && records[2].SecurityID_[0] == '\0' && "A delete needs only its id");
+    text::Parser whole;
+    used = whole.Parse(csv.data(), csv.size(), records.data(), records.size(), count, true);
+    assert(used == csv.size() && count == 4 && records[3].Price_ == -50 && "The last line should be parsed when it is the end");
+
+    const std::string fix = "35=D|11=7|54=2|40=1|55=US5949181045|38=25|60=20240101\n35=F\x01" "11=8\x01" "41=7\n35=G|54=1\n";
+    text::Parser tags;
+    used = tags.Parse(fix.data(), fix.size(), records.data(), records.size(), count);
+    assert(used == fix.size() && count == 2 && tags.Detected() == text::Format::FIX && "Both separators should be read as FIX");
+    assert(records[0].OrderID_ == 7 && records[0].OrderConstraints_ == compact::ORDER_CONSTRAINT_MARKET && records[0].Volume_ == 25 && "Other tags should be ignored");
+    assert(records[1].OrderID_ == 7 && records[1].OrderAction_ == compact::ORDER_ACTION_DELETE && "A delete should name the original order");
+    assert(tags.Stats().malformed_ == 1 && "A line without an order id should be counted");
+
+    // A whole part too long to scale to ticks is malformed rather than overflowing
+    const std::string huge = "9,Add,BUY,LIMIT,US5949181045,999999999999999999.5,10\n10,Add,BUY,LIMIT,US5949181045,92233720368547759.0,10\n";
+    text::Parser outliers;
+    used = outliers.Parse(huge.data(), huge.size(), records.data(), records.size(), count);
+    assert(used == huge.size() && count == 0 && outliers.Stats().malformed_ == 2 && "Prices that would overflow should be counted");
+
+    // The text split anywhere parses the same, and every kernel finds the same delimiters as the scalar one
+    std::string feed;
+    for (int i = 0; i < 300; ++i) {
+        feed += std::to_string(i) + ",Add," + (i % 2 ? "SELL" : "BUY") + ",LIMIT,US5949181045," + std::to_string(i % 97) + "." + std::to_string(i % 10) + "," + std::to_string(i) + "\n";
+    }
+    auto isa = text::Active();
+    std::vector<int64_t> expected;
+    for (auto kernels : {text::Isa::SCALAR, text::Isa::SSE42, text::Isa::AVX2}) {
+        if (!text::Use(kernels)) {
+            continue;
+        }
+        for (std::size_t chunk : {std::size_t{7}, std::size_t{64}, feed.size()}) {
+            text::Parser split(text::Format::CSV);
+            std::vector<int64_t> parsed;
+            std::size_t offset{0}, held{0};
+            while (offset < feed.size()) {
+                held = std::min(feed.size(), held + chunk);
+                offset += split.Parse(feed.data() + offset, held - offset, records.data(), records.size(), count);
+                for (std::size_t i = 0; i < count; ++i) {
+                    parsed.push_back(records[i].OrderID_ * 1000000 + records[i].Price_ * 100 + records[i].OrderDirection_);
+                }
+            }
+            assert(parsed.size() == 300 && split.Stats().malformed_ == 0 && "Every line should be parsed once");
+            if (expected.empty()) {
+                expected = parsed;
+            } else {
+                assert(parsed == expected && "Every kernel and split should agree");
+            }
+        }
+    }
+    text::Use(isa);
+
+    std::cout<<"Text tests passed...."<<std::endl;
+}
+
+void TestHarness() {
+    // The fingerprint kept as the book changes matches one computed from its orders, however it got there
+    orderbook::Implementation direct;
+    direct.KeepFingerprint(true);
+    for (auto & order : datafeed) {
+        direct.Process(order);
+        assert(direct.Fingerprint() == direct.ComputeFingerprint() && "The kept fingerprint should match the book");
+    }
+    orderbook::Implementation late;
+    for (auto & order : datafeed) {
+        late.Process(order);
+    }
+    late.KeepFingerprint(true);
+    assert(late.Fingerprint() == direct.Fingerprint() && direct.Fingerprint() != 0 && "Turning the fingerprint on should compute it");
+
+    const std::string security{"US5949181045"};
+    Fill fills[8];
+    direct.EnableMatching(fills, 8);
+    direct.Process({ 1000, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, security, 10.0, 100 });
+    direct.Process({ 1001, OrderAction_t::Add, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, security, 10.5, 100 });
+    direct.Process({ 1002, OrderAction_t::Add, OrderDirection_t::BUY, OrderConstraints_t::LIMIT, security, 10.5, 150 });
+    direct.Process({ 1001, OrderAction_t::Modify, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, security, 10.5, 20 });
+    assert(direct.FillCount() == 2 && direct.Fingerprint() == direct.ComputeFingerprint() && "Fills should change the fingerprint as they change the book");
+    direct.DisableMatching();
+    direct.Process({ 1001, OrderAction_t::Delete, OrderDirection_t::SELL, OrderConstraints_t::LIMIT, "", 0.0, 0 });
+    assert(direct.Fingerprint() == late.Fingerprint() && "Removing the orders again should restore the fingerprint");
+    direct.Reset();
+    assert(direct.Fingerprint() == 0 && "An empty book should have no fingerprint");
+
+    // Captures and text replay to the same fingerprint on any number of threads, and partitions of a
+    // day sum to the whole day
+    auto base = "/tmp/orderbook_test_" + std::to_string(::getpid());
+    auto capture = base + ".bin";
+    auto csv = base + ".csv";
+    [[maybe_unused]] int rc = wire::Write(capture, datafeed);
+    assert(rc == SUCCESS && "The capture should be written");
+    rc = text::Write(csv, datafeed, text::Format::CSV);
+    assert(rc == SUCCESS && "The text day should be written");
+    std::vector<harness::Run> runs{{capture}, {csv}, {csv, 0, 1, true}};
+    for (uint32_t partition = 0; partition < 3; ++partition) {
+        runs.push_back(harness::Run{capture, partition, 3});
+    }
+    auto results = harness::Replay(runs, 4);
+    auto serial = harness::Replay(runs, 1);
+    uint64_t parts{0};
+    std::size_t orders{0};
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        assert(results[i].rc_ == SUCCESS && results[i].name_ == runs[i].Name() && "Every run should replay in order");
+        assert(results[i].fingerprint_ == serial[i].fingerprint_ && results[i].messages_ == serial[i].messages_ && "Results shouldn't depend on the threads");
+        if (i < 3) {
+            assert(results[i].fingerprint_ == late.Fingerprint() && results[i].orders_ == late.Orders() && "Every form of the day should replay the same book");
+        } else {
+            parts += results[i].fingerprint_;
+            orders += results[i].orders_;
+        }
+    }
+    assert(parts == late.Fingerprint() && orders == late.Orders() && "The partitions should add up to the day");
+
+    // Golden fingerprints written by one run check the next, the text day read and mapped sharing a line
+    auto golden = base + ".golden";
+    std::map<std::string, uint64_t> expected;
+    std::ostringstream report;
+    rc = harness::WriteGolden(golden, results);
+    assert(rc == SUCCESS && "The golden file should be written");
+    rc = harness::ReadGolden(golden, expected);
+    assert(rc == SUCCESS && "The golden file should be read back");
+    assert(expected.size() == runs.size() - 1 && harness::Report(results, expected, report) == 0 && "A run should match its own golden file");
+    expected[runs[0].Name()] ^= 1;
+    expected.erase(runs[3].Name());
+    assert(harness::Report(results, expected, report) == 2 && report.str().find("MISMATCH") != std::string::npos && "A changed or missing fingerprint should fail");
+    std::map<std::string, uint64_t> day{{capture, late.Fingerprint()}};
+    std::vector<harness::Result> partitions(results.begin() + 3, results.end());
+    assert(harness::Report(partitions, day, report) == 0 && "Partitions should be checked against their day");
+    partitions[0].fingerprint_ ^= 1;
+    assert(harness::Report(partitions, day, report) == 3 && "A wrong partition should fail its whole day");
+    assert(harness::Replay(harness::Run{base + ".missing"}).rc_ != SUCCESS && "A missing day should fail");
+
+    ::unlink(capture.c_str());
+    ::unlink(csv.c_str());
+    ::unlink(golden.c_str());
+
+    std::cout<<"Harness tests passed...."<<std::endl;
+}
+
+void TestPipeline() {
+    orderbook::Implementation direct;
+    direct.KeepFingerprint(true);
+    for (auto & order : datafeed) {
+        direct.Process(order);
+    }
+
+    // Every file form, read or mapped, in blocks small enough to split lines and records, waiting
+    // either way, applies the same book as the feed itself
+    auto base = "/tmp/orderbook_test_" + std::to_string(::getpid());
+    std::vector<std::string> paths{base + ".bin", base + ".csv", base + ".fix"};
+    [[maybe_unused]] int rc = wire::Write(paths[0], datafeed);
+    assert(rc == SUCCESS && "The capture should be written");
+    rc = text::Write(paths[1], datafeed, text::Format::CSV);
+    assert(rc == SUCCESS && "The CSV file should be written");
+    rc = text::Write(paths[2], datafeed, text::Format::FIX);
+    assert(rc == SUCCESS && "The FIX file should be written");
+    for (const auto & path : paths) {
+        for (auto map : {false, true}) {
+            for (auto wait : {Pipeline::Wait::BUSY, Pipeline::Wait::SLEEP}) {
+                Pipeline::Config config;
+                config.blockSize_ = 100;
+                config.blocks_ = 2;
+                config.batches_ = 2;
+                config.map_ = map;
+                config.wait_ = wait;
+                config.sleep_ = std::chrono::microseconds(10);
+                orderbook::Implementation book;
+                book.KeepFingerprint(true);
+                Pipeline pipeline(book, config);
+                rc = pipeline.Run(path);
+                assert(rc == SUCCESS && "The file should be ingested");
+                [[maybe_unused]] const auto & stats = pipeline.Statistics();
+                assert(stats.messages_ == datafeed.size() && stats.malformed_ == 0 && "Every order should reach the book");
+                assert(book.Fingerprint() == direct.Fingerprint() && book.Orders() == direct.Orders() && "The ingested book should match the feed");
+                assert(stats.reader_.items_ > 1 && stats.decoder_.items_ == stats.reader_.items_ && stats.book_.items_ > 0 && stats.book_.items_ <= stats.decoder_.items_ &&
+                       "Every block should pass through the decoder, and a batch go on for each that held orders");
+                assert(stats.decoder_.maxDepth_ >= 1 && stats.decoder_.maxDepth_ <= 2 && stats.book_.maxDepth_ <= 2 && "Queue depths should be bounded by the rings");
+            }
+        }
+    }
+
+    // Securities the book already holds keep their ids, and a pipeline can be run again
+    orderbook::Implementation book;
+    book.KeepFingerprint(true);
+    [[maybe_unused]] auto known = book.Register("US02079K1079", 12);
+    Pipeline pipeline(book, Pipeline::Config{});
+    rc = pipeline.Run(paths[0]);
+    assert(rc == SUCCESS && book.Instrument("US02079K1079") == known && book.Fingerprint() == direct.Fingerprint() && "Known securities should be kept");
+    book.Reset();
+    rc = pipeline.Run(paths[1]);
+    assert(rc == SUCCESS && book.Fingerprint() == direct.Fingerprint() && book.Symbols().Size() == direct.Symbols().Size() && "A second run should apply the same book");
+    rc = pipeline.Run(base + ".missing");
+    assert(rc != SUCCESS && "A missing file should fail");
+
+    // A line longer than a block is one malformed line, not pieces parsed as lines of their own
+    {
+        std::ofstream out(paths[1], std::ios::trunc);
+        out<<"1,Add,BUY,LIMIT,US5949181045,10.0,5\n"<<"9"<<std::string(150, 'x')<<"7,Add,BUY,LIMIT,US5949181045,10.0,5\n"
+           <<"2,Add,SELL,LIMIT,US5949181045,11.0,5\n";
+    }
+    for (auto map : {false, true}) {
+        Pipeline::Config config;
+        config.blockSize_ = 100;
+        config.map_ = map;
+        orderbook::Implementation book;
+        Pipeline pipeline(book, config);
+        rc = pipeline.Run(paths[1]);
+        [[maybe_unused]] const auto & stats = pipeline.Statistics();
+        assert(rc == SUCCESS && stats.messages_ == 2 && stats.malformed_ == 1 && book.Orders() == 2 && "The long line should be counted once as malformed");
+    }
+
+    for (const auto & path : paths) {
+        ::unlink(path.c_str());
+    }
+
+    std::cout<<"Pipeline tests passed...."<<std::endl;
+}
+
+void TestLogger() {
+    std::ostringstream out;
+    {
+        // The writer sleeps until flushed, so a ring of 2 fills deterministically
+        Logger logger(out, {2, 1, std::chrono::hours(1)});
+        LogRecord record{LogEvent::UNKNOWN_ORDER, 0, NO_INSTRUMENT, 1, 0, {}};
+        [[maybe_unused]] auto logged = logger.Log(record);
+        assert(logged && "The first event should fit in the ring");
+        record.order_ = 2;
+        logged = logger.Log(record);
+        assert(logged && "The second event should fit in the ring");
+        logged = logger.Log(record);
+        assert(!logged && "A full ring should drop rather than block");
+        logger.Flush();
+        assert(logger.Dropped() == 1 && "The dropped event should be counted");
+        assert(logger.Written() == 1 && logger.Suppressed() == 1 && "Events over the rate should be suppressed");
+    }
+    assert(out.str().find("Could not find entry for OrderID [1]") != std::string::npos && "The first event should be written");
+    assert(out.str().find("Logger dropped 1 events") != std::string::npos && "Drops should be reported when the logger stops");
+
+    std::cout<<"Logger tests passed...."<<std::endl;
+}
     
 } // namespace orderbook
 
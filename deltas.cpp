@@ -0,0 +1,238 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#include "deltas.hpp"
+#include "orderbook.hpp"
+
+namespace orderbook {
+
+    namespace {
+
+        std::size_t RingSize(uint64_t capacity) {
+            return sizeof(DeltaRingHeader) + capacity * sizeof(DeltaSlot);
+        }
+
+        std::size_t HashLevel(const LevelDelta & delta) {
+            auto key = static_cast<uint64_t>(delta.Price_) * 0x9E3779B97F4A7C15ULL;
+            key ^= (static_cast<uint64_t>(delta.Instrument_) << 1 | static_cast<uint64_t>(delta.Side_)) * 0xC2B2AE3D27D4EB4FULL;
+            return static_cast<std::size_t>(key ^ (key >> 29));
+        }
+
+        bool SameLevel(const LevelDelta & a, const LevelDelta & b) {
+            return a.Price_ == b.Price_ && a.Instrument_ == b.Instrument_ && a.Side_ == b.Side_;
+        }
+
+    } // namespace
+
+    DeltaPublisher::~DeltaPublisher() {
+        Close();
+    }
+
+    int DeltaPublisher::Open(const std::string & name, std::size_t capacity, bool conflate) {
+        Close();
+
+        uint64_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        auto bytes = RingSize(size);
+
+        void * data;
+        if (name.empty()) {
+            data = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        } else {
+            int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                std::cerr<<"Could not create delta ring "<<name<<'\n';
+                return ERR_IO;
+            }
+            data = ::ftruncate(fd, static_cast<off_t>(bytes)) == 0 ? ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+            ::close(fd);
+            if (data == MAP_FAILED) {
+                ::shm_unlink(name.c_str());
+            }
+        }
+        if (data == MAP_FAILED) {
+            std::cerr<<"Could not map delta ring "<<name<<'\n';
+            return ERR_IO;
+        }
+
+        // Fresh pages are zero, so every slot starts out holding nothing
+        header_ = new (data) DeltaRingHeader;
+        std::memcpy(header_->magic_, DELTA_MAGIC, sizeof(DELTA_MAGIC));
+        header_->version_ = DELTA_VERSION;
+        header_->slotSize_ = sizeof(DeltaSlot);
+        header_->capacity_ = size;
+        header_->head_.store(0, std::memory_order_release);
+        slots_ = reinterpret_cast<DeltaSlot *>(header_ + 1);
+        size_ = bytes;
+        mask_ = size - 1;
+        next_ = 0;
+        name_ = name;
+
+        conflate_ = conflate;
+        pending_.clear();
+        if (conflate) {
+            pending_.reserve(PENDING);
+            table_.assign(PENDING * 2, 0);
+        }
+        return SUCCESS;
+    }
+
+    void DeltaPublisher::Close() {
+        if (header_ == nullptr) {
+            return;
+        }
+        Flush();
+        ::munmap(header_, size_);
+        if (!name_.empty()) {
+            ::shm_unlink(name_.c_str());
+        }
+        header_ = nullptr;
+        slots_ = nullptr;
+    }
+
+    void DeltaPublisher::Stage(const LevelDelta & delta) {
+        auto mask = table_.size() - 1;
+        auto slot = HashLevel(delta) & mask;
+        while (table_[slot] != 0) {
+            auto & held = pending_[table_[slot] - 1];
+            if (SameLevel(held.delta_, delta)) {
+                // Only what a reader would see at Flush matters. A level inserted and removed again in
+                // between never existed for them, and one removed and inserted again was only updated.
+                auto was = held.delta_.Action_;
+                auto live = held.live_;
+                held.delta_ = delta;
+                held.live_ = true;
+                if (!live) {
+                    return;
+                }
+                if (was == DeltaAction::INSERT) {
+                    held.live_ = delta.Action_ != DeltaAction::REMOVE;
+                    held.delta_.Action_ = DeltaAction::INSERT;
+                } else if (was == DeltaAction::REMOVE && delta.Action_ == DeltaAction::INSERT) {
+                    held.delta_.Action_ = DeltaAction::UPDATE;
+                }
+                return;
+            }
+            slot = (slot + 1) & mask;
+        }
+
+        if (pending_.size() == PENDING) {
+            Flush();
+            Stage(delta);
+            return;
+        }
+        pending_.push_back(Pending{delta, static_cast<uint32_t>(slot), true});
+        table_[slot] = static_cast<uint32_t>(pending_.size());
+    }
+
+    void DeltaPublisher::Flush() {
+        for (const auto & held : pending_) {
+            if (held.live_) {
+                Write(held.delta_);
+            }
+            table_[held.slot_] = 0;
+        }
+        pending_.clear();
+    }
+
+    DeltaReader::~DeltaReader() {
+        Close();
+    }
+
+    int DeltaReader::Open(const std::string & name) {
+        Close();
+
+        int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            std::cerr<<"Could not open delta ring "<<name<<'\n';
+            return ERR_IO;
+        }
+        struct stat info;
+        void * data = MAP_FAILED;
+        if (::fstat(fd, &info) == 0 && static_cast<std::size_t>(info.st_size) >= sizeof(DeltaRingHeader)) {
+            data = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            std::cerr<<"Could not map delta ring "<<name<<'\n';
+            return ERR_IO;
+        }
+
+        const auto * header = static_cast<const DeltaRingHeader *>(data);
+        if (std::memcmp(header->magic_, DELTA_MAGIC, sizeof(DELTA_MAGIC)) != 0 || header->version_ != DELTA_VERSION ||
+            header->slotSize_ != sizeof(DeltaSlot) || RingSize(header->capacity_) > static_cast<std::size_t>(info.st_size)) {
+            std::cerr<<"Delta ring "<<name<<" has an unsupported format\n";
+            ::munmap(data, static_cast<std::size_t>(info.st_size));
+            return ERR_IO;
+        }
+
+        size_ = static_cast<std::size_t>(info.st_size);
+        mapped_ = true;
+        Attach(header);
+        return SUCCESS;
+    }
+
+    int DeltaReader::Open(const DeltaPublisher & publisher) {
+        Close();
+        if (publisher.Header() == nullptr) {
+            return ERR_IO;
+        }
+        Attach(publisher.Header());
+        return SUCCESS;
+    }
+
+    void DeltaReader::Close() {
+        if (mapped_) {
+            ::munmap(const_cast<DeltaRingHeader *>(header_), size_);
+        }
+        header_ = nullptr;
+        slots_ = nullptr;
+        mapped_ = false;
+    }
+
+    void DeltaReader::Attach(const DeltaRingHeader * header) {
+        header_ = header;
+        slots_ = reinterpret_cast<const DeltaSlot *>(header + 1);
+        mask_ = header->capacity_ - 1;
+        next_ = header->head_.load(std::memory_order_acquire);
+        lost_ = 0;
+    }
+
+    bool DeltaReader::Poll(LevelDelta & delta) {
+        const auto & slot = slots_[next_ & mask_];
+        auto expected = 2 * next_ + 2;
+        auto sequence = slot.sequence_.load(std::memory_order_acquire);
+        if (sequence < expected) {
+            return false;
+        }
+        if (sequence == expected) {
+            // The copy is only kept if the slot wasn't rewritten while it was taken
+            delta = slot.delta_;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence_.load(std::memory_order_relaxed) == expected) {
+                ++next_;
+                return true;
+            }
+        }
+
+        // Lapped, skip to the oldest delta with some slack so the writer doesn't lap it again at once
+        auto head = header_->head_.load(std::memory_order_acquire);
+        auto capacity = mask_ + 1;
+        auto resume = head - capacity + capacity / 4;
+        lost_ += resume - next_;
+        next_ = resume;
+        delta = LevelDelta{};
+        delta.Instrument_ = NO_INSTRUMENT;
+        delta.Action_ = DeltaAction::GAP;
+        return true;
+    }
+
+} // namespace orderbook
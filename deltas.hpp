@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "price.hpp"
+#include "spsc.hpp"
+#include "symbols.hpp"
+
+namespace orderbook {
+
+    enum class DeltaAction : uint8_t {
+        INSERT,     // A new price level
+        UPDATE,     // A level whose volume or order count changed
+        REMOVE,     // The last order left the level
+        CLEAR,      // Every level of Instrument_ is gone, or of every instrument if it is NO_INSTRUMENT
+        GAP,        // Only seen by readers, deltas were overwritten before they were read
+    };
+
+    enum class DeltaSide : uint8_t {
+        BID, ASK
+    };
+
+    // A change to one price level, carrying the level as it now stands rather than the difference, so
+    // applying the latest delta for a level is always enough to bring a view up to date
+    struct LevelDelta {
+        Tick Price_;
+        int64_t Volume_;            // Aggregate volume resting at the price
+        InstrumentID Instrument_;
+        uint32_t Orders_;           // Orders resting at the price
+        DeltaSide Side_;
+        DeltaAction Action_;
+        uint8_t padding_[6];
+    };
+
+    static_assert(sizeof(LevelDelta) == 32, "LevelDelta layout is shared with other processes");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "The ring's sequences must be lock free to be shared");
+
+    // The ring's shared memory is a DeltaRingHeader followed by capacity_ DeltaSlots. Each slot is a
+    // seqlock: the writer marks it odd while it writes delta n and 2n + 2 once it is written, so a
+    // reader knows from the slot alone whether it holds the delta it wants, a later one, or nothing yet.
+    constexpr char DELTA_MAGIC[8] = {'O', 'B', 'D', 'E', 'L', 'T', 'A', '\0'};
+    constexpr uint32_t DELTA_VERSION = 1;
+
+    struct DeltaRingHeader {
+        char magic_[8];
+        uint32_t version_;
+        uint32_t slotSize_;
+        uint64_t capacity_;
+        alignas(CACHE_LINE) std::atomic<uint64_t> head_;   // Deltas published so far
+    };
+
+    struct DeltaSlot {
+        std::atomic<uint64_t> sequence_;
+        LevelDelta delta_;
+    };
+
+    // The single producer side of a market by price delta ring. The publisher never waits for its
+    // readers: a reader that falls a whole ring behind is told it missed deltas and has to rebuild
+    // from the next CLEAR. With conflation, deltas are held until Flush and only the last state of
+    // each level is written, so a burst that touches the same levels over and over costs readers one
+    // delta per level rather than one per change.
+    class DeltaPublisher {
+        public:
+            DeltaPublisher() = default;
+            ~DeltaPublisher();
+
+            DeltaPublisher(const DeltaPublisher &) = delete;
+            DeltaPublisher & operator=(const DeltaPublisher &) = delete;
+
+            // Creates the ring as the POSIX shared memory object name, or private to this process and
+            // its children if name is empty. Capacity is rounded up to a power of two.
+            int Open(const std::string & name, std::size_t capacity, bool conflate = false);
+            // Unlinks the shared memory, readers that are attached keep their mapping
+            void Close();
+
+            void Publish(const LevelDelta & delta) {
+                if (conflate_ && delta.Action_ != DeltaAction::CLEAR) {
+                    Stage(delta);
+                } else {
+                    if (!pending_.empty()) {
+                        Flush();
+                    }
+                    Write(delta);
+                }
+            }
+
+            // Writes out the deltas held back for conflation
+            void Flush();
+
+            uint64_t Published() const { return next_; }
+            const DeltaRingHeader * Header() const { return header_; }
+
+        private:
+            struct Pending {
+                LevelDelta delta_;
+                uint32_t slot_;
+                bool live_;
+            };
+
+            static constexpr std::size_t PENDING = 1024;
+
+            void Write(const LevelDelta & delta) {
+                auto & slot = slots_[next_ & mask_];
+                slot.sequence_.store(2 * next_ + 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                slot.delta_ = delta;
+                slot.sequence_.store(2 * next_ + 2, std::memory_order_release);
+                header_->head_.store(++next_, std::memory_order_release);
+            }
+
+            void Stage(const LevelDelta & delta);
+
+            DeltaRingHeader * header_{nullptr};
+            DeltaSlot * slots_{nullptr};
+            std::size_t size_{0};
+            uint64_t mask_{0};
+            uint64_t next_{0};
+            std::string name_;
+
+            bool conflate_{false};
+            std::vector<Pending> pending_;
+            std::vector<uint32_t> table_;   // Open addressed, pending_ index + 1 for each level held back
+    };
+
+    // One reader of a delta ring, each keeps its own position and never writes to the ring
+    class DeltaReader {
+        public:
+            DeltaReader() = default;
+            ~DeltaReader();
+
+            DeltaReader(const DeltaReader &) = delete;
+            DeltaReader & operator=(const DeltaReader &) = delete;
+
+            // Attach to a ring another process published, read only, starting from its next delta
+            int Open(const std::string & name);
+            // Attach to a ring published in this process
+            int Open(const DeltaPublisher & publisher);
+            void Close();
+
+            // False if there is nothing new. After falling a ring behind, the next delta read is a GAP and
+            // reading resumes from the oldest delta still held, the reader's view is stale until a CLEAR.
+            bool Poll(LevelDelta & delta);
+
+            uint64_t Lost() const { return lost_; }
+
+        private:
+            void Attach(const DeltaRingHeader * header);
+
+            const DeltaRingHeader * header_{nullptr};
+            const DeltaSlot * slots_{nullptr};
+            std::size_t size_{0};
+            bool mapped_{false};
+            uint64_t mask_{0};
+            uint64_t next_{0};
+            uint64_t lost_{0};
+    };
+
+} // namespace orderbook
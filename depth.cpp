@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <functional>
+
+#include "depth.hpp"
+
+namespace orderbook {
+namespace depth {
+
+    namespace {
+
+        void PrefixScalar(const int64_t * volumes, std::size_t count, int64_t * sums) {
+            int64_t total{0};
+            for (std::size_t i = 0; i < count; ++i) {
+                total += volumes[i];
+                sums[i] = total;
+            }
+        }
+
+        int64_t CostScalar(const Tick * prices, const int64_t * volumes, std::size_t count, int64_t quantity, int64_t & filled) {
+            int64_t cost{0};
+            auto remaining = quantity;
+            for (std::size_t i = 0; i < count && remaining > 0; ++i) {
+                auto take = std::min(volumes[i], remaining);
+                cost += prices[i] * take;
+                remaining -= take;
+            }
+            filled = quantity - remaining;
+            return cost;
+        }
+
+        std::size_t WithinScalar(const Tick * prices, const int64_t * volumes, std::size_t count, Tick limit, bool ascending, int64_t & volume) {
+            std::size_t levels{0};
+            volume = 0;
+            while (levels < count && (ascending ? prices[levels] <= limit : prices[levels] >= limit)) {
+                volume += volumes[levels++];
+            }
+            return levels;
+        }
+
+#ifdef ORDERBOOK_X86
+
+        using simd::Sum;
+
+        // Neither has a 64 bit multiply, so the low half of each product is put together from 32 bit ones
+        __attribute__((target("sse4.2")))
+        __m128i Multiply(__m128i a, __m128i b) {
+            auto crossed = _mm_mullo_epi32(a, _mm_shuffle_epi32(b, 0xB1));
+            auto high = _mm_shuffle_epi32(_mm_hadd_epi32(crossed, _mm_setzero_si128()), 0x73);
+            return _mm_add_epi64(_mm_mul_epu32(a, b), high);
+        }
+
+        __attribute__((target("avx2")))
+        __m256i Multiply(__m256i a, __m256i b) {
+            auto crossed = _mm256_mullo_epi32(a, _mm256_shuffle_epi32(b, 0xB1));
+            auto high = _mm256_shuffle_epi32(_mm256_hadd_epi32(crossed, _mm256_setzero_si256()), 0x73);
+            return _mm256_add_epi64(_mm256_mul_epu32(a, b), high);
+        }
+
+        // Each lane plus the lanes before it
+        __attribute__((target("sse4.2")))
+        __m128i Scan(__m128i v) {
+            return _mm_add_epi64(v, _mm_slli_si128(v, 8));
+        }
+
+        __attribute__((target("avx2")))
+        __m256i Scan(__m256i v) {
+            auto zero = _mm256_setzero_si256();
+            v = _mm256_add_epi64(v, _mm256_blend_epi32(_mm256_permute4x64_epi64(v, _MM_SHUFFLE(2, 1, 0, 0)), zero, 0x03));
+            return _mm256_add_epi64(v, _mm256_blend_epi32(_mm256_permute4x64_epi64(v, _MM_SHUFFLE(1, 0, 0, 0)), zero, 0x0F));
+        }
+
+        __attribute__((target("sse4.2")))
+        void PrefixSse(const int64_t * volumes, std::size_t count, int64_t * sums) {
+            auto carry = _mm_setzero_si128();
+            std::size_t i{0};
+            for (; i + 2 <= count; i += 2) {
+                auto v = _mm_add_epi64(Scan(_mm_loadu_si128(reinterpret_cast<const __m128i *>(volumes + i))), carry);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(sums + i), v);
+                carry = _mm_unpackhi_epi64(v, v);
+            }
+            auto total = _mm_cvtsi128_si64(carry);
+            for (; i < count; ++i) {
+                total += volumes[i];
+                sums[i] = total;
+            }
+        }
+
+        __attribute__((target("avx2")))
+        void PrefixAvx2(const int64_t * volumes, std::size_t count, int64_t * sums) {
+            auto carry = _mm256_setzero_si256();
+            std::size_t i{0};
+            for (; i + 4 <= count; i += 4) {
+                auto v = _mm256_add_epi64(Scan(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(volumes + i))), carry);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(sums + i), v);
+                carry = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 3, 3, 3));
+            }
+            auto total = _mm_cvtsi128_si64(_mm256_castsi256_si128(carry));
+            for (; i < count; ++i) {
+                total += volumes[i];
+                sums[i] = total;
+            }
+        }
+
+        // Whole blocks of levels are taken while the quantity outlasts them, the block it runs out in
+        // is finished in scalar code
+        __attribute__((target("sse4.2")))
+        int64_t CostSse(const Tick * prices, const int64_t * volumes, std::size_t count, int64_t quantity, int64_t & filled) {
+            auto cost = _mm_setzero_si128();
+            auto remaining = quantity;
+            std::size_t i{0};
+            for (; i + 2 <= count; i += 2) {
+                auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(volumes + i));
+                auto block = Sum(v);
+                if (block >= remaining) {
+                    break;
+                }
+                cost = _mm_add_epi64(cost, Multiply(_mm_loadu_si128(reinterpret_cast<const __m128i *>(prices + i)), v));
+                remaining -= block;
+            }
+            int64_t rest;
+            auto total = Sum(cost) + CostScalar(prices + i, volumes + i, count - i, remaining, rest);
+            filled = quantity - remaining + rest;
+            return total;
+        }
+
+        __attribute__((target("avx2")))
+        int64_t CostAvx2(const Tick * prices, const int64_t * volumes, std::size_t count, int64_t quantity, int64_t & filled) {
+            auto cost = _mm256_setzero_si256();
+            auto remaining = quantity;
+            std::size_t i{0};
+            for (; i + 4 <= count; i += 4) {
+                auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(volumes + i));
+                auto block = Sum(v);
+                if (block >= remaining) {
+                    break;
+                }
+                cost = _mm256_add_epi64(cost, Multiply(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(prices + i)), v));
+                remaining -= block;
+            }
+            // GCC doesn't always clear the upper halves before calling into non-VEX code, and every SSE
+            // instruction after it would pay for them
+            auto taken = Sum(cost);
+            _mm256_zeroupper();
+            int64_t rest;
+            auto total = taken + CostScalar(prices + i, volumes + i, count - i, remaining, rest);
+            filled = quantity - remaining + rest;
+            return total;
+        }
+
+        // The levels are sorted, so the band ends in the first block with a price outside it
+        __attribute__((target("sse4.2")))
+        std::size_t WithinSse(const Tick * prices, const int64_t * volumes, std::size_t count, Tick limit, bool ascending, int64_t & volume) {
+            auto bound = _mm_set1_epi64x(limit);
+            auto sum = _mm_setzero_si128();
+            std::size_t i{0};
+            for (; i + 2 <= count; i += 2) {
+                auto p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(prices + i));
+                auto outside = ascending ? _mm_cmpgt_epi64(p, bound) : _mm_cmpgt_epi64(bound, p);
+                if (!_mm_testz_si128(outside, outside)) {
+                    break;
+                }
+                sum = _mm_add_epi64(sum, _mm_loadu_si128(reinterpret_cast<const __m128i *>(volumes + i)));
+            }
+            int64_t rest;
+            auto levels = i + WithinScalar(prices + i, volumes + i, count - i, limit, ascending, rest);
+            volume = Sum(sum) + rest;
+            return levels;
+        }
+
+        __attribute__((target("avx2")))
+        std::size_t WithinAvx2(const Tick * prices, const int64_t * volumes, std::size_t count, Tick limit, bool ascending, int64_t & volume) {
+            auto bound = _mm256_set1_epi64x(limit);
+            auto sum = _mm256_setzero_si256();
+            std::size_t i{0};
+            for (; i + 4 <= count; i += 4) {
+                auto p = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(prices + i));
+                auto outside = ascending ? _mm256_cmpgt_epi64(p, bound) : _mm256_cmpgt_epi64(bound, p);
+                if (!_mm256_testz_si256(outside, outside)) {
+                    break;
+                }
+                sum = _mm256_add_epi64(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(volumes + i)));
+            }
+            auto taken = Sum(sum);
+            _mm256_zeroupper();
+            int64_t rest;
+            auto levels = i + WithinScalar(prices + i, volumes + i, count - i, limit, ascending, rest);
+            volume = taken + rest;
+            return levels;
+        }
+
+#endif
+
+        struct Kernels {
+            Isa isa_;
+            void (*prefix_)(const int64_t *, std::size_t, int64_t *);
+            int64_t (*cost_)(const Tick *, const int64_t *, std::size_t, int64_t, int64_t &);
+            std::size_t (*within_)(const Tick *, const int64_t *, std::size_t, Tick, bool, int64_t &);
+        };
+
+        Kernels Select(Isa isa) {
+#ifdef ORDERBOOK_X86
+            switch (isa) {
+                case Isa::AVX2: return Kernels{isa, PrefixAvx2, CostAvx2, WithinAvx2};
+                case Isa::SSE42: return Kernels{isa, PrefixSse, CostSse, WithinSse};
+                case Isa::SCALAR: break;
+            }
+#endif
+            return Kernels{Isa::SCALAR, PrefixScalar, CostScalar, WithinScalar};
+        }
+
+        simd::Dispatch<Kernels, Select> active;
+
+    } // namespace
+
+    Isa Active() {
+        return active.Active();
+    }
+
+    bool Use(Isa isa) {
+        return active.Use(isa);
+    }
+
+    void PrefixVolume(const int64_t * volumes, std::size_t count, int64_t * sums) {
+        active->prefix_(volumes, count, sums);
+    }
+
+    int64_t CostToFill(const Tick * prices, const int64_t * volumes, std::size_t count, int64_t quantity, int64_t & filled) {
+        return active->cost_(prices, volumes, count, quantity, filled);
+    }
+
+    std::size_t LevelsWithin(const Tick * prices, const int64_t * volumes, std::size_t count, Tick limit, bool ascending, int64_t & volume) {
+        return active->within_(prices, volumes, count, limit, ascending, volume);
+    }
+
+} // namespace depth
+
+    void DepthBook::Apply(InstrumentID instrument, DeltaSide side, Tick price, int64_t volume, DeltaAction action) {
+        if (action == DeltaAction::CLEAR) {
+            if (instrument == NO_INSTRUMENT) {
+                Clear();
+            } else if (instrument * std::size_t{2} < sides_.size()) {
+                for (auto * levels : {&sides_[instrument * std::size_t{2}], &sides_[instrument * std::size_t{2} + 1]}) {
+                    levels->prices_.clear();
+                    levels->volumes_.clear();
+                }
+            }
+            return;
+        }
+        if (action == DeltaAction::GAP || instrument == NO_INSTRUMENT) {
+            return;
+        }
+        if (instrument * std::size_t{2} >= sides_.size()) {
+            sides_.resize((instrument + std::size_t{1}) * 2);
+        }
+
+        // Levels are best first, so bids descend and asks ascend
+        auto & levels = sides_[instrument * std::size_t{2} + (side == DeltaSide::ASK)];
+        auto pos = side == DeltaSide::ASK
+            ? std::lower_bound(levels.prices_.begin(), levels.prices_.end(), price)
+            : std::lower_bound(levels.prices_.begin(), levels.prices_.end(), price, std::greater<Tick>());
+        auto index = static_cast<std::size_t>(pos - levels.prices_.begin());
+        auto found = pos != levels.prices_.end() && *pos == price;
+
+        if (action == DeltaAction::REMOVE) {
+            if (found) {
+                levels.prices_.erase(pos);
+                levels.volumes_.erase(levels.volumes_.begin() + static_cast<std::ptrdiff_t>(index));
+            }
+        } else if (found) {
+            levels.volumes_[index] = volume;
+        } else {
+            levels.prices_.insert(pos, price);
+            levels.volumes_.insert(levels.volumes_.begin() + static_cast<std::ptrdiff_t>(index), volume);
+        }
+    }
+
+    void DepthBook::Clear() {
+        for (auto & levels : sides_) {
+            levels.prices_.clear();
+            levels.volumes_.clear();
+        }
+    }
+
+    const DepthBook::Side & DepthBook::Levels(InstrumentID instrument, DeltaSide side) const {
+        static const Side empty;
+        auto index = instrument * std::size_t{2} + (side == DeltaSide::ASK);
+        return instrument != NO_INSTRUMENT && index < sides_.size() ? sides_[index] : empty;
+    }
+
+    void DepthBook::CumulativeVolume(InstrumentID instrument, DeltaSide side, int64_t * sums, std::size_t count) const {
+        const auto & levels = Levels(instrument, side);
+        depth::PrefixVolume(levels.volumes_.data(), std::min(count, levels.Size()), sums);
+    }
+
+    int64_t DepthBook::CostToFill(InstrumentID instrument, DeltaSide side, int64_t quantity, int64_t & filled) const {
+        const auto & levels = Levels(instrument, side);
+        return depth::CostToFill(levels.prices_.data(), levels.volumes_.data(), levels.Size(), quantity, filled);
+    }
+
+    double DepthBook::Vwap(InstrumentID instrument, DeltaSide side, int64_t quantity) const {
+        int64_t filled;
+        auto cost = CostToFill(instrument, side, quantity, filled);
+        return filled ? static_cast<double>(cost) / static_cast<double>(filled) : 0.0;
+    }
+
+    std::size_t DepthBook::LevelsWithin(InstrumentID instrument, DeltaSide side, Tick distance, int64_t & volume) const {
+        const auto & levels = Levels(instrument, side);
+        volume = 0;
+        if (levels.Size() == 0) {
+            return 0;
+        }
+        auto ask = side == DeltaSide::ASK;
+        auto limit = ask ? levels.prices_[0] + distance : levels.prices_[0] - distance;
+        return depth::LevelsWithin(levels.prices_.data(), levels.volumes_.data(), levels.Size(), limit, ask, volume);
+    }
+
+    std::size_t DepthBook::Bytes() const {
+        auto bytes = sides_.capacity() * sizeof(Side);
+        for (const auto & levels : sides_) {
+            bytes += levels.prices_.capacity() * sizeof(Tick) + levels.volumes_.capacity() * sizeof(int64_t);
+        }
+        return bytes;
+    }
+
+} // namespace orderbook
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "deltas.hpp"
+#include "price.hpp"
+#include "simd.hpp"
+#include "symbols.hpp"
+
+namespace orderbook {
+namespace depth {
+
+    // Kernels over one side's levels held as parallel arrays, best first, built for each simd::Isa
+    using Isa = simd::Isa;
+
+    Isa Active();
+    bool Use(Isa isa);
+
+    // sums[i] is the volume of levels 0 to i
+    void PrefixVolume(const int64_t * volumes, std::size_t count, int64_t * sums);
+
+    // Takes quantity from the top of the book down, returning the cost in ticks times volume, with what
+    // could be taken in filled. A side that runs out fills less than quantity.
+    int64_t CostToFill(const Tick * prices, const int64_t * volumes, std::size_t count, int64_t quantity, int64_t & filled);
+
+    // How many levels are at limit or better, with their total volume. Bids are better when higher,
+    // asks (ascending) when lower.
+    std::size_t LevelsWithin(const Tick * prices, const int64_t * volumes, std::size_t count, Tick limit, bool ascending, int64_t & volume);
+
+} // namespace depth
+
+    // The price and volume of every level of every security as a structure of arrays, so that depth
+    // queries on the pre-trade risk path stream through two contiguous arrays instead of walking
+    // levels one at a time. Driven by the same level changes as LevelDeltas, either by the book it is
+    // given to with PublishDepth or by applying deltas read from a ring. Only one thread may use it.
+    class DepthBook {
+        public:
+            struct Side {
+                std::vector<Tick> prices_;
+                std::vector<int64_t> volumes_;
+
+                std::size_t Size() const { return prices_.size(); }
+            };
+
+            // INSERT and UPDATE both set the level's volume, REMOVE drops it and CLEAR drops the
+            // instrument's levels, or every instrument's for NO_INSTRUMENT
+            void Apply(InstrumentID instrument, DeltaSide side, Tick price, int64_t volume, DeltaAction action);
+            void Apply(const LevelDelta & delta) { Apply(delta.Instrument_, delta.Side_, delta.Price_, delta.Volume_, delta.Action_); }
+            void Clear();
+
+            // An empty side for an instrument it has never seen
+            const Side & Levels(InstrumentID instrument, DeltaSide side) const;
+
+            void CumulativeVolume(InstrumentID instrument, DeltaSide side, int64_t * sums, std::size_t count) const;
+            int64_t CostToFill(InstrumentID instrument, DeltaSide side, int64_t quantity, int64_t & filled) const;
+            // The average price in ticks of filling quantity, or of what the side holds if it is less, 0 if empty
+            double Vwap(InstrumentID instrument, DeltaSide side, int64_t quantity) const;
+            // Levels and volume at most distance ticks from the best price
+            std::size_t LevelsWithin(InstrumentID instrument, DeltaSide side, Tick distance, int64_t & volume) const;
+
+            std::size_t Bytes() const;
+
+        private:
+            std::vector<Side> sides_;   // Bids then asks, by InstrumentID
+    };
+
+} // namespace orderbook
@@ -0,0 +1,187 @@
+#include <pthread.h>
+#include <sched.h>
+
+#include <iostream>
+
+#include "engine.hpp"
+
+namespace orderbook {
+
+    namespace {
+
+        constexpr int SPINS_BEFORE_YIELD = 256;
+
+        void Backoff(int & spins) {
+            if (++spins > SPINS_BEFORE_YIELD) {
+                std::this_thread::yield();
+                spins = 0;
+            }
+        }
+
+    } // namespace
+
+    bool PinThread(int cpu) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+    }
+
+    Engine::Engine(const Config & config) : config_(config) {
+        if (config_.shards_ == 0) {
+            config_.shards_ = 1;
+        }
+        for (std::size_t i = 0; i < config_.shards_; ++i) {
+            shards_.emplace_back(new Shard(config_.capacity_));
+        }
+    }
+
+    Engine::~Engine() {
+        Stop();
+    }
+
+    void Engine::Start() {
+        if (running_.exchange(true)) {
+            return;
+        }
+        for (std::size_t i = 0; i < shards_.size(); ++i) {
+            int cpu = config_.firstCpu_ < 0 ? -1 : config_.firstCpu_ + static_cast<int>(i);
+            shards_[i]->thread_ = std::thread(&Engine::Run, this, std::ref(*shards_[i]), cpu);
+        }
+    }
+
+    void Engine::Stop() {
+        if (!running_.exchange(false)) {
+            return;
+        }
+        // Workers finish what is already queued before they exit
+        for (auto & shard : shards_) {
+            shard->thread_.join();
+        }
+    }
+
+    int Engine::Dispatch(const Order & order) {
+        if (!running_.load(std::memory_order_relaxed)) {
+            return ERR_NOT_RUNNING;
+        }
+        auto route = Route(order);
+        if (route == shards_.size()) {
+            Log(LogEvent::UNROUTABLE, order.OrderID_);
+            return ERR_ORD_SECID;
+        }
+
+        auto & shard = *shards_[route];
+        int spins = 0;
+        while (!shard.queue_.TryPush(order)) {
+            Backoff(spins);
+        }
+        ++shard.dispatched_;
+        Routed(order, route);
+        return SUCCESS;
+    }
+
+    bool Engine::TryDispatch(const Order & order) {
+        if (!running_.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        auto route = Route(order);
+        if (route == shards_.size()) {
+            Log(LogEvent::UNROUTABLE, order.OrderID_);
+            return false;
+        }
+
+        auto & shard = *shards_[route];
+        if (!shard.queue_.TryPush(order)) {
+            return false;
+        }
+        ++shard.dispatched_;
+        Routed(order, route);
+        return true;
+    }
+
+    std::size_t Engine::Route(const Order & order) const {
+        if (order.OrderAction_ != OrderAction_t::Add) {
+            auto route = routes_.find(order.OrderID_);
+            if (route != routes_.end()) {
+                return route->second;
+            }
+        }
+        return order.SecurityID_.empty() ? shards_.size() : ShardOf(order.SecurityID_);
+    }
+
+    void Engine::Routed(const Order & order, std::size_t shard) {
+        // A duplicate add keeps the route of the order it duplicates, which its shard rejects
+        if (order.OrderAction_ == OrderAction_t::Add) {
+            routes_.emplace(order.OrderID_, static_cast<uint32_t>(shard));
+        } else if (order.OrderAction_ == OrderAction_t::Delete) {
+            routes_.erase(order.OrderID_);
+        }
+    }
+
+    void Engine::Drain() {
+        for (auto & shard : shards_) {
+            int spins = 0;
+            while (shard->processed_.load(std::memory_order_acquire) != shard->dispatched_) {
+                Backoff(spins);
+            }
+        }
+    }
+
+    std::size_t Engine::Shards() const {
+        return shards_.size();
+    }
+
+    std::size_t Engine::ShardOf(const std::string & security) const {
+        return ShardOf(security.data(), security.size());
+    }
+
+    std::size_t Engine::ShardOf(const char * security, std::size_t length) const {
+        // FNV-1a, security ids are short so this is cheaper than a general purpose string hash
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (std::size_t i = 0; i < length && security[i]; ++i) {
+            hash = (hash ^ static_cast<unsigned char>(security[i])) * 0x100000001b3ull;
+        }
+        return static_cast<std::size_t>(hash % shards_.size());
+    }
+
+    Implementation & Engine::Book(std::size_t shard) {
+        return shards_[shard]->book_;
+    }
+
+    const Implementation & Engine::Book(std::size_t shard) const {
+        return shards_[shard]->book_;
+    }
+
+    std::size_t Engine::Processed(std::size_t shard) const {
+        return shards_[shard]->processed_.load(std::memory_order_acquire);
+    }
+
+    std::size_t Engine::Rejected(std::size_t shard) const {
+        return shards_[shard]->rejected_.load(std::memory_order_relaxed);
+    }
+
+    void Engine::Run(Shard & shard, int cpu) {
+        if (cpu >= 0 && !PinThread(cpu)) {
+            std::cerr<<"Could not pin shard to cpu "<<cpu<<'\n';
+        }
+
+        Order order;
+        int spins = 0;
+        while (true) {
+            if (shard.queue_.TryPop(order)) {
+                if (shard.book_.Process(order) != SUCCESS) {
+                    shard.rejected_.fetch_add(1, std::memory_order_relaxed);
+                }
+                shard.processed_.store(shard.processed_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+                spins = 0;
+            } else if (!running_.load(std::memory_order_acquire)) {
+                if (shard.queue_.Empty()) {
+                    break;
+                }
+            } else {
+                Backoff(spins);
+            }
+        }
+    }
+
+} // namespace orderbook
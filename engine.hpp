@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "orderbook.hpp"
+#include "spsc.hpp"
+
+namespace orderbook {
+
+    // Pins the calling thread to cpu, false if it can't be
+    bool PinThread(int cpu);
+
+    // Spreads the book across worker threads. Each shard owns a private Implementation, fed from its
+    // own single producer single consumer ring, and every security is always routed to the same shard,
+    // so messages for one security are applied in the order they were dispatched. Dispatch must be
+    // called from a single thread, which routes adds by their SecurityID_ and remembers the shard of
+    // each order it adds, so modifies and deletes need only the OrderID_ as they do on a single book.
+    // Orders a shard fills away by matching are only forgotten when a delete for them comes.
+    class Engine {
+        public:
+            struct Config {
+                std::size_t shards_{1};
+                std::size_t capacity_{65536};   // Messages each shard's ring can hold
+                int firstCpu_{-1};              // Pin shard i to cpu firstCpu_ + i, or -1 to leave them unpinned
+            };
+
+            explicit Engine(const Config & config);
+            ~Engine();
+
+            Engine(const Engine &) = delete;
+            Engine & operator=(const Engine &) = delete;
+
+            void Start();
+            void Stop();
+
+            // Queue an order on its shard, waiting for room if the shard has fallen behind. Returns
+            // ERR_NOT_RUNNING before Start or after Stop, when no worker would make room.
+            int Dispatch(const Order & order);
+            // As Dispatch, but returns false instead of waiting when the shard's ring is full
+            bool TryDispatch(const Order & order);
+            // Wait until every dispatched message has been applied
+            void Drain();
+
+            std::size_t Shards() const;
+            std::size_t ShardOf(const std::string & security) const;
+            std::size_t ShardOf(const char * security, std::size_t length) const;
+
+            // Shard books may only be read from other threads once Drain has returned, or before Start
+            Implementation & Book(std::size_t shard);
+            const Implementation & Book(std::size_t shard) const;
+
+            std::size_t Processed(std::size_t shard) const;
+            std::size_t Rejected(std::size_t shard) const;
+
+        private:
+            struct Shard {
+                explicit Shard(std::size_t capacity) : queue_(capacity) {}
+
+                Implementation book_;
+                SpscQueue<Order> queue_;
+                std::thread thread_;
+                std::size_t dispatched_{0};
+                alignas(CACHE_LINE) std::atomic<std::size_t> processed_{0};
+                std::atomic<std::size_t> rejected_{0};
+            };
+
+            void Run(Shard & shard, int cpu);
+            // The shard an order goes to, Shards() if it can't be routed, and noting it once queued
+            std::size_t Route(const Order & order) const;
+            void Routed(const Order & order, std::size_t shard);
+
+            Config config_;
+            std::vector<std::unique_ptr<Shard>> shards_;
+            std::unordered_map<int_fast64_t, uint32_t> routes_;    // OrderID to shard, dispatcher thread only
+            std::atomic<bool> running_{false};
+    };
+
+} // namespace orderbook
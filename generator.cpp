@@ -0,0 +1,158 @@
+#include <cmath>
+#include <cstdio>
+
+#include "generator.hpp"
+
+namespace orderbook {
+
+    namespace {
+
+        double Helper1(double x) {
+            return std::fabs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+        }
+
+        double Helper2(double x) {
+            return std::fabs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+        }
+
+    } // namespace
+
+    Generator::Generator(const GeneratorConfig & config) : config_(config), state_(config.seed_ ? config.seed_ : 1) {
+        if (config_.securities_ == 0) {
+            config_.securities_ = 1;
+        }
+        mids_.assign(config_.securities_, 0);
+        live_.reserve(config_.liveOrders_ + 1);
+
+        hIntegralX1_ = HIntegral(1.5) - 1.0;
+        hIntegralN_ = HIntegral(static_cast<double>(config_.securities_) + 0.5);
+        s_ = 2.0 - HIntegralInverse(HIntegral(2.5) - H(2.0));
+    }
+
+    Message Generator::Next() {
+        auto live = live_.size();
+
+        // Fill the book up to its working size first, then hold it there
+        if (live < config_.liveOrders_ / 2) {
+            return Add();
+        }
+        auto index = static_cast<std::size_t>(Random() % live);
+        if (live >= config_.liveOrders_) {
+            return Delete(index);
+        }
+
+        auto action = Uniform();
+        if (action < config_.addRatio_) {
+            return Add();
+        }
+        if (action < config_.addRatio_ + config_.modifyRatio_) {
+            return Modify(index);
+        }
+        return Delete(index);
+    }
+
+    std::string Generator::Symbol(InstrumentID instrument) {
+        char symbol[16];
+        std::snprintf(symbol, sizeof(symbol), "XS%010u", instrument);
+        return symbol;
+    }
+
+    uint64_t Generator::Random() {
+        // xorshift64*
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 0x2545F4914F6CDD1Dull;
+    }
+
+    double Generator::Uniform() {
+        return static_cast<double>(Random() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    InstrumentID Generator::Security() {
+        if (config_.zipf_ <= 0.0) {
+            return static_cast<InstrumentID>(Random() % config_.securities_);
+        }
+        while (true) {
+            auto u = hIntegralN_ + Uniform() * (hIntegralX1_ - hIntegralN_);
+            auto x = HIntegralInverse(u);
+            auto k = static_cast<double>(static_cast<int64_t>(x + 0.5));
+            if (k < 1.0) {
+                k = 1.0;
+            } else if (k > static_cast<double>(config_.securities_)) {
+                k = static_cast<double>(config_.securities_);
+            }
+            if (k - x <= s_ || u >= HIntegral(k + 0.5) - H(k)) {
+                return static_cast<InstrumentID>(k) - 1;
+            }
+        }
+    }
+
+    Tick Generator::Distance() {
+        // Geometric, with a mean of the configured depth
+        double p = 1.0 / (1.0 + static_cast<double>(config_.depth_));
+        return static_cast<Tick>(std::floor(std::log(1.0 - Uniform()) / std::log(1.0 - p)));
+    }
+
+    Message Generator::Add() {
+        auto instrument = Security();
+        auto & mid = mids_[instrument];
+        if (mid == 0) {
+            mid = config_.startPrice_ + static_cast<Tick>(instrument % 1000);
+        }
+        if (Uniform() < config_.priceWalk_) {
+            mid += (Random() & 1) ? 1 : -1;
+        }
+
+        auto direction = (Random() & 1) ? OrderDirection_t::SELL : OrderDirection_t::BUY;
+        auto offset = 1 + Distance();
+        auto price = direction == OrderDirection_t::BUY ? mid - offset : mid + offset;
+        if (price < 1) {
+            price = 1;
+        }
+        int_fast64_t volume = 100 * static_cast<int_fast64_t>(1 + Random() % 50);
+
+        Resting order{nextOrderID_++, instrument, direction, price, volume};
+        live_.push_back(order);
+        return Message{order.OrderID_, OrderAction_t::Add, direction, OrderConstraints_t::LIMIT, instrument, price, volume};
+    }
+
+    Message Generator::Modify(std::size_t index) {
+        auto & order = live_[index];
+        if (Uniform() < config_.priceChange_) {
+            auto offset = 1 + Distance();
+            auto mid = mids_[order.instrument_];
+            order.Price_ = order.OrderDirection_ == OrderDirection_t::BUY ? mid - offset : mid + offset;
+            if (order.Price_ < 1) {
+                order.Price_ = 1;
+            }
+        }
+        order.Volume_ = 100 * static_cast<int_fast64_t>(1 + Random() % 50);
+        return Message{order.OrderID_, OrderAction_t::Modify, order.OrderDirection_, OrderConstraints_t::LIMIT, order.instrument_, order.Price_, order.Volume_};
+    }
+
+    Message Generator::Delete(std::size_t index) {
+        auto order = live_[index];
+        live_[index] = live_.back();
+        live_.pop_back();
+        return Message{order.OrderID_, OrderAction_t::Delete, order.OrderDirection_, OrderConstraints_t::LIMIT, order.instrument_, order.Price_, order.Volume_};
+    }
+
+    double Generator::H(double x) const {
+        return std::exp(-config_.zipf_ * std::log(x));
+    }
+
+    double Generator::HIntegral(double x) const {
+        auto logX = std::log(x);
+        return Helper2((1.0 - config_.zipf_) * logX) * logX;
+    }
+
+    double Generator::HIntegralInverse(double x) const {
+        auto t = x * (1.0 - config_.zipf_);
+        if (t < -1.0) {
+            t = -1.0;
+        }
+        return std::exp(Helper1(t) * x);
+    }
+
+} // namespace orderbook
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "orderbook.hpp"
+
+namespace orderbook {
+
+    struct GeneratorConfig {
+        uint64_t seed_{1};
+        std::size_t securities_{1000};
+        double zipf_{1.0};              // Skew of security popularity, 0 is uniform
+        double addRatio_{0.3};          // Share of adds once the book is at its working size
+        double modifyRatio_{0.4};       // Share of modifies, the rest are deletes
+        double priceChange_{0.2};       // Chance a modify moves the order to a new price
+        std::size_t depth_{10};         // Mean distance in ticks of new orders from the mid
+        double priceWalk_{0.01};        // Chance a security's mid moves a tick each time it trades
+        std::size_t liveOrders_{100000};// Resting orders to keep in the book
+        Tick startPrice_{10000};
+    };
+
+    // Deterministic synthetic market data. The same config and seed always produce the same stream.
+    // Securities are chosen with Zipf popularity, new orders are placed a geometrically distributed
+    // number of ticks away from a mid that random walks, and modifies and deletes pick uniformly from
+    // the orders the generator has left resting, so they always refer to live orders.
+    class Generator {
+        public:
+            explicit Generator(const GeneratorConfig & config);
+
+            // The next message, with the instrument id being the security's popularity rank
+            Message Next();
+
+            // A 12 character ISIN style id for a generated instrument
+            static std::string Symbol(InstrumentID instrument);
+
+            std::size_t Live() const { return live_.size(); }
+
+        private:
+            struct Resting {
+                int_fast64_t OrderID_;
+                InstrumentID instrument_;
+                OrderDirection_t OrderDirection_;
+                Tick Price_;
+                int_fast64_t Volume_;
+            };
+
+            uint64_t Random();
+            double Uniform();
+            InstrumentID Security();
+            Tick Distance();
+
+            Message Add();
+            Message Modify(std::size_t index);
+            Message Delete(std::size_t index);
+
+            // Rejection inversion sampling of a Zipf distribution, Hormann and Derflinger, which needs no
+            // table so works for any number of securities
+            double H(double x) const;
+            double HIntegral(double x) const;
+            double HIntegralInverse(double x) const;
+
+            GeneratorConfig config_;
+            uint64_t state_;
+            int_fast64_t nextOrderID_{1};
+            std::vector<Tick> mids_;
+            std::vector<Resting> live_;
+
+            double hIntegralX1_;
+            double hIntegralN_;
+            double s_;
+    };
+
+} // namespace orderbook
@@ -0,0 +1,203 @@
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+
+#include "harness.hpp"
+#include "text.hpp"
+#include "wire.hpp"
+
+namespace harness {
+
+    std::string Run::Name() const {
+        return partitions_ > 1 ? path_ + '#' + std::to_string(partition_) + '/' + std::to_string(partitions_) : path_;
+    }
+
+    uint32_t Partition(const char * security, std::size_t length, uint32_t partitions) {
+        // FNV-1a
+        uint64_t hash{0xCBF29CE484222325ull};
+        for (std::size_t i = 0; i < length && security[i] != '\0'; ++i) {
+            hash = (hash ^ static_cast<unsigned char>(security[i])) * 0x100000001B3ull;
+        }
+        return static_cast<uint32_t>(hash % partitions);
+    }
+
+    Result Replay(const Run & run) {
+        Result result;
+        result.name_ = run.Name();
+        auto start = std::chrono::steady_clock::now();
+
+        orderbook::Implementation book;
+        book.KeepFingerprint(true);
+
+        // The orders added for this partition's securities, so their modifies and deletes, which carry
+        // no security, can be told from the other partitions'
+        std::unordered_set<int64_t> live;
+        auto split = run.partitions_ > 1;
+
+        orderbook::Message messages[orderbook::Implementation::BATCH_WINDOW];
+        std::size_t pending{0};
+        auto flush = [&] {
+            result.rejected_ += book.ProcessBatch(messages, pending, nullptr);
+            result.messages_ += pending;
+            pending = 0;
+        };
+
+        // Consecutive messages are often for the same security, so skip the lookup when it repeats
+        char lastSymbol[compact::ID_LEN] = {};
+        orderbook::InstrumentID instrument{orderbook::NO_INSTRUMENT};
+        bool mine{true};
+        auto apply = [&] (const wire::Record * records, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) {
+                const auto & record = records[i];
+                if (instrument == orderbook::NO_INSTRUMENT || std::memcmp(lastSymbol, record.SecurityID_, compact::ID_LEN) != 0) {
+                    instrument = book.Register(record.SecurityID_, compact::ID_LEN);
+                    std::memcpy(lastSymbol, record.SecurityID_, compact::ID_LEN);
+                    mine = !split || Partition(record.SecurityID_, compact::ID_LEN, run.partitions_) == run.partition_;
+                }
+                if (split) {
+                    if (record.OrderAction_ == compact::ORDER_ACTION_ADD) {
+                        if (!mine) {
+                            continue;
+                        }
+                        live.insert(record.OrderID_);
+                    } else if (record.OrderAction_ == compact::ORDER_ACTION_DELETE ? live.erase(record.OrderID_) == 0 : live.count(record.OrderID_) == 0) {
+                        continue;
+                    }
+                }
+                messages[pending++] = wire::Decode(record, instrument);
+                if (pending == orderbook::Implementation::BATCH_WINDOW) {
+                    flush();
+                }
+            }
+        };
+
+        if (text::IsTextFile(run.path_)) {
+            text::LoadStats stats;
+            result.rc_ = text::Read(run.path_, stats, apply, text::Format::AUTO, run.map_);
+        } else {
+            wire::MappedFile file;
+            result.rc_ = file.Open(run.path_);
+            if (result.rc_ == orderbook::SUCCESS) {
+                apply(file.Records(), file.Count());
+            }
+        }
+        flush();
+
+        result.orders_ = book.Orders();
+        result.fingerprint_ = book.Fingerprint();
+        result.seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+    std::vector<Result> Replay(const std::vector<Run> & runs, std::size_t threads) {
+        std::vector<Result> results(runs.size());
+        std::atomic<std::size_t> next{0};
+        auto work = [&runs, &results, &next] {
+            for (auto run = next++; run < runs.size(); run = next++) {
+                results[run] = Replay(runs[run]);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (std::size_t i = 1; i < std::min(std::max<std::size_t>(threads, 1), runs.size()); ++i) {
+            workers.emplace_back(work);
+        }
+        work();
+        for (auto & worker : workers) {
+            worker.join();
+        }
+        return results;
+    }
+
+    int ReadGolden(const std::string & path, std::map<std::string, uint64_t> & golden) {
+        std::ifstream file(path);
+        if (!file) {
+            std::cerr<<"Could not open golden file "<<path<<'\n';
+            return orderbook::ERR_IO;
+        }
+
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+            std::istringstream fields(line);
+            std::string name;
+            uint64_t fingerprint;
+            if (!(fields >> name >> std::hex >> fingerprint)) {
+                std::cerr<<"Invalid line ["<<line<<"] in golden file "<<path<<'\n';
+                return orderbook::ERR_IO;
+            }
+            golden[name] = fingerprint;
+        }
+        return orderbook::SUCCESS;
+    }
+
+    int WriteGolden(const std::string & path, const std::vector<Result> & results) {
+        std::ofstream file(path, std::ios::trunc);
+        if (!file) {
+            std::cerr<<"Could not create golden file "<<path<<'\n';
+            return orderbook::ERR_IO;
+        }
+
+        file<<"# run fingerprint orders\n";
+        for (const auto & result : results) {
+            if (result.rc_ == orderbook::SUCCESS) {
+                file<<result.name_<<' '<<std::hex<<std::setw(16)<<std::setfill('0')<<result.fingerprint_<<std::dec<<' '<<result.orders_<<'\n';
+            }
+        }
+
+        if (!file) {
+            std::cerr<<"Could not write golden file "<<path<<'\n';
+            return orderbook::ERR_IO;
+        }
+        return orderbook::SUCCESS;
+    }
+
+    std::size_t Report(const std::vector<Result> & results, const std::map<std::string, uint64_t> & golden, std::ostream & out) {
+        // A partitioned day with no golden fingerprints of its own is checked by the sum of its partitions
+        std::map<std::string, uint64_t> days;
+        for (const auto & result : results) {
+            auto partition = result.name_.find('#');
+            if (partition != std::string::npos) {
+                days[result.name_.substr(0, partition)] += result.fingerprint_;
+            }
+        }
+
+        std::size_t failed{0};
+        out<<std::left<<std::setw(40)<<"run"<<std::right<<std::setw(12)<<"messages"<<std::setw(10)<<"rejected"<<std::setw(10)<<"orders"
+           <<std::setw(18)<<"fingerprint"<<std::setw(10)<<"seconds"<<std::setw(12)<<"msgs/s"<<"  status"<<'\n';
+        for (const auto & result : results) {
+            const char * status = "-";
+            if (result.rc_ != orderbook::SUCCESS) {
+                status = "FAILED";
+            } else if (!golden.empty()) {
+                auto fingerprint = result.fingerprint_;
+                auto expected = golden.find(result.name_);
+                auto partition = result.name_.find('#');
+                if (expected == golden.end() && partition != std::string::npos) {
+                    auto day = result.name_.substr(0, partition);
+                    expected = golden.find(day);
+                    fingerprint = days[day];
+                }
+                status = expected == golden.end() ? "MISSING" : expected->second == fingerprint ? "ok" : "MISMATCH";
+            }
+            failed += status[0] != '-' && status[0] != 'o';
+
+            auto seconds = result.seconds_ > 0 ? result.seconds_ : 1e-9;
+            out<<std::left<<std::setw(40)<<result.name_<<std::right<<std::setw(12)<<result.messages_<<std::setw(10)<<result.rejected_
+               <<std::setw(10)<<result.orders_<<"  "<<std::hex<<std::setw(16)<<std::setfill('0')<<result.fingerprint_<<std::dec<<std::setfill(' ')
+               <<std::setw(10)<<std::fixed<<std::setprecision(3)<<result.seconds_<<std::setw(12)<<static_cast<uint64_t>(result.messages_ / seconds)
+               <<"  "<<status<<'\n';
+        }
+        out.unsetf(std::ios::fixed);
+        return failed;
+    }
+
+} // namespace harness
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "orderbook.hpp"
+
+namespace harness {
+
+    // One replay: a day's capture file, or a CSV or FIX order file (.csv, .fix or .txt), replayed into
+    // a book of its own. With more than one partition only the securities that hash to this partition
+    // are applied, along with the modifies and deletes of orders added for them, so a day can be spread
+    // over several runs whose fingerprints sum to the whole day's.
+    struct Run {
+        std::string path_;
+        uint32_t partition_{0};
+        uint32_t partitions_{1};
+        bool map_{false};           // Map text files rather than reading them
+
+        // The path, followed by #partition/partitions when the day is split
+        std::string Name() const;
+    };
+
+    struct Result {
+        std::string name_;
+        int rc_{orderbook::SUCCESS};
+        std::size_t messages_{0};
+        std::size_t rejected_{0};
+        std::size_t orders_{0};     // Left resting at the end of the run
+        uint64_t fingerprint_{0};
+        double seconds_{0.0};
+    };
+
+    // The partition a security id belongs to, from its bytes alone so it is the same on every run
+    uint32_t Partition(const char * security, std::size_t length, uint32_t partitions);
+
+    Result Replay(const Run & run);
+    // Replays every run on a pool of threads, each taking the next run not yet started, and returns
+    // the results in the order of the runs
+    std::vector<Result> Replay(const std::vector<Run> & runs, std::size_t threads);
+
+    // A golden file holds a line per run, its name then its fingerprint in hex then the orders left
+    // resting. Lines starting with '#' are comments.
+    int ReadGolden(const std::string & path, std::map<std::string, uint64_t> & golden);
+    int WriteGolden(const std::string & path, const std::vector<Result> & results);
+
+    // Prints a line per run with its throughput and whether its fingerprint matches the golden one,
+    // returning how many runs failed or, given golden fingerprints, didn't match or have none. The
+    // partitions of a day with no golden fingerprints of their own are checked against the day's, by
+    // the sum of their fingerprints.
+    std::size_t Report(const std::vector<Result> & results, const std::map<std::string, uint64_t> & golden, std::ostream & out);
+
+} // namespace harness
@@ -0,0 +1,579 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "price.hpp"
+
+namespace orderbook {
+
+    // Both level containers below share the same interface, so a Security can be built on either:
+    //   Find(price)      the level at a price, or nullptr
+    //   Insert(price)    the level at a price, created if needed
+    //   Erase(price)     remove an emptied level
+    //   At(index, price) the level index places from the top of the book, or nullptr
+    //   Best(price)      the level at the top of the book, or nullptr, for matching against
+    //   Prefetch(price)  a hint that the level at a price is about to be used
+    //   ForEach(f)       visit f(price, level) from the top of the book down
+    //   ForTop(count, f) visit f(price, level) for at most the top count levels
+    //   ForWithin(distance, f) visit f(price, level) for the levels at most distance ticks from the top
+    //   Bytes()          heap memory held beyond the container itself
+
+    // Price levels in a red black tree, one node per level
+    template<typename Side, typename Level>
+    class MapLevels {
+        public:
+            Level * Find(Tick price) {
+                auto pos = levels_.find(price);
+                return pos != levels_.end() ? &pos->second : nullptr;
+            }
+
+            const Level * Find(Tick price) const {
+                auto pos = levels_.find(price);
+                return pos != levels_.end() ? &pos->second : nullptr;
+            }
+
+            Level * Insert(Tick price) {
+                return &levels_[price];
+            }
+
+            void Erase(Tick price) {
+                levels_.erase(price);
+            }
+
+            // The nodes of a tree can't be found without walking it, so there is nothing to prefetch
+            void Prefetch(Tick) const {}
+
+            Level * Best(Tick & price) {
+                if (levels_.empty()) {
+                    return nullptr;
+                }
+                auto it = levels_.begin();
+                price = it->first;
+                return &it->second;
+            }
+
+            const Level * At(std::size_t index, Tick & price) const {
+                if (index >= levels_.size()) {
+                    return nullptr;
+                }
+                auto it = levels_.begin();
+                std::advance(it, index);
+                price = it->first;
+                return &it->second;
+            }
+
+            template<typename F>
+            void ForEach(F && f) const {
+                for (const auto & level : levels_) {
+                    f(level.first, level.second);
+                }
+            }
+
+            template<typename F>
+            void ForTop(std::size_t count, F && f) const {
+                for (auto it = levels_.begin(); it != levels_.end() && count--; ++it) {
+                    f(it->first, it->second);
+                }
+            }
+
+            template<typename F>
+            void ForWithin(Tick distance, F && f) const {
+                if (levels_.empty()) {
+                    return;
+                }
+                auto best = levels_.begin()->first;
+                for (auto it = levels_.begin(); it != levels_.end() && (it->first > best ? it->first - best : best - it->first) <= distance; ++it) {
+                    f(it->first, it->second);
+                }
+            }
+
+            std::size_t Size() const { return levels_.size(); }
+            bool Empty() const { return levels_.empty(); }
+            void Clear() { levels_.clear(); }
+
+            // A libstdc++ node is the level and its key behind the colour and three links
+            std::size_t Bytes() const {
+                return levels_.size() * (sizeof(typename decltype(levels_)::value_type) + 4 * sizeof(void *));
+            }
+
+        private:
+            std::map<Tick, Level, typename Side::Compare> levels_;
+    };
+
+    // Price levels in a contiguous array indexed by the tick offset from an anchor price. Occupied
+    // slots are flagged in a bitmap, so the next level down the book is found a word at a time, and
+    // the best price is kept as a cursor. When a price falls outside the window the ladder is grown
+    // and re-centered around the levels it holds. A price too far from them for the window to span
+    // is kept in an ordered overflow instead, which is walked along with the window, and moved into
+    // the window once a re-centering reaches it.
+    template<typename Side, typename Level>
+    class PriceLadder {
+        public:
+            static constexpr std::size_t MIN_SPAN = 64;
+            static constexpr std::size_t MAX_SPAN = std::size_t{1} << 20;
+
+            Level * Find(Tick price) {
+                return const_cast<Level *>(static_cast<const PriceLadder *>(this)->Find(price));
+            }
+
+            const Level * Find(Tick price) const {
+                auto slot = Slot(price);
+                if (slot != NPOS) {
+                    return Occupied(slot) ? &slots_[slot] : nullptr;
+                }
+                auto pos = overflow_.find(price);
+                return pos != overflow_.end() ? &pos->second : nullptr;
+            }
+
+            Level * Insert(Tick price) {
+                auto slot = Slot(price);
+                if (slot == NPOS) {
+                    if (!overflow_.empty()) {
+                        auto pos = overflow_.find(price);
+                        if (pos != overflow_.end()) {
+                            return &pos->second;
+                        }
+                    }
+                    if (!Recenter(price)) {
+                        return &overflow_[price]; // Too far from the rest of the book to hold in one window
+                    }
+                    slot = Slot(price);
+                }
+
+                if (!Occupied(slot)) {
+                    bitmap_[slot / 64] |= (uint64_t{1} << (slot % 64));
+                    ++count_;
+                    if (best_ == NPOS || Side::Better(price, anchor_ + static_cast<Tick>(best_))) {
+                        best_ = slot;
+                    }
+                }
+                return &slots_[slot];
+            }
+
+            void Prefetch(Tick price) const {
+                auto slot = Slot(price);
+                if (slot != NPOS) {
+                    __builtin_prefetch(&slots_[slot]);
+                    __builtin_prefetch(&bitmap_[slot / 64]);
+                }
+            }
+
+            void Erase(Tick price) {
+                auto slot = Slot(price);
+                if (slot == NPOS) {
+                    overflow_.erase(price);
+                    return;
+                }
+                if (!Occupied(slot)) {
+                    return;
+                }
+
+                bitmap_[slot / 64] &= ~(uint64_t{1} << (slot % 64));
+                slots_[slot] = Level{};
+                --count_;
+                if (slot == best_) {
+                    best_ = count_ ? Next(slot) : NPOS;
+                }
+            }
+
+            Level * Best(Tick & price) {
+                if (!overflow_.empty() && (best_ == NPOS || Ahead(overflow_.begin()->first))) {
+                    price = overflow_.begin()->first;
+                    return &overflow_.begin()->second;
+                }
+                if (best_ == NPOS) {
+                    return nullptr;
+                }
+                price = anchor_ + static_cast<Tick>(best_);
+                return &slots_[best_];
+            }
+
+            // Counts whole bitmap words at a time rather than stepping from level to level
+            const Level * At(std::size_t index, Tick & price) const {
+                if (!overflow_.empty()) {
+                    const Level * found{nullptr};
+                    Walk([&index, &price, &found] (Tick at, const Level & level) {
+                        if (index--) {
+                            return true;
+                        }
+                        price = at;
+                        found = &level;
+                        return false;
+                    });
+                    return found;
+                }
+                if (index >= count_) {
+                    return nullptr;
+                }
+                auto word = best_ / 64;
+                auto bits = bitmap_[word] & (Side::ASCENDING ? ~uint64_t{0} << (best_ % 64) : ~uint64_t{0} >> (63 - best_ % 64));
+                std::size_t levels;
+                while (index >= (levels = static_cast<std::size_t>(__builtin_popcountll(bits)))) {
+                    index -= levels;
+                    word = Side::ASCENDING ? word + 1 : word - 1;
+                    bits = bitmap_[word];
+                }
+                // Then drops the levels before it within the word
+                while (index--) {
+                    bits &= Side::ASCENDING ? bits - 1 : ~(uint64_t{1} << (63 - __builtin_clzll(bits)));
+                }
+                auto slot = word * 64 + static_cast<std::size_t>(Side::ASCENDING ? __builtin_ctzll(bits) : 63 - __builtin_clzll(bits));
+                price = anchor_ + static_cast<Tick>(slot);
+                return &slots_[slot];
+            }
+
+            template<typename F>
+            void ForEach(F && f) const {
+                Walk([&f] (Tick price, const Level & level) {
+                    f(price, level);
+                    return true;
+                });
+            }
+
+            template<typename F>
+            void ForTop(std::size_t count, F && f) const {
+                Walk([&f, &count] (Tick price, const Level & level) {
+                    if (count == 0) {
+                        return false;
+                    }
+                    --count;
+                    f(price, level);
+                    return true;
+                });
+            }
+
+            template<typename F>
+            void ForWithin(Tick distance, F && f) const {
+                auto span = std::max<Tick>(distance, 0);
+                bool first{true};
+                Tick best{0};
+                Walk([&f, span, &first, &best] (Tick price, const Level & level) {
+                    if (first) {
+                        best = price;
+                        first = false;
+                    }
+                    if ((price > best ? price - best : best - price) > span) {
+                        return false;
+                    }
+                    f(price, level);
+                    return true;
+                });
+            }
+
+            std::size_t Size() const { return count_ + overflow_.size(); }
+            bool Empty() const { return Size() == 0; }
+
+            void Clear() {
+                slots_.clear();
+                bitmap_.clear();
+                overflow_.clear();
+                count_ = 0;
+                best_ = NPOS;
+            }
+
+            // Overflow nodes are counted as MapLevels counts its own
+            std::size_t Bytes() const {
+                return slots_.capacity() * sizeof(Level) + bitmap_.capacity() * sizeof(uint64_t) +
+                       overflow_.size() * (sizeof(typename decltype(overflow_)::value_type) + 4 * sizeof(void *));
+            }
+
+        private:
+            static constexpr std::size_t NPOS = static_cast<std::size_t>(-1);
+
+            std::size_t Slot(Tick price) const {
+                auto offset = price - anchor_;
+                return (offset >= 0 && static_cast<std::size_t>(offset) < slots_.size()) ? static_cast<std::size_t>(offset) : NPOS;
+            }
+
+            bool Occupied(std::size_t slot) const {
+                return bitmap_[slot / 64] & (uint64_t{1} << (slot % 64));
+            }
+
+            // Whether a price outside the window is better than every price in it
+            bool Ahead(Tick price) const {
+                return Side::ASCENDING ? price < anchor_ : price >= anchor_ + static_cast<Tick>(slots_.size());
+            }
+
+            // Visits f(price, level) from the top of the book down until it returns false: the overflow
+            // ahead of the window, the window, then the overflow behind it
+            template<typename F>
+            void Walk(F && f) const {
+                auto pos = overflow_.begin();
+                for (; pos != overflow_.end() && Ahead(pos->first); ++pos) {
+                    if (!f(pos->first, pos->second)) {
+                        return;
+                    }
+                }
+                for (auto slot = best_; slot != NPOS; slot = Next(slot)) {
+                    if (!f(anchor_ + static_cast<Tick>(slot), slots_[slot])) {
+                        return;
+                    }
+                }
+                for (; pos != overflow_.end(); ++pos) {
+                    if (!f(pos->first, pos->second)) {
+                        return;
+                    }
+                }
+            }
+
+            // The next occupied slot after this one, walking away from the top of the book
+            std::size_t Next(std::size_t slot) const {
+                return Side::ASCENDING ? Above(slot + 1) : (slot ? Below(slot - 1) : NPOS);
+            }
+
+            // The lowest occupied slot at or above this one
+            std::size_t Above(std::size_t slot) const {
+                if (slot >= slots_.size()) {
+                    return NPOS;
+                }
+                auto word = slot / 64;
+                auto bits = bitmap_[word] & (~uint64_t{0} << (slot % 64));
+                while (!bits) {
+                    if (++word == bitmap_.size()) {
+                        return NPOS;
+                    }
+                    bits = bitmap_[word];
+                }
+                return word * 64 + static_cast<std::size_t>(__builtin_ctzll(bits));
+            }
+
+            // The highest occupied slot at or below this one
+            std::size_t Below(std::size_t slot) const {
+                auto word = slot / 64;
+                auto bits = bitmap_[word] & (~uint64_t{0} >> (63 - slot % 64));
+                while (!bits) {
+                    if (word-- == 0) {
+                        return NPOS;
+                    }
+                    bits = bitmap_[word];
+                }
+                return word * 64 + 63 - static_cast<std::size_t>(__builtin_clzll(bits));
+            }
+
+            bool Recenter(Tick price) {
+                auto low = price;
+                auto high = price;
+                if (count_) {
+                    low = std::min(low, anchor_ + static_cast<Tick>(Above(0)));
+                    high = std::max(high, anchor_ + static_cast<Tick>(Below(slots_.size() - 1)));
+                }
+
+                auto needed = static_cast<std::size_t>(high - low) + 1;
+                if (needed > MAX_SPAN) {
+                    return false;
+                }
+
+                // Leave room either side of the current levels so the book can drift without re-centering again
+                auto span = std::max(slots_.size(), MIN_SPAN);
+                while (span < needed * 2 && span < MAX_SPAN) {
+                    span *= 2;
+                }
+                auto anchor = low - static_cast<Tick>((span - needed) / 2);
+
+                std::vector<Level> slots(span);
+                std::vector<uint64_t> bitmap(span / 64);
+                for (auto slot = count_ ? Above(0) : NPOS; slot != NPOS; slot = Above(slot + 1)) {
+                    auto moved = static_cast<std::size_t>(anchor_ + static_cast<Tick>(slot) - anchor);
+                    slots[moved] = std::move(slots_[slot]);
+                    bitmap[moved / 64] |= (uint64_t{1} << (moved % 64));
+                }
+                if (best_ != NPOS) {
+                    best_ = static_cast<std::size_t>(anchor_ + static_cast<Tick>(best_) - anchor);
+                }
+
+                slots_.swap(slots);
+                bitmap_.swap(bitmap);
+                anchor_ = anchor;
+
+                // Overflow the new window reaches moves into it, so the overflow only holds prices outside it
+                for (auto pos = overflow_.begin(); pos != overflow_.end();) {
+                    auto slot = Slot(pos->first);
+                    if (slot == NPOS) {
+                        ++pos;
+                        continue;
+                    }
+                    slots_[slot] = std::move(pos->second);
+                    bitmap_[slot / 64] |= (uint64_t{1} << (slot % 64));
+                    ++count_;
+                    if (best_ == NPOS || Side::Better(pos->first, anchor_ + static_cast<Tick>(best_))) {
+                        best_ = slot;
+                    }
+                    pos = overflow_.erase(pos);
+                }
+                return true;
+            }
+
+            std::vector<Level> slots_;
+            std::vector<uint64_t> bitmap_;
+            std::map<Tick, Level, typename Side::Compare> overflow_;
+            Tick anchor_{0};
+            std::size_t count_{0};
+            std::size_t best_{NPOS};
+    };
+
+    // The first INLINE levels of a side held in place, sorted best first, with the Deep container only
+    // built once a side holds more and freed again when it empties. Most securities in a large universe
+    // never have more than a level or two a side, so they cost the inline levels and a pointer rather
+    // than an empty container each, and a ladder's slots once they get their first order.
+    template<typename Side, typename Level, typename Deep, std::size_t INLINE = 2>
+    class InlineLevels {
+        public:
+            Level * Find(Tick price) {
+                if (deep_) {
+                    return deep_->Find(price);
+                }
+                auto index = Index(price);
+                return index < size_ && prices_[index] == price ? &levels_[index] : nullptr;
+            }
+
+            const Level * Find(Tick price) const {
+                return const_cast<InlineLevels *>(this)->Find(price);
+            }
+
+            Level * Insert(Tick price) {
+                if (deep_) {
+                    return deep_->Insert(price);
+                }
+                auto index = Index(price);
+                if (index < size_ && prices_[index] == price) {
+                    return &levels_[index];
+                }
+                if (size_ == INLINE) {
+                    return Spill(price);
+                }
+                for (auto i = size_; i > index; --i) {
+                    prices_[i] = prices_[i - 1];
+                    levels_[i] = levels_[i - 1];
+                }
+                prices_[index] = price;
+                levels_[index] = Level{};
+                ++size_;
+                return &levels_[index];
+            }
+
+            void Erase(Tick price) {
+                if (deep_) {
+                    deep_->Erase(price);
+                    if (deep_->Empty()) {
+                        deep_.reset();
+                    }
+                    return;
+                }
+                auto index = Index(price);
+                if (index == size_ || prices_[index] != price) {
+                    return;
+                }
+                for (--size_; index < size_; ++index) {
+                    prices_[index] = prices_[index + 1];
+                    levels_[index] = levels_[index + 1];
+                }
+                levels_[size_] = Level{};
+            }
+
+            // The inline levels share a line with the Security, which is prefetched already
+            void Prefetch(Tick price) const {
+                if (deep_) {
+                    deep_->Prefetch(price);
+                }
+            }
+
+            Level * Best(Tick & price) {
+                if (deep_) {
+                    return deep_->Best(price);
+                }
+                if (size_ == 0) {
+                    return nullptr;
+                }
+                price = prices_[0];
+                return &levels_[0];
+            }
+
+            const Level * At(std::size_t index, Tick & price) const {
+                if (deep_) {
+                    return deep_->At(index, price);
+                }
+                if (index >= size_) {
+                    return nullptr;
+                }
+                price = prices_[index];
+                return &levels_[index];
+            }
+
+            template<typename F>
+            void ForEach(F && f) const {
+                ForTop(Size(), f);
+            }
+
+            template<typename F>
+            void ForTop(std::size_t count, F && f) const {
+                if (deep_) {
+                    deep_->ForTop(count, f);
+                    return;
+                }
+                for (std::size_t i = 0; i < size_ && i < count; ++i) {
+                    f(prices_[i], levels_[i]);
+                }
+            }
+
+            template<typename F>
+            void ForWithin(Tick distance, F && f) const {
+                if (deep_) {
+                    deep_->ForWithin(distance, f);
+                    return;
+                }
+                for (std::size_t i = 0; i < size_ && (prices_[i] > prices_[0] ? prices_[i] - prices_[0] : prices_[0] - prices_[i]) <= distance; ++i) {
+                    f(prices_[i], levels_[i]);
+                }
+            }
+
+            std::size_t Size() const { return deep_ ? deep_->Size() : size_; }
+            bool Empty() const { return Size() == 0; }
+
+            void Clear() {
+                deep_.reset();
+                for (std::size_t i = 0; i < size_; ++i) {
+                    levels_[i] = Level{};
+                }
+                size_ = 0;
+            }
+
+            bool Spilled() const { return static_cast<bool>(deep_); }
+
+            std::size_t Bytes() const {
+                return deep_ ? sizeof(Deep) + deep_->Bytes() : 0;
+            }
+
+        private:
+            // Where the price is held, or would go to keep the levels sorted
+            std::size_t Index(Tick price) const {
+                std::size_t index = 0;
+                while (index < size_ && Side::Better(prices_[index], price)) {
+                    ++index;
+                }
+                return index;
+            }
+
+            // Moves the inline levels into the deep container along with the new one
+            Level * Spill(Tick price) {
+                std::unique_ptr<Deep> deep(new Deep);
+                for (std::size_t i = 0; i < size_; ++i) {
+                    *deep->Insert(prices_[i]) = levels_[i];
+                }
+                auto * level = deep->Insert(price);
+                Clear();
+                deep_ = std::move(deep);
+                return level;
+            }
+
+            Tick prices_[INLINE]{};
+            Level levels_[INLINE]{};
+            uint32_t size_{0};
+            std::unique_ptr<Deep> deep_;
+    };
+
+} // namespace orderbook
@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "logger.hpp"
+
+namespace orderbook {
+
+    namespace {
+
+        std::atomic<uint64_t> nextLogger{1};
+
+        // The ring the calling thread last logged to, tagged with its logger's id rather than its address
+        // so a new logger at the same address can't be handed a stale ring
+        struct RingCache {
+            uint64_t logger_{0};
+            void * ring_{nullptr};
+        };
+
+        thread_local RingCache cache;
+
+    } // namespace
+
+    Logger::Logger(std::ostream & out, const Config & config) : out_(out), config_(config), id_(nextLogger.fetch_add(1)) {
+        window_ = reported_ = std::chrono::steady_clock::now();
+        thread_ = std::thread(&Logger::Run, this);
+    }
+
+    Logger::~Logger() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_one();
+        thread_.join();
+    }
+
+    bool Logger::Log(const LogRecord & record) {
+        if (muted_.load(std::memory_order_relaxed)) {
+            return true;
+        }
+        auto & ring = Local();
+        if (!ring.queue_.TryPush(record)) {
+            ring.dropped_.store(ring.dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+        ring.logged_.store(ring.logged_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        return true;
+    }
+
+    void Logger::Flush() {
+        std::size_t logged{0};
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto & ring : rings_) {
+                logged += ring->logged_.load(std::memory_order_acquire);
+            }
+            flush_ = true;
+        }
+        wake_.notify_one();
+        while (consumed_.load(std::memory_order_acquire) < logged) {
+            std::this_thread::yield();
+        }
+    }
+
+    std::size_t Logger::Dropped() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::size_t dropped{0};
+        for (auto & ring : rings_) {
+            dropped += ring->dropped_.load(std::memory_order_relaxed);
+        }
+        return dropped;
+    }
+
+    Logger & Logger::Default() {
+        static Logger logger(std::cerr, Config{});
+        return logger;
+    }
+
+    Logger::Ring & Logger::Local() {
+        if (cache.logger_ == id_) {
+            return *static_cast<Ring *>(cache.ring_);
+        }
+        return Register();
+    }
+
+    Logger::Ring & Logger::Register() {
+        // A thread that logs to several loggers keeps its ring in each, only the last one used is cached
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto owner = std::this_thread::get_id();
+        Ring * ring{nullptr};
+        for (auto & existing : rings_) {
+            if (existing->owner_ == owner) {
+                ring = existing.get();
+                break;
+            }
+        }
+        if (ring == nullptr) {
+            rings_.emplace_back(new Ring(owner, config_.capacity_));
+            ring = rings_.back().get();
+        }
+        cache.logger_ = id_;
+        cache.ring_ = ring;
+        return *ring;
+    }
+
+    void Logger::Run() {
+        std::vector<Ring *> rings;
+        std::size_t popped{0};
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        while (true) {
+            // Sleep between passes that find nothing, until the idle time is up or someone is waiting
+            if (popped == 0) {
+                wake_.wait_for(lock, config_.idle_, [this] { return stop_ || flush_; });
+            }
+            rings.clear();
+            for (auto & ring : rings_) {
+                rings.push_back(ring.get());
+            }
+            auto stopping = stop_;
+            flush_ = false;
+            lock.unlock();
+
+            popped = 0;
+            LogRecord record;
+            auto now = std::chrono::steady_clock::now();
+            for (auto * ring : rings) {
+                while (ring->queue_.TryPop(record)) {
+                    ++popped;
+                    if (Admit(now)) {
+                        Format(record);
+                        written_.fetch_add(1, std::memory_order_relaxed);
+                    } else {
+                        suppressed_.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    consumed_.fetch_add(1, std::memory_order_release);
+                }
+            }
+            Report(now, stopping && popped == 0);
+            if (popped) {
+                out_.flush();
+            }
+
+            lock.lock();
+            if (popped == 0 && stopping) {
+                break;
+            }
+        }
+    }
+
+    bool Logger::Admit(std::chrono::steady_clock::time_point now) {
+        if (config_.rate_ == 0) {
+            return true;
+        }
+        if (now - window_ >= std::chrono::seconds(1)) {
+            window_ = now;
+            windowLines_ = 0;
+        }
+        return windowLines_++ < config_.rate_;
+    }
+
+    void Logger::Report(std::chrono::steady_clock::time_point now, bool force) {
+        // At most once a second, so a logger that is dropping doesn't flood the output reporting it
+        if (!force && now - reported_ < std::chrono::seconds(1)) {
+            return;
+        }
+        reported_ = now;
+
+        auto dropped = Dropped();
+        if (dropped != reportedDrops_) {
+            out_<<"Logger dropped "<<(dropped - reportedDrops_)<<" events, the logging thread fell behind\n";
+            reportedDrops_ = dropped;
+        }
+        auto suppressed = suppressed_.load(std::memory_order_relaxed);
+        if (suppressed != reportedSuppressed_) {
+            out_<<"Logger suppressed "<<(suppressed - reportedSuppressed_)<<" events over "<<config_.rate_<<" a second\n";
+            reportedSuppressed_ = suppressed;
+        }
+    }
+
+    void Logger::Format(const LogRecord & record) {
+        switch (record.event_) {
+            case LogEvent::INVALID_SECURITY:
+                out_<<"Invalid SecurityID ["<<record.symbol_<<"] OrderID ["<<record.order_<<"]\n";
+                break;
+            case LogEvent::UNKNOWN_SECURITY:
+                out_<<"Unknown security "<<record.symbol_<<'\n';
+                break;
+            case LogEvent::UNKNOWN_INSTRUMENT:
+                out_<<"Unknown instrument "<<record.instrument_;
+                if (record.order_) {
+                    out_<<" OrderID ["<<record.order_<<"]";
+                }
+                out_<<'\n';
+                break;
+            case LogEvent::UNKNOWN_ORDER:
+                out_<<"Could not find entry for OrderID ["<<record.order_<<"]\n";
+                break;
+            case LogEvent::DUPLICATE_ORDER:
+                out_<<"Duplicate OrderID ["<<record.order_<<"] for instrument "<<record.instrument_<<'\n';
+                break;
+            case LogEvent::UNKNOWN_ACTION:
+                out_<<"Unknown OrderAction "<<record.value_<<'\n';
+                break;
+            case LogEvent::UNKNOWN_DIRECTION:
+                out_<<"Unhandled OrderDirection "<<record.value_<<'\n';
+                break;
+            case LogEvent::PRICE_RANGE:
+                out_<<"Price out of range Price: ["<<ToPrice(record.price_)<<"] OrderID ["<<record.order_<<"]\n";
+                break;
+            case LogEvent::UNROUTABLE:
+                out_<<"Cannot route OrderID ["<<record.order_<<"] without a SecurityID or an earlier add\n";
+                break;
+            case LogEvent::FILLS_FULL:
+                out_<<"Fill buffer full at Price: ["<<ToPrice(record.price_)<<"] OrderID ["<<record.order_<<"], remainder cancelled\n";
+                break;
+            default:
+                out_<<"Unknown log event "<<static_cast<uint16_t>(record.event_)<<'\n';
+                break;
+        }
+    }
+
+    void LogSymbol(LogEvent event, const char * symbol, std::size_t length, int_fast64_t order) {
+        LogRecord record;
+        record.event_ = event;
+        record.value_ = 0;
+        record.instrument_ = NO_INSTRUMENT;
+        record.order_ = order;
+        record.price_ = 0;
+        // Anything past the key length could never have been a security, so it is cut short
+        length = strnlen(symbol, std::min(length, SymbolRegistry::SYMBOL_LEN - 1));
+        std::memcpy(record.symbol_, symbol, length);
+        record.symbol_[length] = '\0';
+        Logger::Default().Log(record);
+    }
+
+    void LogValue(LogEvent event, int value) {
+        LogRecord record;
+        record.event_ = event;
+        record.value_ = static_cast<int16_t>(value);
+        record.instrument_ = NO_INSTRUMENT;
+        record.order_ = 0;
+        record.price_ = 0;
+        record.symbol_[0] = '\0';
+        Logger::Default().Log(record);
+    }
+
+} // namespace orderbook
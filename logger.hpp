@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "price.hpp"
+#include "spsc.hpp"
+#include "symbols.hpp"
+
+namespace orderbook {
+
+    enum class LogEvent : uint16_t {
+        INVALID_SECURITY,       // symbol_, order_
+        UNKNOWN_SECURITY,       // symbol_
+        UNKNOWN_INSTRUMENT,     // instrument_, order_ if there was one
+        UNKNOWN_ORDER,          // order_
+        DUPLICATE_ORDER,        // order_, instrument_
+        UNKNOWN_ACTION,         // value_
+        UNKNOWN_DIRECTION,      // value_
+        PRICE_RANGE,            // order_, price_
+        UNROUTABLE,             // order_
+        FILLS_FULL,             // order_, instrument_, price_ the sweep stopped at
+    };
+
+    // What the hot path hands to the logger, a fixed size event that is only formatted on the writer thread
+    struct LogRecord {
+        LogEvent event_;
+        int16_t value_;
+        InstrumentID instrument_;
+        int_fast64_t order_;
+        Tick price_;
+        char symbol_[SymbolRegistry::SYMBOL_LEN];
+    };
+
+    // Asynchronous logging of book errors. Each thread that logs gets its own single producer single
+    // consumer ring, so logging is a copy into the ring and never takes a lock or waits on I/O. A
+    // background thread formats the events and writes them out, at most rate_ lines a second. Events
+    // beyond the rate are counted as suppressed, and events that find their ring full are counted as
+    // dropped, and both counts are written out once the logger catches up.
+    class Logger {
+        public:
+            struct Config {
+                std::size_t capacity_{4096};                // Events each thread's ring can hold
+                std::size_t rate_{1000};                    // Lines written a second, 0 for no limit
+                std::chrono::milliseconds idle_{1};         // How long the writer sleeps when every ring is empty
+            };
+
+            Logger(std::ostream & out, const Config & config);
+            // Writes out everything already logged before returning
+            ~Logger();
+
+            Logger(const Logger &) = delete;
+            Logger & operator=(const Logger &) = delete;
+
+            // Never blocks, returns false if the calling thread's ring was full and the event was dropped
+            bool Log(const LogRecord & record);
+
+            // Wait until every event logged so far has been written or suppressed
+            void Flush();
+
+            // While muted, events are discarded as they are logged, for runs that expect to log errors
+            void Mute(bool muted) { muted_.store(muted, std::memory_order_relaxed); }
+
+            std::size_t Written() const { return written_.load(std::memory_order_relaxed); }
+            std::size_t Suppressed() const { return suppressed_.load(std::memory_order_relaxed); }
+            std::size_t Dropped() const;
+
+            // The process wide logger the book writes to, on std::cerr
+            static Logger & Default();
+
+        private:
+            struct Ring {
+                Ring(std::thread::id owner, std::size_t capacity) : owner_(owner), queue_(capacity) {}
+
+                std::thread::id owner_;
+                SpscQueue<LogRecord> queue_;
+                alignas(CACHE_LINE) std::atomic<std::size_t> logged_{0};
+                std::atomic<std::size_t> dropped_{0};
+            };
+
+            Ring & Local();
+            Ring & Register();
+            void Run();
+            bool Admit(std::chrono::steady_clock::time_point now);
+            void Format(const LogRecord & record);
+            void Report(std::chrono::steady_clock::time_point now, bool force);
+
+            std::ostream & out_;
+            Config config_;
+            uint64_t id_;
+
+            mutable std::mutex mutex_;
+            std::vector<std::unique_ptr<Ring>> rings_;
+            std::condition_variable wake_;
+            bool stop_{false};
+            bool flush_{false};
+
+            std::atomic<bool> muted_{false};
+            std::atomic<std::size_t> written_{0};
+            std::atomic<std::size_t> suppressed_{0};
+            std::atomic<std::size_t> consumed_{0};
+            std::size_t reportedDrops_{0};
+            std::size_t reportedSuppressed_{0};
+            std::chrono::steady_clock::time_point window_;
+            std::chrono::steady_clock::time_point reported_;
+            std::size_t windowLines_{0};
+
+            std::thread thread_;
+    };
+
+    inline void Log(LogEvent event, int_fast64_t order, InstrumentID instrument = NO_INSTRUMENT, Tick price = 0) {
+        LogRecord record;
+        record.event_ = event;
+        record.value_ = 0;
+        record.instrument_ = instrument;
+        record.order_ = order;
+        record.price_ = price;
+        record.symbol_[0] = '\0';
+        Logger::Default().Log(record);
+    }
+
+    void LogSymbol(LogEvent event, const char * symbol, std::size_t length, int_fast64_t order = 0);
+
+    // For enums on a message that aren't one of their known values
+    void LogValue(LogEvent event, int value);
+
+} // namespace orderbook
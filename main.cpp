@@ -1,8 +1,17 @@
 #include <unistd.h>
 
+#include <cstdio>
+#include <memory>
+
 #include "datafeed.hpp"
+#include "engine.hpp"
 #include "orderbook.hpp"
 #include "compact.hpp"
+#include "persist.hpp"
+#include "pipeline.hpp"
+#include "stats.hpp"
+#include "text.hpp"
+#include "wire.hpp"
 
 int main(int argc, char *argv[])
 {
@@ -11,8 +20,22 @@ int main(int argc, char *argv[])
     bool testopt = false;
     bool sizeopt = false;
     std::string symbol;
+    std::string master;
+    orderbook::Engine::Config sharding{0};
+    std::string replayfile;
+    std::string convertfile;
+    std::string textfile;
+    std::string writetextfile;
+    bool mapopt = false;
+    std::string ingestfile;
+    orderbook::Pipeline::Config pipeline;
+    bool statsopt = false;
+    long statsinterval = 0;
+    std::string journalfile;
+    std::string snapshotfile;
+    bool recoveropt = false;
 
-    while ((opt = getopt(argc, argv, "p:tsh")) != -1) {
+    while ((opt = getopt(argc, argv, "p:m:e:r:c:T:x:I:C:W:S:j:k:RMtsh")) != -1) {
         switch (opt) {
             case 'p':
                 printopt = true;
@@ -24,19 +47,178 @@ int main(int argc, char *argv[])
             case 's':
                 sizeopt = true;
             break;
+            case 'm':
+                master = optarg;
+            break;
+            case 'e':
+                if (std::sscanf(optarg, "%zu,%d", &sharding.shards_, &sharding.firstCpu_) < 1) {
+                    std::cerr<<"Expected shards or shards,firstcpu"<<'\n';
+                    return 1;
+                }
+            break;
+            case 'r':
+                replayfile = optarg;
+            break;
+            case 'c':
+                convertfile = optarg;
+            break;
+            case 'T':
+                textfile = optarg;
+            break;
+            case 'x':
+                writetextfile = optarg;
+            break;
+            case 'M':
+                mapopt = true;
+            break;
+            case 'I':
+                ingestfile = optarg;
+            break;
+            case 'C':
+                if (std::sscanf(optarg, "%d,%d,%d", &pipeline.readerCpu_, &pipeline.decoderCpu_, &pipeline.bookCpu_) != 3) {
+                    std::cerr<<"Expected cpus as reader,decoder,book"<<'\n';
+                    return 1;
+                }
+            break;
+            case 'W':
+                pipeline.wait_ = orderbook::Pipeline::Wait::SLEEP;
+                pipeline.sleep_ = std::chrono::microseconds(std::stol(optarg));
+            break;
+            case 'S':
+                statsopt = true;
+                statsinterval = std::stol(optarg);
+            break;
+            case 'j':
+                journalfile = optarg;
+            break;
+            case 'k':
+                snapshotfile = optarg;
+            break;
+            case 'R':
+                recoveropt = true;
+            break;
             case 'h':
             default:
-                std::cout<<argv[0]<<" -t (test) -s (sizecomparison) -p (printbook) <symbol> "<<'\n';
+                std::cout<<argv[0]<<" -t (test) -s (sizecomparison) -p (printbook) <symbol> -m (securities master) <file> -e (sharded engine, shard i pinned to firstcpu + i) <shards[,firstcpu]> -r (replay capture) <file> -c (convert feed to capture) <file> -T (load text orders, CSV or FIX) <file> -M (map the text file) -x (write feed as text, FIX if it ends .fix) <file> -I (ingest a capture or text file on reader, decoder and book threads) <file> -C (pin the ingest stages) <reader,decoder,book> -W (sleep when idle rather than busy poll) <microseconds> -S (stats, every n seconds or 0 at exit) <n> -j (journal) <file> -k (snapshot) <file> -R (recover from snapshot and journal) "<<'\n';
             break;
         }
     }
 
+    if(!convertfile.empty()) {
+        return wire::Write(convertfile, orderbook::datafeed) == orderbook::SUCCESS ? 0 : 1;
+    }
+
+    if(!writetextfile.empty()) {
+        auto fix = writetextfile.size() > 4 && writetextfile.compare(writetextfile.size() - 4, 4, ".fix") == 0;
+        return text::Write(writetextfile, orderbook::datafeed, fix ? text::Format::FIX : text::Format::CSV) == orderbook::SUCCESS ? 0 : 1;
+    }
+
+    // Latency and reject stats, printed at exit and optionally while running
+    std::unique_ptr<orderbook::stats::Reporter> reporter;
+    if(statsopt && statsinterval > 0) {
+        reporter.reset(new orderbook::stats::Reporter(std::cerr, std::chrono::seconds(statsinterval)));
+    }
+
+    if(sharding.shards_) {
+        // Spread the feed across worker threads, each security is owned by one shard
+        orderbook::Engine engine(sharding);
+        engine.Start();
+        for (auto & order : orderbook::datafeed) 
+        {
+            engine.Dispatch(order);
+        }
+        engine.Drain();
+
+        if(printopt) {
+            engine.Book(engine.ShardOf(symbol)).PrintBook(symbol);
+        }
+        if(testopt) {
+            orderbook::TestEngine(engine);
+        }
+        engine.Stop();
+        if(statsopt) {
+            orderbook::stats::Dump(std::cout);
+        }
+        return 0;
+    }
+
     orderbook::Implementation book;
 
-    // Loop over each order, processing in turn
-    for (auto & order : orderbook::datafeed) 
-    {
-        book.Process(order);
+    if(!master.empty() && book.LoadSecurities(master) != orderbook::SUCCESS) {
+        return 1;
+    }
+
+    if(recoveropt) {
+        // Rebuild the book from the last checkpoint and the journal written since, instead of the feed
+        persist::RecoverStats stats;
+        if(persist::Recover(snapshotfile, journalfile, book, stats) != orderbook::SUCCESS) {
+            return 1;
+        }
+        std::cout<<"Recovered "<<stats.orders_<<" orders from snapshot and "<<stats.journal_.messages_<<" journal records ("
+                 <<stats.journal_.rejected_<<" rejected) in "<<stats.seconds_<<"s"<<'\n';
+    } else if(!replayfile.empty()) {
+        // Apply a capture file straight from its mapping instead of the compiled in feed
+        wire::ReplayStats stats;
+        if(wire::Replay(replayfile, book, stats) != orderbook::SUCCESS) {
+            return 1;
+        }
+        std::cout<<"Replayed "<<stats.messages_<<" messages ("<<stats.rejected_<<" rejected) in "<<stats.seconds_<<"s, "
+                 <<static_cast<uint64_t>(stats.messages_ / (stats.seconds_ > 0 ? stats.seconds_ : 1e-9))<<" msgs/s"<<'\n';
+    } else if(!ingestfile.empty()) {
+        // Read, decode and apply a file on a thread each, the book thread only applying batches
+        pipeline.map_ = mapopt;
+        orderbook::Pipeline ingest(book, pipeline);
+        if(ingest.Run(ingestfile) != orderbook::SUCCESS) {
+            return 1;
+        }
+        const auto & stats = ingest.Statistics();
+        auto seconds = stats.seconds_ > 0 ? stats.seconds_ : 1e-9;
+        std::cout<<"Ingested "<<stats.messages_<<" messages ("<<stats.rejected_<<" rejected, "<<stats.malformed_<<" malformed) in "<<stats.seconds_<<"s, "
+                 <<static_cast<uint64_t>(stats.messages_ / seconds)<<" msgs/s, "<<stats.bytes_ / seconds / 1e6<<" MB/s"<<'\n';
+        auto stage = [] (const char * name, const char * items, const orderbook::Pipeline::StageStats & stage) {
+            std::cout<<"  "<<name<<": "<<stage.items_<<' '<<items<<", queue depth mean "<<stage.MeanDepth()<<" max "<<stage.maxDepth_
+                     <<", "<<stage.stalls_<<" stalls, "<<stage.idles_<<" idles"<<'\n';
+        };
+        stage("reader", "blocks", stats.reader_);
+        stage("decoder", "blocks", stats.decoder_);
+        stage("book", "batches", stats.book_);
+    } else if(!textfile.empty()) {
+        // Parse CSV or FIX orders from a text file instead of the compiled in feed
+        text::LoadStats stats;
+        if(text::Load(textfile, book, stats, text::Format::AUTO, mapopt) != orderbook::SUCCESS) {
+            return 1;
+        }
+        auto seconds = stats.seconds_ > 0 ? stats.seconds_ : 1e-9;
+        std::cout<<"Loaded "<<stats.messages_<<" messages ("<<stats.rejected_<<" rejected, "<<stats.malformed_<<" malformed) in "<<stats.seconds_<<"s, "
+                 <<static_cast<uint64_t>(stats.messages_ / seconds)<<" msgs/s, "<<stats.bytes_ / seconds / 1e6<<" MB/s"<<'\n';
+    } else {
+        persist::Journal journal;
+        persist::Checkpointer checkpointer;
+        if(!journalfile.empty() && journal.Open(journalfile, true) != orderbook::SUCCESS) {
+            return 1;
+        }
+
+        // Loop over each order, processing in turn
+        for (std::size_t i = 0; i < orderbook::datafeed.size(); ++i)
+        {
+            const auto & order = orderbook::datafeed[i];
+            // Checkpoint midway, so recovering needs both the snapshot and the journal tail
+            if(!snapshotfile.empty() && i == orderbook::datafeed.size() / 2) {
+                journalfile.empty() ? checkpointer.Start(snapshotfile, book, 0) : checkpointer.Start(snapshotfile, book, journal);
+            }
+            if(!journalfile.empty()) {
+                journal.Append(order);
+            }
+            book.Process(order);
+        }
+
+        if(!journalfile.empty() && journal.Sync() != orderbook::SUCCESS) {
+            return 1;
+        }
+        if(!snapshotfile.empty() && checkpointer.Wait() != orderbook::SUCCESS) {
+            std::cerr<<"Could not write snapshot "<<snapshotfile<<'\n';
+            return 1;
+        }
     }
 
     if(printopt) {
@@ -45,6 +227,27 @@ int main(int argc, char *argv[])
 
     if(testopt) {
         TestBook(book);
+        orderbook::TestOrderIndex();
+        orderbook::TestEngineRouting();
+        orderbook::TestPriceLadder();
+        orderbook::TestInlineLevels();
+        orderbook::TestLayouts();
+        orderbook::TestSymbols();
+        orderbook::TestMatching();
+        orderbook::TestBatch();
+        orderbook::TestPersistence();
+        orderbook::TestDeltas();
+        orderbook::TestQuotes();
+        orderbook::TestDepth();
+        orderbook::TestBbo();
+        orderbook::TestText();
+        orderbook::TestHarness();
+        orderbook::TestPipeline();
+        orderbook::TestLogger();
+    }
+
+    if(statsopt) {
+        orderbook::stats::Dump(std::cout);
     }
 
     if(sizeopt) {
@@ -54,6 +257,10 @@ int main(int argc, char *argv[])
         std::cout<<"Size of default order: "<<defaultsize<<'\n';
         std::cout<<"Size of compact order: "<<compactsize<<'\n';
         std::cout<<"Space saving of "<<(100.0 - saving * 100)<<"%"<<'\n';
+        std::cout<<"Size of resting order: "<<sizeof(orderbook::RestingOrder)<<'\n';
+        std::cout<<"Size of security: "<<sizeof(orderbook::Security)<<'\n';
+        auto memory = book.Memory();
+        std::cout<<"Book memory: "<<memory.Total()<<" bytes, "<<memory.PerSecurity()<<" per security, "<<memory.PerOrder()<<" per order"<<'\n';
     }
 
    return 0;
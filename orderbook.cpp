@@ -1,65 +1,579 @@
 #include <algorithm>
+#include <cassert>
 #include <functional>
 #include <iomanip>
 #include <iostream>
+#include <vector>
 
 #include "orderbook.hpp"
 
 namespace orderbook {
 
-    void Implementation::Reserve(std::size_t size) {
+    template<typename Layout>
+    void BasicImplementation<Layout>::Reserve(std::size_t size) {
+        symbols_.Reserve(size);
         orderbook_.reserve(size);
     }
 
-    int Implementation::Process(const Order & order) {
-        auto rc = SUCCESS;
+    template<typename Layout>
+    void BasicImplementation<Layout>::ReserveOrders(std::size_t size) {
+        orders_.Reserve(size);
+        pool_.Reserve(size);
+    }
+
+    template<typename Layout>
+    int BasicImplementation<Layout>::LoadSecurities(const std::string & path) {
+        auto rc = symbols_.Load(path);
+        orderbook_.resize(symbols_.Size());
+        return rc;
+    }
+
+    template<typename Layout>
+    InstrumentID BasicImplementation<Layout>::Register(const char * security, std::size_t length) {
+        auto instrument = symbols_.Intern(security, length);
+        if (instrument != NO_INSTRUMENT && instrument >= orderbook_.size()) {
+            orderbook_.resize(instrument + 1);
+        }
+        return instrument;
+    }
+
+    template<typename Layout>
+    void BasicImplementation<Layout>::Reset() {
+        // All open orders are cleared at the end of the day, the securities stay registered
+        pool_.Reset();
+        orders_.Clear();
+        for (auto & security : orderbook_) {
+            security.bid_.Clear();
+            security.ask_.Clear();
+        }
+        if (deltas_ != nullptr) {
+            deltas_->Publish(LevelDelta{0, 0, NO_INSTRUMENT, 0, DeltaSide::BID, DeltaAction::CLEAR, {}});
+        }
+        if (quotes_ != nullptr) {
+            PublishQuotes(quotes_);
+        }
+        if (depth_ != nullptr) {
+            depth_->Clear();
+        }
+        if (bbo_ != nullptr) {
+            bbo_->Clear();
+        }
+        fingerprint_ = 0;
+    }
+
+    template<typename Layout>
+    MemoryUsage BasicImplementation<Layout>::Memory() const {
+        MemoryUsage usage;
+        usage.securities_ = orderbook_.size();
+        usage.orders_ = orders_.Size();
+        usage.securityBytes_ = orderbook_.capacity() * sizeof(Security);
+        for (const auto & security : orderbook_) {
+            usage.levelBytes_ += security.bid_.Bytes() + security.ask_.Bytes();
+        }
+        usage.orderBytes_ = pool_.Bytes() + orders_.Bytes();
+        usage.symbolBytes_ = symbols_.Bytes();
+        return usage;
+    }
+
+    template<typename Layout>
+    void BasicImplementation<Layout>::PublishQuotes(QuoteBoard * board) {
+        quotes_ = board;
+        if (board != nullptr) {
+            auto count = std::min(orderbook_.size(), board->Capacity());
+            for (std::size_t instrument = 0; instrument < count; ++instrument) {
+                quoted_ = static_cast<InstrumentID>(instrument);
+                quote_ = &quotes_->Begin(quoted_);
+                quoteBids_ = quoteAsks_ = true;
+                PublishQuote();
+            }
+        }
+    }
+
+    template<typename Layout>
+    void BasicImplementation<Layout>::PublishDepth(DepthBook * depth) {
+        depth_ = depth;
+        if (depth != nullptr) {
+            depth->Clear();
+            for (InstrumentID id = 0; id < orderbook_.size(); ++id) {
+                orderbook_[id].bid_.ForEach([depth, id] (Tick price, const Level & level) {
+                    depth->Apply(id, DeltaSide::BID, price, level.volume_, DeltaAction::INSERT);
+                });
+                orderbook_[id].ask_.ForEach([depth, id] (Tick price, const Level & level) {
+                    depth->Apply(id, DeltaSide::ASK, price, level.volume_, DeltaAction::INSERT);
+                });
+            }
+        }
+    }
+
+    template<typename Layout>
+    void BasicImplementation<Layout>::KeepFingerprint(bool keep) {
+        fingerprinting_ = keep;
+        fingerprint_ = keep ? ComputeFingerprint() : 0;
+    }
+
+    template<typename Layout>
+    uint64_t BasicImplementation<Layout>::ComputeFingerprint() const {
+        uint64_t fingerprint{0};
+        ForEachOrder([this, &fingerprint] (const RestingOrder & order) {
+            fingerprint += Print(order);
+        });
+        return fingerprint;
+    }
+
+    template<typename Layout>
+    void BasicImplementation<Layout>::PublishBbo(BboTable * table) {
+        bbo_ = table;
+        if (table != nullptr) {
+            auto count = std::min(orderbook_.size(), table->Capacity());
+            for (std::size_t instrument = 0; instrument < count; ++instrument) {
+                bboTouched_ = static_cast<InstrumentID>(instrument);
+                RefreshBbo();
+            }
+        }
+    }
+
+    template<typename Layout>
+    void BasicImplementation<Layout>::RefreshBbo() {
+        const auto & security = orderbook_[bboTouched_];
+        Tick bid{BboTable::NO_BID}, ask{BboTable::NO_ASK};
+        const auto * bidLevel = security.bid_.At(0, bid);
+        const auto * askLevel = security.ask_.At(0, ask);
+        bbo_->Set(bboTouched_, bidLevel ? bid : BboTable::NO_BID, bidLevel ? bidLevel->volume_ : 0, askLevel ? ask : BboTable::NO_ASK, askLevel ? askLevel->volume_ : 0);
+        bboTouched_ = NO_INSTRUMENT;
+    }
+
+    template<typename Layout>
+    void BasicImplementation<Layout>::Requote(InstrumentID instrument, OrderDirection_t direction, Tick price, const Level & level, DeltaAction action) {
+        auto bid = direction == OrderDirection_t::BUY;
+        const auto & current = quotes_->Current(instrument);
+        auto levels = bid ? current.BidLevels_ : current.AskLevels_;
+        const auto * quotes = bid ? current.Bids_ : current.Asks_;
+
+        // Levels below a full snapshot don't change it
+        if (levels == TopOfBook::DEPTH && (bid ? price < quotes[levels - 1].Price_ : price > quotes[levels - 1].Price_)) {
+            return;
+        }
+        if (quoted_ == NO_INSTRUMENT) {
+            quoted_ = instrument;
+            quote_ = &quotes_->Begin(instrument);
+        }
+
+        // A level that only changed its volume is patched where it is, anything else rebuilds the side
+        if (action == DeltaAction::UPDATE) {
+            for (uint32_t index = 0; index < levels; ++index) {
+                if (quotes[index].Price_ == price) {
+                    (bid ? quote_->Bids_ : quote_->Asks_)[index] = Quote{price, level.volume_, level.count_};
+                    return;
+                }
+            }
+        }
+        (bid ? quoteBids_ : quoteAsks_) = true;
+    }
+
+    template<typename Layout>
+    void BasicImplementation<Layout>::PublishQuote() {
+        const auto & security = orderbook_[quoted_];
+        auto & top = *quote_;
+        auto copy = [] (Quote * quotes, uint32_t & levels) {
+            levels = 0;
+            return [quotes, &levels] (Tick price, const Level & level) {
+                quotes[levels++] = Quote{price, level.volume_, level.count_};
+            };
+        };
+        if (quoteBids_) {
+            security.bid_.ForTop(TopOfBook::DEPTH, copy(top.Bids_, top.BidLevels_));
+        }
+        if (quoteAsks_) {
+            security.ask_.ForTop(TopOfBook::DEPTH, copy(top.Asks_, top.AskLevels_));
+        }
+        quotes_->End(quoted_);
+        quoted_ = NO_INSTRUMENT;
+        quote_ = nullptr;
+        quoteBids_ = quoteAsks_ = false;
+    }
+
+    template<typename Layout>
+    void BasicImplementation<Layout>::PublishRefresh(InstrumentID instrument) {
+        if (deltas_ == nullptr) {
+            return;
+        }
+        deltas_->Publish(LevelDelta{0, 0, instrument, 0, DeltaSide::BID, DeltaAction::CLEAR, {}});
+        auto first = instrument == NO_INSTRUMENT ? 0 : instrument;
+        auto last = instrument == NO_INSTRUMENT ? orderbook_.size() : std::min<std::size_t>(instrument + 1, orderbook_.size());
+        for (auto id = first; id < last; ++id) {
+            auto publish = [this, id] (OrderDirection_t direction) {
+                return [this, id, direction] (Tick price, const Level & level) {
+                    Publish(id, direction, price, level, DeltaAction::INSERT);
+                };
+            };
+            orderbook_[id].bid_.ForEach(publish(OrderDirection_t::BUY));
+            orderbook_[id].ask_.ForEach(publish(OrderDirection_t::SELL));
+        }
+        deltas_->Flush();
+    }
+
+    template<typename Layout>
+    void BasicImplementation<Layout>::EnableMatching(Fill * fills, std::size_t capacity) {
+        fills_ = fills;
+        fillCapacity_ = fills != nullptr ? capacity : 0;
+        fillCount_ = 0;
+    }
+
+    template<typename Layout>
+    void BasicImplementation<Layout>::DisableMatching() {
+        EnableMatching(nullptr, 0);
+    }
+
+    template<typename Layout>
+    int BasicImplementation<Layout>::Process(const Order & order) {
+        OB_STATS_SAMPLE();
+        InstrumentID instrument{NO_INSTRUMENT};
+
+        // Only adds need the security, modifies and deletes find it from the order
+        if (order.OrderAction_ == OrderAction_t::Add) {
+            {
+                OB_STATS_TIMER(SECURITY);
+                instrument = Register(order.SecurityID_.data(), order.SecurityID_.size());
+            }
+            if (instrument == NO_INSTRUMENT) {
+                OB_STATS_REJECT(ERR_ORD_SECID);
+                LogSymbol(LogEvent::INVALID_SECURITY, order.SecurityID_.data(), order.SecurityID_.size(), order.OrderID_);
+                return ERR_ORD_SECID;
+            }
+        }
+
+        return Process(instrument, order);
+    }
+
+    template<typename Layout>
+    int BasicImplementation<Layout>::Process(InstrumentID instrument, const Order & order) {
+        return Process(Message{order.OrderID_, order.OrderAction_, order.OrderDirection_, order.OrderConstraints_, instrument, ToTick(order.Price_), order.Volume_});
+    }
+
+    template<typename Layout>
+    int BasicImplementation<Layout>::Process(const Message & order) {
+        OB_STATS_SAMPLE();
+        auto instrument = order.Instrument_;
+        if constexpr (Layout::VERIFY) {
+            if (order.OrderAction_ != OrderAction_t::Add) {
+                auto node = orders_.Find(order.OrderID_);
+                instrument = node != NIL ? pool_[node].instrument_ : NO_INSTRUMENT;
+            }
+        }
+        auto rc = Apply(order);
+        if (quoted_ != NO_INSTRUMENT) {
+            PublishQuote();
+        }
+        if (bboTouched_ != NO_INSTRUMENT) {
+            RefreshBbo();
+        }
+        if constexpr (Layout::VERIFY) {
+            Verify(instrument);
+        }
+        OB_STATS_REJECT(rc);
+        return rc;
+    }
+
+    template<typename Layout>
+    void BasicImplementation<Layout>::Verify(InstrumentID instrument) const {
+        if (instrument >= orderbook_.size()) {
+            return;
+        }
+        const auto & security = orderbook_[instrument];
+
+        // Every level holds the orders its count and volume say it does, each indexed and on the right
+        // level, and the levels come best first
+        auto check = [this, instrument] (OrderDirection_t direction) {
+            return [this, instrument, direction, first = true, last = Tick{0}] (Tick price, const Level & level) mutable {
+                assert((first || (direction == OrderDirection_t::BUY ? price < last : price > last)) && "Levels should be best first");
+                first = false;
+                last = price;
+
+                uint32_t count{0};
+                int64_t volume{0};
+                for (auto node = level.head_; node != NIL; node = pool_[node].next_) {
+                    const auto & order = pool_[node];
+                    assert(order.instrument_ == instrument && order.OrderDirection_ == direction && order.Price_ == price && "An order should rest on its own level");
+                    assert(orders_.Find(order.OrderID_) == node && "A resting order should be indexed");
+                    ++count;
+                    volume += order.Volume_;
+                }
+                assert(count != 0 && count == level.count_ && volume == level.volume_ && "A level should hold the orders it counts");
+            };
+        };
+        security.bid_.ForEach(check(OrderDirection_t::BUY));
+        security.ask_.ForEach(check(OrderDirection_t::SELL));
+
+        [[maybe_unused]] Tick bid, ask;
+        assert((fills_ == nullptr || security.bid_.At(0, bid) == nullptr || security.ask_.At(0, ask) == nullptr || bid < ask) && "A matching book should never be left crossed");
+    }
+
+    template<typename Layout>
+    std::size_t BasicImplementation<Layout>::ProcessBatch(const Message * orders, std::size_t count, int * results, bool coalesce) {
+        std::size_t rejected{0};
+        bool skip[BATCH_WINDOW];
+
+        for (std::size_t start = 0; start < count; start += BATCH_WINDOW) {
+            auto window = std::min(BATCH_WINDOW, count - start);
+            const auto * batch = orders + start;
+            Prefetch(batch, window);
+            std::fill(skip, skip + window, false);
+
+            for (std::size_t i = 0; i < window; ++i) {
+                if (skip[i]) {
+                    continue;
+                }
+                auto rc = SUCCESS;
+                auto cancel = coalesce ? Coalesce(batch, i, window) : window;
+                if (cancel != window) {
+                    // The add and its delete cancel out, the cancel's result is written now
+                    skip[cancel] = true;
+                    if (results != nullptr) {
+                        results[start + cancel] = SUCCESS;
+                    }
+                } else {
+                    rc = Process(batch[i]);
+                }
+                if (results != nullptr) {
+                    results[start + i] = rc;
+                }
+                rejected += rc != SUCCESS;
+            }
+        }
+        if (deltas_ != nullptr) {
+            deltas_->Flush();
+        }
+        return rejected;
+    }
+
+    template<typename Layout>
+    std::size_t BasicImplementation<Layout>::ProcessBatch(const Order * orders, std::size_t count, int * results, bool coalesce) {
+        Message messages[BATCH_WINDOW];
+        std::size_t positions[BATCH_WINDOW];
+        int codes[BATCH_WINDOW];
+        std::size_t rejected{0};
+
+        for (std::size_t start = 0; start < count; start += BATCH_WINDOW) {
+            auto window = std::min(BATCH_WINDOW, count - start);
 
-        auto entry = orderbook_.find(order.SecurityID_);
-        if (entry == orderbook_.end()) {
-            // Insert a new entry for this security and return iterator to it
-            auto ipair = orderbook_.emplace(std::make_pair(order.SecurityID_, Security{}));
-            entry = ipair.first;
-        }  
+            // Resolve the window's securities first, orders whose security can't be held are rejected
+            // here and the rest are applied as one batch
+            std::size_t valid{0};
+            for (std::size_t i = 0; i < window; ++i) {
+                const auto & order = orders[start + i];
+                InstrumentID instrument{NO_INSTRUMENT};
+                if (order.OrderAction_ == OrderAction_t::Add) {
+                    instrument = Register(order.SecurityID_.data(), order.SecurityID_.size());
+                    if (instrument == NO_INSTRUMENT) {
+                        OB_STATS_REJECT(ERR_ORD_SECID);
+                        LogSymbol(LogEvent::INVALID_SECURITY, order.SecurityID_.data(), order.SecurityID_.size(), order.OrderID_);
+                        if (results != nullptr) {
+                            results[start + i] = ERR_ORD_SECID;
+                        }
+                        ++rejected;
+                        continue;
+                    }
+                }
+                messages[valid] = Message{order.OrderID_, order.OrderAction_, order.OrderDirection_, order.OrderConstraints_, instrument, ToTick(order.Price_), order.Volume_};
+                positions[valid++] = start + i;
+            }
+
+            rejected += ProcessBatch(messages, valid, codes, coalesce);
+            if (results != nullptr) {
+                for (std::size_t i = 0; i < valid; ++i) {
+                    results[positions[i]] = codes[i];
+                }
+            }
+        }
+        return rejected;
+    }
+
+    template<typename Layout>
+    void BasicImplementation<Layout>::Prefetch(const Message * orders, std::size_t count) const {
+        uint32_t nodes[BATCH_WINDOW];
+
+        // Each pass needs the lines the one before pulled in to find its addresses. First the index slots,
+        // and the securities adds go to, which are known from the messages alone
+        for (std::size_t i = 0; i < count; ++i) {
+            const auto & order = orders[i];
+            orders_.Prefetch(order.OrderID_);
+            if (order.OrderAction_ == OrderAction_t::Add && order.Instrument_ < orderbook_.size()) {
+                const auto & security = orderbook_[order.Instrument_];
+                __builtin_prefetch(&security.bid_);
+                __builtin_prefetch(&security.ask_);
+            }
+        }
+
+        // Then the level an add goes to, and the resting order a modify or delete refers to
+        for (std::size_t i = 0; i < count; ++i) {
+            const auto & order = orders[i];
+            nodes[i] = NIL;
+            if (order.OrderAction_ == OrderAction_t::Add) {
+                if (order.Instrument_ < orderbook_.size()) {
+                    const auto & security = orderbook_[order.Instrument_];
+                    if (order.OrderDirection_ == OrderDirection_t::BUY) {
+                        security.bid_.Prefetch(order.Price_);
+                    } else {
+                        security.ask_.Prefetch(order.Price_);
+                    }
+                }
+            } else {
+                nodes[i] = orders_.Find(order.OrderID_);
+                if (nodes[i] != NIL) {
+                    __builtin_prefetch(&pool_[nodes[i]]);
+                }
+            }
+        }
+
+        // Then the level each resting order is on, and the level a modify moves it to
+        for (std::size_t i = 0; i < count; ++i) {
+            if (nodes[i] == NIL) {
+                continue;
+            }
+            const auto & resting = pool_[nodes[i]];
+            if (resting.instrument_ >= orderbook_.size()) {
+                continue;
+            }
+            const auto & security = orderbook_[resting.instrument_];
+            if (resting.OrderDirection_ == OrderDirection_t::BUY) {
+                security.bid_.Prefetch(resting.Price_);
+            } else {
+                security.ask_.Prefetch(resting.Price_);
+            }
+            const auto & order = orders[i];
+            if (order.OrderAction_ == OrderAction_t::Modify && order.Price_ != resting.Price_) {
+                if (order.OrderDirection_ == OrderDirection_t::BUY) {
+                    security.bid_.Prefetch(order.Price_);
+                } else {
+                    security.ask_.Prefetch(order.Price_);
+                }
+            }
+        }
+    }
+
+    template<typename Layout>
+    std::size_t BasicImplementation<Layout>::Coalesce(const Message * orders, std::size_t index, std::size_t count) const {
+        const auto & add = orders[index];
+
+        // Only an add that would have been accepted, the index is checked now so earlier messages in the
+        // window have already been applied, and never while fills could come of it
+        if (add.OrderAction_ != OrderAction_t::Add || fills_ != nullptr || add.Instrument_ >= orderbook_.size() ||
+            (add.OrderDirection_ != OrderDirection_t::BUY && add.OrderDirection_ != OrderDirection_t::SELL) ||
+            orders_.Find(add.OrderID_) != NIL) {
+            return count;
+        }
+
+        for (auto i = index + 1; i < count; ++i) {
+            if (orders[i].OrderID_ == add.OrderID_) {
+                return orders[i].OrderAction_ == OrderAction_t::Delete ? i : count;
+            }
+        }
+        return count;
+    }
+
+    template<typename Layout>
+    int BasicImplementation<Layout>::Apply(const Message & order) {
+        auto rc = SUCCESS;
 
         switch (order.OrderAction_) {
             case OrderAction_t::Add:
-                rc = Add(order, entry->second);
+                {
+                    OB_STATS_TIMER(ADD);
+                    if (order.Instrument_ >= orderbook_.size()) {
+                        Log(LogEvent::UNKNOWN_INSTRUMENT, order.OrderID_, order.Instrument_);
+                        return ERR_ORD_SECID;
+                    }
+                    rc = Add(order);
+                }
                 break;
             case OrderAction_t::Modify:
-                rc = Modify(order, entry->second);
+                {
+                    OB_STATS_TIMER(MODIFY);
+                    // Modifies and deletes are located by OrderID alone, the price on the message is not needed
+                    auto node = FindOrder(order.OrderID_);
+                    if (node == NIL) {
+                        Log(LogEvent::UNKNOWN_ORDER, order.OrderID_);
+                        return ERR_ORD_ORDERID;
+                    }
+                    rc = Modify(order, node);
+                    if (rc == ERR_ORD_PRICE) {
+                        // The order was cancelled but its replacement price was rejected
+                        orders_.Erase(order.OrderID_);
+                        pool_.Release(node);
+                    }
+                }
                 break;
             case OrderAction_t::Delete:
-                Delete(order, entry->second);
+                {
+                    OB_STATS_TIMER(DELETE);
+                    auto node = FindOrder(order.OrderID_);
+                    if (node == NIL) {
+                        Log(LogEvent::UNKNOWN_ORDER, order.OrderID_);
+                        return ERR_ORD_ORDERID;
+                    }
+                    rc = Delete(node);
+                    if (rc == SUCCESS) {
+                        orders_.Erase(order.OrderID_);
+                        pool_.Release(node);
+                    }
+                }
                 break;
             default:
                 rc = ERR_ORD_ACTION;
-                std::cerr<<"Unknown OrderAction "<<static_cast<std::underlying_type<OrderAction_t>::type>(order.OrderAction_)<<'\n'; 
+                LogValue(LogEvent::UNKNOWN_ACTION, static_cast<std::underlying_type<OrderAction_t>::type>(order.OrderAction_));
                 break;
         }
 
         return rc;
     }
 
-    bool Implementation::Exists(const std::string & security) const {
-        return orderbook_.find(security) != orderbook_.end();
+    template<typename Layout>
+    uint32_t BasicImplementation<Layout>::FindOrder(int_fast64_t id) const {
+        OB_STATS_TIMER(ORDER);
+        return orders_.Find(id);
+    }
+
+    template<typename Layout>
+    InstrumentID BasicImplementation<Layout>::Instrument(const std::string & security) const {
+        return symbols_.Find(security);
+    }
+
+    template<typename Layout>
+    const SymbolRegistry & BasicImplementation<Layout>::Symbols() const {
+        return symbols_;
+    }
+
+    template<typename Layout>
+    bool BasicImplementation<Layout>::Exists(const std::string & security) const {
+        return symbols_.Find(security) != NO_INSTRUMENT;
     }
 
-    size_t Implementation::BookDepth(const std::string & security, OrderDirection_t direction) const {
+    template<typename Layout>
+    size_t BasicImplementation<Layout>::BookDepth(const std::string & security, OrderDirection_t direction) const {
+        auto instrument = symbols_.Find(security);
+        if (instrument == NO_INSTRUMENT) {
+            LogSymbol(LogEvent::UNKNOWN_SECURITY, security.data(), security.size());
+            return 0;
+        }
+        return BookDepth(instrument, direction);
+    }
+
+    template<typename Layout>
+    size_t BasicImplementation<Layout>::BookDepth(InstrumentID instrument, OrderDirection_t direction) const {
         size_t depth{0};
        
-        auto entry = orderbook_.find(security);
-        if (entry == orderbook_.end()) {
-            std::cerr<<"Unknown security "<<security<<'\n';
+        if (instrument >= orderbook_.size()) {
+            Log(LogEvent::UNKNOWN_INSTRUMENT, 0, instrument);
         }  else {
             switch (direction) {
             case OrderDirection_t::BUY:
-                depth = entry->second.bid_.size();
+                depth = orderbook_[instrument].bid_.Size();
                 break;
             case OrderDirection_t::SELL:
-                depth = entry->second.ask_.size();
+                depth = orderbook_[instrument].ask_.Size();
                 break;
             default:
-                std::cerr<<"Unhandled OrderDirection "<<static_cast<std::underlying_type<OrderDirection_t>::type>(direction)<<'\n'; 
+                LogValue(LogEvent::UNKNOWN_DIRECTION, static_cast<std::underlying_type<OrderDirection_t>::type>(direction));
                 break;
             }
         }
@@ -67,50 +581,107 @@ namespace orderbook {
         return depth;
     }
     
-    std::pair<std::deque<Order>::const_iterator, std::deque<Order>::const_iterator> Implementation::Get(const std::string & security, OrderDirection_t direction, int index) const {
-        static std::deque<Order> nullLevel;
-        auto entry = orderbook_.find(security);
-        if (entry == orderbook_.end()) {
-            std::cerr<<"Unknown security "<<security<<'\n';
+    template<typename Layout>
+    std::pair<LevelIterator, LevelIterator> BasicImplementation<Layout>::Get(const std::string & security, OrderDirection_t direction, int index) const {
+        auto instrument = symbols_.Find(security);
+        if (instrument == NO_INSTRUMENT) {
+            LogSymbol(LogEvent::UNKNOWN_SECURITY, security.data(), security.size());
+            return std::make_pair(LevelIterator(&pool_, NIL), LevelIterator(&pool_, NIL));
+        }
+        return Get(instrument, direction, index);
+    }
+
+    template<typename Layout>
+    std::pair<LevelIterator, LevelIterator> BasicImplementation<Layout>::Get(InstrumentID instrument, OrderDirection_t direction, int index) const {
+        if (instrument >= orderbook_.size()) {
+            Log(LogEvent::UNKNOWN_INSTRUMENT, 0, instrument);
         }  else {
             switch (direction) {
             case OrderDirection_t::BUY:
                 {
-                    auto it = entry->second.bid_.begin();
-                    std::advance(it, index);
-                    return std::make_pair(it->second.begin(), it->second.end());
+                    Tick price;
+                    auto level = orderbook_[instrument].bid_.At(index, price);
+                    if (level != nullptr) {
+                        return std::make_pair(LevelIterator(&pool_, level->head_), LevelIterator(&pool_, NIL));
+                    }
                 }
                 break;
             case OrderDirection_t::SELL:
                 {
-                    auto it = entry->second.ask_.begin();
-                    std::advance(it, index);
-                    return std::make_pair(it->second.begin(), it->second.end());
+                    Tick price;
+                    auto level = orderbook_[instrument].ask_.At(index, price);
+                    if (level != nullptr) {
+                        return std::make_pair(LevelIterator(&pool_, level->head_), LevelIterator(&pool_, NIL));
+                    }
                 }
                 break;
             default:
-                std::cerr<<"Unhandled OrderDirection "<<static_cast<std::underlying_type<OrderDirection_t>::type>(direction)<<'\n';
+                LogValue(LogEvent::UNKNOWN_DIRECTION, static_cast<std::underlying_type<OrderDirection_t>::type>(direction));
                 break;
             }
         }
-        return std::make_pair(nullLevel.begin(), nullLevel.end());
+        return std::make_pair(LevelIterator(&pool_, NIL), LevelIterator(&pool_, NIL));
     }
 
-    std::pair<std::deque<Order>::const_iterator, std::deque<Order>::const_iterator> Implementation::Top(const std::string & security, OrderDirection_t direction) const {
+    template<typename Layout>
+    std::pair<LevelIterator, LevelIterator> BasicImplementation<Layout>::Top(const std::string & security, OrderDirection_t direction) const {
         return Get(security, direction, 0);
     }
 
-    int Implementation::PrintBook(const std::string & security) const {
+    template<typename Layout>
+    std::pair<LevelIterator, LevelIterator> BasicImplementation<Layout>::Top(InstrumentID instrument, OrderDirection_t direction) const {
+        return Get(instrument, direction, 0);
+    }
+
+    template<typename Layout>
+    bool BasicImplementation<Layout>::LevelAt(InstrumentID instrument, OrderDirection_t direction, std::size_t index, Quote & level) const {
+        bool found{false};
+        WithSide(instrument, direction, [index, &level, &found] (const auto & levels) {
+            Tick price;
+            const auto * at = levels.At(index, price);
+            if (at != nullptr) {
+                level = Quote{price, at->volume_, at->count_};
+                found = true;
+            }
+        });
+        return found;
+    }
+
+    template<typename Layout>
+    std::size_t BasicImplementation<Layout>::TopLevels(InstrumentID instrument, OrderDirection_t direction, Quote * levels, std::size_t count) const {
+        std::size_t copied{0};
+        WithSide(instrument, direction, [levels, count, &copied] (const auto & side) {
+            side.ForTop(count, [levels, &copied] (Tick price, const Level & level) {
+                levels[copied++] = Quote{price, level.volume_, level.count_};
+            });
+        });
+        return copied;
+    }
+
+    template<typename Layout>
+    int64_t BasicImplementation<Layout>::VolumeWithin(InstrumentID instrument, OrderDirection_t direction, Tick distance) const {
+        int64_t volume{0};
+        WithSide(instrument, direction, [distance, &volume] (const auto & side) {
+            side.ForWithin(distance, [&volume] (Tick, const Level & level) {
+                volume += level.volume_;
+            });
+        });
+        return volume;
+    }
+
+    template<typename Layout>
+    int BasicImplementation<Layout>::PrintBook(const std::string & security) const {
         static const std::string startred{"\033[1;31m"};
         static const std::string endred{"\033[0m"};
         static const std::string startgreen{"\u001b[32m"};
         static const std::string endgreen{"\033[0m"};
 
-        auto entry = orderbook_.find(security);
-        if (entry == orderbook_.end()) {
+        auto instrument = symbols_.Find(security);
+        if (instrument == NO_INSTRUMENT) {
             std::cerr<<"Unknown security "<<security<<'\n';
             return ERR_ORD_SECID;
         } 
+        const auto & entry = orderbook_[instrument];
 
         std::cout << "Security: " << security << '\n';
         std::cout << std::left << std::setw(19) << std::setfill(' ') << "Bid volume";
@@ -122,23 +693,28 @@ namespace orderbook {
         std::cout << std::left << std::setw(19) << std::setfill(' ') << "Ask price" << '\n';
         std::cout << std::setw(80) << std::setfill('-') << '-' << '\n';
 
-        auto bidit = entry->second.bid_.begin();
-        auto askit = entry->second.ask_.begin();
+        // Each level with its volume
+        std::vector<std::pair<Tick, int_fast64_t>> bids;
+        std::vector<std::pair<Tick, int_fast64_t>> asks;
+        auto sum = [] (std::vector<std::pair<Tick, int_fast64_t>> & volumes) {
+            return [&volumes] (Tick price, const Level & orders) {
+                volumes.emplace_back(price, orders.volume_);
+            };
+        };
+        entry.bid_.ForEach(sum(bids));
+        entry.ask_.ForEach(sum(asks));
 
-        while(bidit != entry->second.bid_.end() || askit != entry->second.ask_.end()) {
-            // Sum each level
-            if(bidit != entry->second.bid_.end()) {
-                int_fast64_t volume{0};
-                auto & orders = bidit->second;
-                for (const auto & order : orders) {
-                    volume += order.Volume_;
-                }
+        auto bidit = bids.begin();
+        auto askit = asks.begin();
+
+        while(bidit != bids.end() || askit != asks.end()) {
+            if(bidit != bids.end()) {
                 std::cout << startgreen;
-                std::cout << std::left << std::setw(19) << std::setfill(' ') << volume;
+                std::cout << std::left << std::setw(19) << std::setfill(' ') << bidit->second;
                 std::cout << endgreen;
                 std::cout << '|';
                 std::cout << startgreen;
-                std::cout << std::left << std::setw(19) << std::setfill(' ') << bidit->first;
+                std::cout << std::left << std::setw(19) << std::setfill(' ') << ToPrice(bidit->first);
                 std::cout << endgreen;
                 ++bidit;
             } else {
@@ -151,18 +727,13 @@ namespace orderbook {
                 std::cout << endgreen;
             }
             std::cout << '|';
-            if(askit != entry->second.ask_.end()) {
-                int_fast64_t volume{0};
-                auto & orders = askit->second;
-                for (const auto & order : orders) {
-                    volume += order.Volume_;
-                }
+            if(askit != asks.end()) {
                 std::cout << startred;
-                std::cout << std::left << std::setw(19) << std::setfill(' ') << volume;
+                std::cout << std::left << std::setw(19) << std::setfill(' ') << askit->second;
                 std::cout << endred;
                 std::cout << '|';
                 std::cout << startred;
-                std::cout << std::left << std::setw(19) << std::setfill(' ') << askit->first;
+                std::cout << std::left << std::setw(19) << std::setfill(' ') << ToPrice(askit->first);
                 std::cout << endred;
                 ++askit;
             } else {
@@ -176,63 +747,148 @@ namespace orderbook {
             }
             std::cout<<std::endl;
         }
+
+        return SUCCESS;
     }
 
-    int Implementation::Add(const Order & order, Security & security) {
+    template<typename Layout>
+    int BasicImplementation<Layout>::Add(const Message & order) {
         int rc = SUCCESS;
 
+        auto node = pool_.Allocate();
+        if (!orders_.Insert(order.OrderID_, node)) {
+            pool_.Release(node);
+            Log(LogEvent::DUPLICATE_ORDER, order.OrderID_, order.Instrument_);
+            return ERR_ORD_ORDERID;
+        }
+
+        auto & resting = pool_[node];
+        resting.OrderID_ = order.OrderID_;
+        resting.Volume_ = order.Volume_;
+        resting.Price_ = order.Price_;
+        resting.instrument_ = order.Instrument_;
+        resting.OrderDirection_ = order.OrderDirection_;
+        resting.OrderConstraints_ = order.OrderConstraints_;
+
+        if (fills_ != nullptr) {
+            // Whatever crosses trades first, only a LIMIT remainder goes on to rest
+            rc = Match(node);
+            if (rc != SUCCESS || resting.Volume_ == 0 || resting.OrderConstraints_ == OrderConstraints_t::MARKET) {
+                orders_.Erase(order.OrderID_);
+                pool_.Release(node);
+                return rc;
+            }
+        }
+
+        auto & security = orderbook_[order.Instrument_];
+
         switch (order.OrderDirection_) {
             case OrderDirection_t::BUY:
-                AddToBook(order, security.bid_);
+                rc = AddToBook(node, security.bid_);
                 break;
             case OrderDirection_t::SELL:
-                AddToBook(order, security.ask_);
+                rc = AddToBook(node, security.ask_);
                 break;
             default:
                 rc = ERR_ORD_DIR;
-                std::cerr<<"Unhandled OrderDirection "<<static_cast<std::underlying_type<OrderDirection_t>::type>(order.OrderDirection_)<<'\n'; 
+                LogValue(LogEvent::UNKNOWN_DIRECTION, static_cast<std::underlying_type<OrderDirection_t>::type>(order.OrderDirection_));
                 break;
         }
 
+        if (rc != SUCCESS) {
+            orders_.Erase(order.OrderID_);
+            pool_.Release(node);
+        }
+
         return rc;      
     }
 
-    int Implementation::Modify(const Order & order, Security & security) {
+    template<typename Layout>
+    int BasicImplementation<Layout>::Modify(const Message & order, uint32_t node) {
         int rc = SUCCESS;
+        auto & resting = pool_[node];
+        auto price = order.Price_;
+
+        if (order.OrderDirection_ == resting.OrderDirection_ && price == resting.Price_) {
+            // Same price level, amend in place and keep queue priority
+            if (resting.OrderDirection_ == OrderDirection_t::BUY) {
+                AmendInBook(node, order.Volume_, orderbook_[resting.instrument_].bid_);
+            } else {
+                AmendInBook(node, order.Volume_, orderbook_[resting.instrument_].ask_);
+            }
+            resting.OrderConstraints_ = order.OrderConstraints_;
+            return rc;
+        }
 
+        // A new price or side is a cancel/replace, the order goes to the back of its new level
         switch (order.OrderDirection_) {
             case OrderDirection_t::BUY:
-                rc = ModifyBook(order, security.bid_);
-                break;
             case OrderDirection_t::SELL:
-                rc = ModifyBook(order, security.ask_);
+                Delete(node);
+                resting.OrderDirection_ = order.OrderDirection_;
+                resting.OrderConstraints_ = order.OrderConstraints_;
+                resting.Price_ = price;
+                resting.Volume_ = order.Volume_;
+                if (fills_ != nullptr) {
+                    // The replacement can cross the other side, just as a new order could
+                    rc = Match(node);
+                    if (rc != SUCCESS || resting.Volume_ == 0 || resting.OrderConstraints_ == OrderConstraints_t::MARKET) {
+                        orders_.Erase(resting.OrderID_);
+                        pool_.Release(node);
+                        return rc;
+                    }
+                }
+                rc = (order.OrderDirection_ == OrderDirection_t::BUY) ? AddToBook(node, orderbook_[resting.instrument_].bid_) : AddToBook(node, orderbook_[resting.instrument_].ask_);
                 break;
             default:
                 rc = ERR_ORD_DIR;
-                std::cerr<<"Unhandled OrderDirection "<<static_cast<std::underlying_type<OrderDirection_t>::type>(order.OrderDirection_)<<'\n'; 
+                LogValue(LogEvent::UNKNOWN_DIRECTION, static_cast<std::underlying_type<OrderDirection_t>::type>(order.OrderDirection_));
                 break;
         }
 
         return rc;      
     }
 
-    int Implementation::Delete(const Order & order, Security & security) {
+    template<typename Layout>
+    int BasicImplementation<Layout>::Delete(uint32_t node) {
         int rc = SUCCESS;
+        auto & resting = pool_[node];
 
-        switch (order.OrderDirection_) {
+        switch (resting.OrderDirection_) {
             case OrderDirection_t::BUY:
-                rc = DeleteFromBook(order, security.bid_);
+                DeleteFromBook(node, orderbook_[resting.instrument_].bid_);
                 break;
             case OrderDirection_t::SELL:
-                rc = DeleteFromBook(order, security.ask_);
+                DeleteFromBook(node, orderbook_[resting.instrument_].ask_);
                 break;
             default:
                 rc = ERR_ORD_DIR;
-                std::cerr<<"Unhandled OrderDirection "<<static_cast<std::underlying_type<OrderDirection_t>::type>(order.OrderDirection_)<<'\n'; 
+                LogValue(LogEvent::UNKNOWN_DIRECTION, static_cast<std::underlying_type<OrderDirection_t>::type>(resting.OrderDirection_));
                 break;
         }
 
         return rc;      
     }
 
+    template<typename Layout>
+    int BasicImplementation<Layout>::Match(uint32_t node) {
+        auto & taker = pool_[node];
+        auto & security = orderbook_[taker.instrument_];
+
+        switch (taker.OrderDirection_) {
+            case OrderDirection_t::BUY:
+                return Sweep(taker, security.ask_);
+            case OrderDirection_t::SELL:
+                return Sweep(taker, security.bid_);
+            default:
+                LogValue(LogEvent::UNKNOWN_DIRECTION, static_cast<std::underlying_type<OrderDirection_t>::type>(taker.OrderDirection_));
+                return ERR_ORD_DIR;
+        }
+    }
+
+    template class BasicImplementation<StandardLayout>;
+    template class BasicImplementation<DebugLayout>;
+    template class BasicImplementation<LowLatencyLayout>;
+    template class BasicImplementation<LowMemoryLayout>;
+
 } // namespace orderbook
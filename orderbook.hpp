@@ -1,9 +1,21 @@
 #pragma once
 
-#include <deque>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
-#include <map>
-#include <unordered_map>
+#include <vector>
+
+#include "bbo.hpp"
+#include "deltas.hpp"
+#include "depth.hpp"
+#include "levels.hpp"
+#include "logger.hpp"
+#include "orderindex.hpp"
+#include "pool.hpp"
+#include "price.hpp"
+#include "quotes.hpp"
+#include "stats.hpp"
+#include "symbols.hpp"
 
 namespace orderbook {
 
@@ -13,16 +25,19 @@ namespace orderbook {
     static constexpr int ERR_ORD_SECID     = 3; 
     static constexpr int ERR_ORD_PRICE     = 4; 
     static constexpr int ERR_ORD_ORDERID   = 5; 
+    static constexpr int ERR_IO            = 6; 
+    static constexpr int ERR_ORD_FILLS     = 7; 
+    static constexpr int ERR_NOT_RUNNING   = 8; 
 
     enum class OrderAction_t {
         Add, Modify, Delete  
     };
 
-    enum class OrderDirection_t {
+    enum class OrderDirection_t : uint8_t {
         BUY, SELL
     };
 
-    enum class OrderConstraints_t {
+    enum class OrderConstraints_t : uint8_t {
         LIMIT, MARKET  
     };
 
@@ -36,96 +51,459 @@ namespace orderbook {
         int_fast64_t Volume_;
     };
 
-    using BidLevels = std::map<float, std::deque<Order>, std::greater<float>>;
-    using AskLevels = std::map<float, std::deque<Order>, std::less<float>>;
+    // The fixed size form of an Order that the book applies, with the security resolved to an InstrumentID
+    // and the price in ticks, so that binary and text feeds can be applied without building a std::string
+    struct Message {
+        int_fast64_t OrderID_;
+        OrderAction_t OrderAction_;
+        OrderDirection_t OrderDirection_;
+        OrderConstraints_t OrderConstraints_;
+        InstrumentID Instrument_;
+        Tick Price_;
+        int_fast64_t Volume_;
+    };
+
+    // An order as it rests in the book. The security id and action on the incoming message aren't
+    // needed once the order rests, so the node is small and fixed size and can be pooled. It stays one
+    // 40 byte node rather than being split into hot and cold halves, as every path that touches an order
+    // reads both its queue links and the instrument, side and price that find its level.
+    struct RestingOrder {
+        int_fast64_t OrderID_;
+        int_fast64_t Volume_;
+        Tick Price_;
+        InstrumentID instrument_;
+        OrderDirection_t OrderDirection_;
+        OrderConstraints_t OrderConstraints_;
+        uint32_t prev_;
+        uint32_t next_;
+    };
+
+    // A trade between an incoming order and one resting on the other side, at the resting order's price
+    struct Fill {
+        int_fast64_t TakerID_;
+        int_fast64_t MakerID_;
+        InstrumentID Instrument_;
+        OrderDirection_t TakerDirection_;
+        Tick Price_;
+        int_fast64_t Volume_;
+        int_fast64_t MakerRemaining_;   // What is left of the resting order, 0 if it was filled and removed
+    };
+
+    using OrderPool = Pool<RestingOrder>;
+    using LevelIterator = PoolIterator<RestingOrder>;
+
+    static_assert(sizeof(RestingOrder) == 40, "RestingOrder is sized for the pool");
+
+    // A layout picks the structures a book is built from, so that each can be chosen by measuring it
+    // rather than by keeping a fork of the book. Levels<Side> holds one side of a security, and with
+    // VERIFY every message is followed by a check of the levels and orders of the security it touched.
+    // The ladder behind inline levels is the default, define ORDERBOOK_MAP_LEVELS to keep each side in
+    // a std::map instead, or ORDERBOOK_LAYOUT to build the whole program on another layout.
+    struct StandardLayout {
+        static constexpr const char * NAME = "standard";
+        static constexpr bool VERIFY = false;
+#ifdef ORDERBOOK_MAP_LEVELS
+        template<typename Side> using Levels = MapLevels<Side, Level>;
+#else
+        template<typename Side> using Levels = InlineLevels<Side, Level, PriceLadder<Side, Level>>;
+#endif
+    };
+
+    // Trees are easy to follow in a debugger, and every message is checked
+    struct DebugLayout {
+        static constexpr const char * NAME = "debug";
+        static constexpr bool VERIFY = true;
+        template<typename Side> using Levels = MapLevels<Side, Level>;
+    };
 
-    struct Security {
-        BidLevels bid_;
-        AskLevels ask_;
+    // The ladder on its own, with no inline levels to check first, for a few busy securities
+    struct LowLatencyLayout {
+        static constexpr const char * NAME = "lowlatency";
+        static constexpr bool VERIFY = false;
+        template<typename Side> using Levels = PriceLadder<Side, Level>;
     };
 
-    using Book = std::unordered_map<std::string, Security>;
+    // Inline levels that spill into a tree node per level rather than a ladder sized for the book's span
+    struct LowMemoryLayout {
+        static constexpr const char * NAME = "lowmemory";
+        static constexpr bool VERIFY = false;
+        template<typename Side> using Levels = InlineLevels<Side, Level, MapLevels<Side, Level>>;
+    };
+
+#ifndef ORDERBOOK_LAYOUT
+#define ORDERBOOK_LAYOUT StandardLayout
+#endif
+
+    template<typename Layout>
+    struct BasicSecurity {
+        typename Layout::template Levels<BidSide> bid_;
+        typename Layout::template Levels<AskSide> ask_;
+    };
+
+    // What the book holds in memory, by what it is held for. Capacity that has been reserved counts
+    // whether or not it is in use, since that is what the process is paying for.
+    struct MemoryUsage {
+        std::size_t securities_{0};
+        std::size_t orders_{0};
+        std::size_t securityBytes_{0};  // The security table
+        std::size_t levelBytes_{0};     // Levels held outside the security table
+        std::size_t orderBytes_{0};     // The order pool and the index from OrderID to node
+        std::size_t symbolBytes_{0};
+
+        std::size_t Total() const { return securityBytes_ + levelBytes_ + orderBytes_ + symbolBytes_; }
+        double PerSecurity() const { return securities_ ? static_cast<double>(securityBytes_ + levelBytes_ + symbolBytes_) / static_cast<double>(securities_) : 0.0; }
+        double PerOrder() const { return orders_ ? static_cast<double>(orderBytes_) / static_cast<double>(orders_) : 0.0; }
+    };
     
-    class Implementation {
+    // The book, built on the structures its Layout picks. The presets above are compiled in
+    // orderbook.cpp, and the rest of the program uses Implementation, the one ORDERBOOK_LAYOUT names.
+    template<typename Layout>
+    class BasicImplementation {
         public:
+            // Securities are held densely, indexed by the InstrumentID their symbol was interned to
+            using Security = BasicSecurity<Layout>;
+            using Book = std::vector<Security>;
+
             void Reserve(std::size_t size);
+            void ReserveOrders(std::size_t size);
+            int LoadSecurities(const std::string & path);
+            InstrumentID Register(const char * security, std::size_t length);
+            void Reset();
             int Process(const Order & order);
+            int Process(InstrumentID instrument, const Order & order);
+            int Process(const Message & order);
+
+            // Applies a packet of messages in order, writing each one's return code to results if it isn't
+            // null, and returns how many were rejected. Messages are taken BATCH_WINDOW at a time, and the
+            // securities, index slots, resting orders and levels a window will touch are prefetched before
+            // any of it is applied, so its cache misses overlap rather than being paid one message after
+            // another. With coalesce, an add that is deleted again later in the same window, with nothing
+            // else done to the order in between, never touches the book and both report SUCCESS. That is
+            // only observable if the add's price was one the book couldn't have held, and is never done
+            // while matching.
+            static constexpr std::size_t BATCH_WINDOW = 16;
+            std::size_t ProcessBatch(const Message * orders, std::size_t count, int * results, bool coalesce = false);
+            std::size_t ProcessBatch(const Order * orders, std::size_t count, int * results, bool coalesce = false);
+            InstrumentID Instrument(const std::string & security) const;
+            const SymbolRegistry & Symbols() const;
             bool Exists(const std::string & security) const;
             size_t BookDepth(const std::string & security, OrderDirection_t direction) const;
-            std::pair<std::deque<Order>::const_iterator, std::deque<Order>::const_iterator> Get(const std::string & security, OrderDirection_t direction, int index) const;
-            std::pair<std::deque<Order>::const_iterator, std::deque<Order>::const_iterator> Top(const std::string & security, OrderDirection_t direction) const;
+            size_t BookDepth(InstrumentID instrument, OrderDirection_t direction) const;
+            std::pair<LevelIterator, LevelIterator> Get(const std::string & security, OrderDirection_t direction, int index) const;
+            std::pair<LevelIterator, LevelIterator> Get(InstrumentID instrument, OrderDirection_t direction, int index) const;
+            std::pair<LevelIterator, LevelIterator> Top(const std::string & security, OrderDirection_t direction) const;
+            std::pair<LevelIterator, LevelIterator> Top(InstrumentID instrument, OrderDirection_t direction) const;
             int PrintBook(const std::string & security) const;
 
+            // Aggregated levels, from the volume and order count each level keeps as orders come and go
+            // rather than by walking its orders. LevelAt is the level index places from the top of the
+            // book, false if there is no such level.
+            bool LevelAt(InstrumentID instrument, OrderDirection_t direction, std::size_t index, Quote & level) const;
+            // Up to count of the best levels into the caller's buffer, returning how many there were
+            std::size_t TopLevels(InstrumentID instrument, OrderDirection_t direction, Quote * levels, std::size_t count) const;
+            // The total volume resting at most distance ticks from the best price
+            int64_t VolumeWithin(InstrumentID instrument, OrderDirection_t direction, Tick distance) const;
+
+            // Visits every resting order, security by security, bids then asks, best level first and in
+            // queue order within a level, so adding them again in this order rebuilds the same book
+            template<typename F>
+            void ForEachOrder(F && f) const;
+            std::size_t Orders() const { return orders_.Size(); }
+            // Walks every security to add up the levels they hold, so it isn't for the hot path
+            MemoryUsage Memory() const;
+
+            // With matching enabled, incoming orders that cross the other side trade against it in price
+            // then time priority, writing a Fill per resting order hit into the caller's buffer. LIMIT
+            // remainders rest, MARKET remainders are cancelled. The buffer is never grown: if it fills up
+            // mid sweep the sweep stops, the rest of the incoming order is cancelled and ERR_ORD_FILLS is
+            // returned. Fills accumulate across messages until ClearFills.
+            void EnableMatching(Fill * fills, std::size_t capacity);
+            void DisableMatching();
+            std::size_t FillCount() const { return fillCount_; }
+            void ClearFills() { fillCount_ = 0; }
+
+            // Publishes a LevelDelta for every price level a message changes, with the level's volume and
+            // order count after it, a sweep publishing once for each level it trades through. A batch
+            // flushes the publisher's conflated deltas once it is applied. nullptr stops publishing.
+            void PublishDeltas(DeltaPublisher * publisher) { deltas_ = publisher; }
+            // A CLEAR then an INSERT for every level of the instrument, or every instrument, so that
+            // readers joining late or after a GAP can rebuild their view
+            void PublishRefresh(InstrumentID instrument = NO_INSTRUMENT);
+
+            // Keeps each security's best TopOfBook::DEPTH levels a side published on the board, for other
+            // threads to read while the book is processing. A snapshot is only rewritten after a message
+            // that changed a level in it or about to enter it. nullptr stops publishing.
+            void PublishQuotes(QuoteBoard * board);
+
+            // Keeps every level's price and volume in the depth book's arrays for the vectorised depth
+            // queries, loading the levels already resting when it is set. nullptr stops keeping it.
+            void PublishDepth(DepthBook * depth);
+
+            // Keeps each security's best bid and offer in the table, for whole market scans. It is rewritten
+            // once a message is applied, if the message changed a level at or above the best.
+            // nullptr stops keeping it.
+            void PublishBbo(BboTable * table);
+
+            // Keeps a fingerprint of every resting order, its security, side, price, id and volume, updated
+            // by each change to the book rather than recomputed, so two books that should hold the same
+            // orders can be compared with one word. Each order adds its own term, so the fingerprint doesn't
+            // depend on queue order or on which InstrumentID a security was given, and books holding
+            // disjoint sets of securities sum to the fingerprint of one holding them all. Turning it on
+            // computes it for the orders already resting.
+            void KeepFingerprint(bool keep);
+            uint64_t Fingerprint() const { return fingerprint_; }
+            // The same fingerprint from a walk over every resting order
+            uint64_t ComputeFingerprint() const;
+
         private:    
-            int Add(const Order & order, Security & security);
-            int Modify(const Order & order, Security & security);
-            int Delete(const Order & order, Security & security);
+            int Apply(const Message & order);
+            void Prefetch(const Message * orders, std::size_t count) const;
+            std::size_t Coalesce(const Message * orders, std::size_t index, std::size_t count) const;
+            uint32_t FindOrder(int_fast64_t id) const;
+            int Add(const Message & order);
+            int Modify(const Message & order, uint32_t node);
+            int Delete(uint32_t node);
+            int Match(uint32_t node);
+
+            // Calls f with the instrument's levels on one side, logging an unknown instrument or direction
+            template<typename F>
+            void WithSide(InstrumentID instrument, OrderDirection_t direction, F && f) const;
+            void Requote(InstrumentID instrument, OrderDirection_t direction, Tick price, const Level & level, DeltaAction action);
+            void PublishQuote();
+            void RefreshBbo();
+            void Verify(InstrumentID instrument) const;
 
+            // One resting order's term in the fingerprint, from its symbol rather than its InstrumentID
+            uint64_t Print(const RestingOrder & order) const {
+                auto mix = [] (uint64_t hash) {
+                    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+                    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+                    return hash ^ (hash >> 31);
+                };
+                uint64_t symbol[2];
+                std::memcpy(symbol, symbols_.Data(order.instrument_), sizeof(symbol));
+                auto hash = mix(symbol[0] ^ (symbol[1] * 0xC2B2AE3D27D4EB4Full) ^ static_cast<uint64_t>(order.OrderID_));
+                return mix(hash ^ (static_cast<uint64_t>(order.Price_) * 0x9E3779B97F4A7C15ull) ^ (static_cast<uint64_t>(order.Volume_) << 1) ^
+                           static_cast<uint64_t>(order.OrderDirection_ == OrderDirection_t::SELL));
+            }
+
+            // Called as an order joins the book, or leaves it, with the volume it rests with
+            void Rest(const RestingOrder & order, bool resting) {
+                if (fingerprinting_) {
+                    fingerprint_ += resting ? Print(order) : -Print(order);
+                }
+            }
+
+            void Publish(InstrumentID instrument, OrderDirection_t direction, Tick price, const Level & level, DeltaAction action) {
+                auto side = direction == OrderDirection_t::BUY ? DeltaSide::BID : DeltaSide::ASK;
+                if (deltas_ != nullptr) {
+                    deltas_->Publish(LevelDelta{price, level.volume_, instrument, level.count_, side, action, {}});
+                }
+                if (depth_ != nullptr) {
+                    depth_->Apply(instrument, side, price, level.volume_, action);
+                }
+                if (bbo_ != nullptr && instrument < bbo_->Capacity()) {
+                    // A level behind the best leaves it as it was
+                    auto best = bbo_->Get(instrument);
+                    if (side == DeltaSide::BID ? price >= best.BidPrice_ : price <= best.AskPrice_) {
+                        bboTouched_ = instrument;
+                    }
+                }
+                if (quotes_ != nullptr && instrument < quotes_->Capacity()) {
+                    Requote(instrument, direction, price, level, action);
+                }
+            }
+
+            template<typename T>
+            int AddToBook(uint32_t node, T & levels);
             template<typename T>
-            int AddToBook(const Order & order, T & levels);
+            void DeleteFromBook(uint32_t node, T & levels);
             template<typename T>
-            int ModifyBook(const Order & order, T & levels);
+            void AmendInBook(uint32_t node, int_fast64_t volume, T & levels);
             template<typename T>
-            int DeleteFromBook(const Order & order, T & levels);
+            int Sweep(RestingOrder & taker, T & levels);
             
+            SymbolRegistry symbols_;
             Book orderbook_;
+            OrderIndex orders_;
+            OrderPool pool_;
+            Fill * fills_{nullptr};
+            std::size_t fillCapacity_{0};
+            std::size_t fillCount_{0};
+            DeltaPublisher * deltas_{nullptr};
+            QuoteBoard * quotes_{nullptr};
+            DepthBook * depth_{nullptr};
+            BboTable * bbo_{nullptr};
+            InstrumentID bboTouched_{NO_INSTRUMENT};    // The security whose best bid or offer the message being applied may have moved
+            InstrumentID quoted_{NO_INSTRUMENT};    // The security whose snapshot the message being applied is rewriting
+            TopOfBook * quote_{nullptr};
+            bool quoteBids_{false};
+            bool quoteAsks_{false};
+            bool fingerprinting_{false};
+            uint64_t fingerprint_{0};
     };
 
-    // Assuming order ids are incrementing, we can do a binary search to find existing orders for modification or deletion
-    static auto ordercompare = [] (const orderbook::Order & lhs, const orderbook::Order & rhs) { return (lhs.OrderID_ < rhs.OrderID_); };
+    template<typename Layout>
+    template<typename T>
+    int BasicImplementation<Layout>::AddToBook(uint32_t node, T & levels) {
+        auto & order = pool_[node];
 
+        // Creates the price level if this is the first order at this price
+        Level * level;
+        {
+            OB_STATS_TIMER(LEVEL);
+            level = levels.Insert(order.Price_);
+        }
+        if (level == nullptr) {
+            Log(LogEvent::PRICE_RANGE, order.OrderID_, order.instrument_, order.Price_);
+            return ERR_ORD_PRICE;
+        }
+
+        {
+            OB_STATS_TIMER(QUEUE);
+            pool_.Append(*level, node);
+        }
+        level->volume_ += order.Volume_;
+        Rest(order, true);
+        Publish(order.instrument_, order.OrderDirection_, order.Price_, *level, level->count_ == 1 ? DeltaAction::INSERT : DeltaAction::UPDATE);
+        return SUCCESS;
+    }
+
+    template<typename Layout>
     template<typename T>
-    int Implementation::AddToBook(const Order & order, T & levels) {
-        auto pos = levels.find(order.Price_);
-
-        if( pos != levels.end() ) {
-            pos->second.emplace_back(std::move(order));;
-        } else {
-            levels[order.Price_] = std::deque<Order>{};
-            levels[order.Price_].emplace_back(std::move(order));
+    void BasicImplementation<Layout>::DeleteFromBook(uint32_t node, T & levels) {
+        const auto & order = pool_[node];
+        auto price = order.Price_;
+        Level * level;
+        {
+            OB_STATS_TIMER(LEVEL);
+            level = levels.Find(price);
+        }
+
+        {
+            OB_STATS_TIMER(QUEUE);
+            pool_.Remove(*level, node);
+        }
+        level->volume_ -= order.Volume_;
+        Rest(order, false);
+        Publish(order.instrument_, order.OrderDirection_, price, *level, level->empty() ? DeltaAction::REMOVE : DeltaAction::UPDATE);
+        if (level->empty()) {
+            OB_STATS_TIMER(LEVEL);
+            levels.Erase(price); // We can remove this price level
         }
-        return SUCCESS; 
     }
 
+    template<typename Layout>
     template<typename T>
-    int Implementation::ModifyBook(const Order & order, T & levels) {
-        auto pos = levels.find(order.Price_);
-
-        if( pos != levels.end() ) {
-            auto entry = std::lower_bound(pos->second.begin(), pos->second.end(), order, ordercompare);
-            if( entry != pos->second.end() && entry->OrderID_ == order.OrderID_) {
-                *entry = std::move(order); 
-            } else {
-                std::cerr<<"Could not find entry for Price ["<< order.SecurityID_<<"] Price: ["<<order.Price_<<"] OrderID ["<<order.OrderID_<<"]\n";
-                return ERR_ORD_ORDERID;
+    void BasicImplementation<Layout>::AmendInBook(uint32_t node, int_fast64_t volume, T & levels) {
+        auto & order = pool_[node];
+        Level * level;
+        {
+            OB_STATS_TIMER(LEVEL);
+            level = levels.Find(order.Price_);
+        }
+        level->volume_ += volume - order.Volume_;
+        Rest(order, false);
+        order.Volume_ = volume;
+        Rest(order, true);
+        Publish(order.instrument_, order.OrderDirection_, order.Price_, *level, DeltaAction::UPDATE);
+    }
+
+    template<typename Layout>
+    template<typename F>
+    void BasicImplementation<Layout>::WithSide(InstrumentID instrument, OrderDirection_t direction, F && f) const {
+        if (instrument >= orderbook_.size()) {
+            Log(LogEvent::UNKNOWN_INSTRUMENT, 0, instrument);
+            return;
+        }
+        switch (direction) {
+            case OrderDirection_t::BUY:
+                f(orderbook_[instrument].bid_);
+                break;
+            case OrderDirection_t::SELL:
+                f(orderbook_[instrument].ask_);
+                break;
+            default:
+                LogValue(LogEvent::UNKNOWN_DIRECTION, static_cast<std::underlying_type<OrderDirection_t>::type>(direction));
+                break;
+        }
+    }
+
+    template<typename Layout>
+    template<typename F>
+    void BasicImplementation<Layout>::ForEachOrder(F && f) const {
+        auto visit = [this, &f] (Tick, const Level & level) {
+            for (auto node = level.head_; node != NIL; node = pool_[node].next_) {
+                f(pool_[node]);
             }
-        } else {
-            std::cerr<<"Could not find entry for SecurityID ["<< order.SecurityID_<<"] Price: ["<<order.Price_<<"]\n";
-            return ERR_ORD_PRICE;
+        };
+        for (const auto & security : orderbook_) {
+            security.bid_.ForEach(visit);
+            security.ask_.ForEach(visit);
         }
-        return SUCCESS;
     }
 
+    template<typename Layout>
     template<typename T>
-    int Implementation::DeleteFromBook(const Order & order, T & levels) {
-        auto pos = levels.find(order.Price_);
-
-        if( pos != levels.end() ) {
-            auto entry = std::lower_bound(pos->second.begin(), pos->second.end(), order, ordercompare);
-            if( entry != pos->second.end() ) {
-                pos->second.erase(entry);
-                if (pos->second.empty()) {
-                    levels.erase(pos); // We can remove this price level
+    int BasicImplementation<Layout>::Sweep(RestingOrder & taker, T & levels) {
+        OB_STATS_TIMER(MATCH);
+        auto limit = taker.OrderConstraints_ == OrderConstraints_t::LIMIT;
+        auto buying = taker.OrderDirection_ == OrderDirection_t::BUY;
+        auto side = buying ? OrderDirection_t::SELL : OrderDirection_t::BUY;
+
+        Tick price;
+        Level * level;
+        while (taker.Volume_ > 0 && (level = levels.Best(price)) != nullptr) {
+            if (limit && (buying ? price > taker.Price_ : price < taker.Price_)) {
+                break;
+            }
+
+            // Oldest first within the level
+            auto maker = level->head_;
+            auto orders = level->count_;
+            while (maker != NIL && taker.Volume_ > 0) {
+                if (fillCount_ == fillCapacity_) {
+                    if (level->count_ != orders) {
+                        Publish(taker.instrument_, side, price, *level, DeltaAction::UPDATE);
+                    }
+                    Log(LogEvent::FILLS_FULL, taker.OrderID_, taker.instrument_, price);
+                    return ERR_ORD_FILLS;
                 }
-            } else {
-                std::cerr<<"Could not find entry for Price ["<< order.SecurityID_<<"] Price: ["<<order.Price_<<"] OrderID ["<<order.OrderID_<<'\n';
-                return ERR_ORD_ORDERID;
+
+                auto & resting = pool_[maker];
+                auto next = resting.next_;
+                auto volume = std::min(taker.Volume_, resting.Volume_);
+                taker.Volume_ -= volume;
+                Rest(resting, false);
+                resting.Volume_ -= volume;
+                level->volume_ -= volume;
+                fills_[fillCount_++] = Fill{taker.OrderID_, resting.OrderID_, taker.instrument_, taker.OrderDirection_, price, volume, resting.Volume_};
+
+                if (resting.Volume_ == 0) {
+                    pool_.Remove(*level, maker);
+                    orders_.Erase(resting.OrderID_);
+                    pool_.Release(maker);
+                } else {
+                    Rest(resting, true);
+                }
+                maker = next;
+            }
+
+            Publish(taker.instrument_, side, price, *level, level->empty() ? DeltaAction::REMOVE : DeltaAction::UPDATE);
+            if (level->empty()) {
+                levels.Erase(price);
             }
-        } else {
-            std::cerr<<"Could not find entry for SecurityID ["<< order.SecurityID_<<"] Price: ["<<order.Price_<<"]"<<'\n';
-            return ERR_ORD_PRICE;
         }
         return SUCCESS;
-    }                
+    }
+
+    extern template class BasicImplementation<StandardLayout>;
+    extern template class BasicImplementation<DebugLayout>;
+    extern template class BasicImplementation<LowLatencyLayout>;
+    extern template class BasicImplementation<LowMemoryLayout>;
+
+    using Implementation = BasicImplementation<ORDERBOOK_LAYOUT>;
+    using Security = Implementation::Security;
+    using Book = Implementation::Book;
 
 } // namespace orderbook
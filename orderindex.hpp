@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "pool.hpp"
+
+namespace orderbook {
+
+    // OrderID to pool node, as an open addressed table with linear probing. Entries live in one array,
+    // so a lookup is usually a single cache line, and inserts don't allocate until the table has to grow.
+    // Deletes shift the following entries back rather than leaving tombstones, so probe runs stay short
+    // under heavy cancel traffic.
+    class OrderIndex {
+        public:
+            void Reserve(std::size_t size) {
+                std::size_t capacity = 16;
+                while (capacity < size * 2) {
+                    capacity *= 2;
+                }
+                if (capacity > slots_.size()) {
+                    Rehash(capacity);
+                }
+            }
+
+            uint32_t Find(int_fast64_t id) const {
+                if (slots_.empty()) {
+                    return NIL;
+                }
+                for (auto pos = Home(id); ; pos = (pos + 1) & mask_) {
+                    const auto & slot = slots_[pos];
+                    if (slot.node_ == NIL) {
+                        return NIL;
+                    }
+                    if (slot.id_ == id) {
+                        return slot.node_;
+                    }
+                }
+            }
+
+            // Start pulling in the line a lookup of this id will probe first
+            void Prefetch(int_fast64_t id) const {
+                if (!slots_.empty()) {
+                    __builtin_prefetch(&slots_[Home(id)]);
+                }
+            }
+
+            // Returns false if the id is already present
+            bool Insert(int_fast64_t id, uint32_t node) {
+                if ((size_ + 1) * 2 > slots_.size()) {
+                    Rehash(slots_.empty() ? 1024 : slots_.size() * 2);
+                }
+                for (auto pos = Home(id); ; pos = (pos + 1) & mask_) {
+                    auto & slot = slots_[pos];
+                    if (slot.node_ == NIL) {
+                        slot.id_ = id;
+                        slot.node_ = node;
+                        ++size_;
+                        return true;
+                    }
+                    if (slot.id_ == id) {
+                        return false;
+                    }
+                }
+            }
+
+            void Erase(int_fast64_t id) {
+                if (slots_.empty()) {
+                    return;
+                }
+                auto pos = Home(id);
+                while (slots_[pos].node_ != NIL && slots_[pos].id_ != id) {
+                    pos = (pos + 1) & mask_;
+                }
+                if (slots_[pos].node_ == NIL) {
+                    return;
+                }
+
+                // Pull later entries of the probe run back into the hole
+                auto hole = pos;
+                for (pos = (pos + 1) & mask_; slots_[pos].node_ != NIL; pos = (pos + 1) & mask_) {
+                    auto home = Home(slots_[pos].id_);
+                    if (((pos - home) & mask_) >= ((pos - hole) & mask_)) {
+                        slots_[hole] = slots_[pos];
+                        hole = pos;
+                    }
+                }
+                slots_[hole].node_ = NIL;
+                --size_;
+            }
+
+            void Clear() {
+                for (auto & slot : slots_) {
+                    slot.node_ = NIL;
+                }
+                size_ = 0;
+            }
+
+            std::size_t Size() const { return size_; }
+            std::size_t Capacity() const { return slots_.size(); }
+            std::size_t Bytes() const { return slots_.capacity() * sizeof(Slot); }
+
+        private:
+            struct Slot {
+                int_fast64_t id_;
+                uint32_t node_{NIL};
+            };
+
+            std::size_t Home(int_fast64_t id) const {
+                // Fibonacci hashing spreads sequential order ids across the table
+                return static_cast<std::size_t>((static_cast<uint64_t>(id) * 0x9E3779B97F4A7C15ull) >> shift_);
+            }
+
+            void Rehash(std::size_t capacity) {
+                std::vector<Slot> slots(capacity);
+                slots_.swap(slots);
+                mask_ = capacity - 1;
+                shift_ = 64 - static_cast<unsigned>(__builtin_ctzll(capacity));
+                size_ = 0;
+                for (const auto & slot : slots) {
+                    if (slot.node_ != NIL) {
+                        Insert(slot.id_, slot.node_);
+                    }
+                }
+            }
+
+            std::vector<Slot> slots_;
+            std::size_t mask_{0};
+            unsigned shift_{64};
+            std::size_t size_{0};
+    };
+
+} // namespace orderbook
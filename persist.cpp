@@ -0,0 +1,406 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include "persist.hpp"
+
+namespace persist {
+
+    namespace {
+
+        // Buffers writes to a file descriptor without allocating
+        class Writer {
+            public:
+                explicit Writer(int fd) : fd_(fd) {}
+
+                bool Write(const void * data, std::size_t size) {
+                    const auto * bytes = static_cast<const char *>(data);
+                    while (size) {
+                        auto chunk = std::min(size, sizeof(buffer_) - used_);
+                        std::memcpy(buffer_ + used_, bytes, chunk);
+                        used_ += chunk;
+                        bytes += chunk;
+                        size -= chunk;
+                        if (used_ == sizeof(buffer_) && !Flush()) {
+                            return false;
+                        }
+                    }
+                    return true;
+                }
+
+                bool Flush() {
+                    if (!WriteAll(fd_, buffer_, used_)) {
+                        return false;
+                    }
+                    used_ = 0;
+                    return true;
+                }
+
+                static bool WriteAll(int fd, const char * data, std::size_t size) {
+                    while (size) {
+                        auto written = ::write(fd, data, size);
+                        if (written < 0) {
+                            if (errno == EINTR) {
+                                continue;
+                            }
+                            return false;
+                        }
+                        data += written;
+                        size -= static_cast<std::size_t>(written);
+                    }
+                    return true;
+                }
+
+            private:
+                int fd_;
+                std::size_t used_{0};
+                char buffer_[1 << 16];
+        };
+
+        bool WriteAt(int fd, const void * data, std::size_t size, off_t offset) {
+            const auto * bytes = static_cast<const char *>(data);
+            while (size) {
+                auto written = ::pwrite(fd, bytes, size, offset);
+                if (written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return false;
+                }
+                bytes += written;
+                size -= static_cast<std::size_t>(written);
+                offset += written;
+            }
+            return true;
+        }
+
+        int LoadSnapshot(const std::string & path, orderbook::Implementation & book, uint64_t & journalPosition, std::size_t & orders) {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                // No checkpoint has been taken yet, everything is in the journal
+                if (errno == ENOENT) {
+                    return orderbook::SUCCESS;
+                }
+                std::cerr<<"Could not open snapshot "<<path<<'\n';
+                return orderbook::ERR_IO;
+            }
+
+            struct stat info;
+            if (::fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(SnapshotHeader)) {
+                ::close(fd);
+                std::cerr<<"Snapshot "<<path<<" is too short\n";
+                return orderbook::ERR_IO;
+            }
+
+            auto size = static_cast<std::size_t>(info.st_size);
+            auto * data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+            ::close(fd);
+            if (data == MAP_FAILED) {
+                std::cerr<<"Could not map snapshot "<<path<<'\n';
+                return orderbook::ERR_IO;
+            }
+            ::madvise(data, size, MADV_SEQUENTIAL);
+
+            auto rc = orderbook::SUCCESS;
+            const auto & header = *static_cast<const SnapshotHeader *>(data);
+            const auto symbolLen = orderbook::SymbolRegistry::SYMBOL_LEN;
+            if (std::memcmp(header.magic_, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || header.version_ != SNAPSHOT_VERSION ||
+                header.orderSize_ != sizeof(SnapshotOrder) || header.ticksPerUnit_ != orderbook::TICKS_PER_UNIT) {
+                std::cerr<<"Snapshot "<<path<<" has an unsupported format\n";
+                rc = orderbook::ERR_IO;
+            } else if (header.symbols_ > size / symbolLen || header.orders_ > size / sizeof(SnapshotOrder) ||
+                       sizeof(SnapshotHeader) + header.symbols_ * symbolLen + header.orders_ * sizeof(SnapshotOrder) > size) {
+                std::cerr<<"Snapshot "<<path<<" is truncated\n";
+                rc = orderbook::ERR_IO;
+            } else {
+                const auto * symbols = static_cast<const char *>(data) + sizeof(SnapshotHeader);
+                book.Reserve(header.symbols_);
+                book.ReserveOrders(header.orders_ + header.orders_ / 4);
+                for (uint64_t i = 0; i < header.symbols_ && rc == orderbook::SUCCESS; ++i) {
+                    // Registering in order hands every symbol back the InstrumentID it had
+                    if (book.Register(symbols + i * symbolLen, symbolLen) != i) {
+                        std::cerr<<"Snapshot "<<path<<" has an invalid symbol at "<<i<<'\n';
+                        rc = orderbook::ERR_IO;
+                    }
+                }
+
+                const auto * records = reinterpret_cast<const SnapshotOrder *>(symbols + header.symbols_ * symbolLen);
+                for (uint64_t i = 0; i < header.orders_ && rc == orderbook::SUCCESS; ++i) {
+                    const auto & record = records[i];
+                    rc = book.Process(orderbook::Message{
+                        record.OrderID_,
+                        orderbook::OrderAction_t::Add,
+                        static_cast<orderbook::OrderDirection_t>(record.OrderDirection_),
+                        static_cast<orderbook::OrderConstraints_t>(record.OrderConstraints_),
+                        record.instrument_,
+                        record.Price_,
+                        record.Volume_
+                    });
+                }
+                journalPosition = header.journalPosition_;
+                orders = header.orders_;
+            }
+
+            ::munmap(data, size);
+            return rc;
+        }
+
+    } // namespace
+
+    int WriteSnapshot(const std::string & path, const orderbook::Implementation & book, uint64_t journalPosition) {
+        char temporary[4096];
+        if (path.size() + 5 > sizeof(temporary)) {
+            return orderbook::ERR_IO;
+        }
+        std::memcpy(temporary, path.data(), path.size());
+        std::memcpy(temporary + path.size(), ".tmp", 5);
+
+        int fd = ::open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return orderbook::ERR_IO;
+        }
+
+        const auto & symbols = book.Symbols();
+        SnapshotHeader header{};
+        std::memcpy(header.magic_, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+        header.version_ = SNAPSHOT_VERSION;
+        header.orderSize_ = sizeof(SnapshotOrder);
+        header.symbols_ = symbols.Size();
+        header.orders_ = book.Orders();
+        header.journalPosition_ = journalPosition;
+        header.ticksPerUnit_ = orderbook::TICKS_PER_UNIT;
+
+        Writer writer(fd);
+        auto ok = writer.Write(&header, sizeof(header));
+        for (orderbook::InstrumentID id = 0; ok && id < symbols.Size(); ++id) {
+            ok = writer.Write(symbols.Data(id), orderbook::SymbolRegistry::SYMBOL_LEN);
+        }
+        uint64_t written{0};
+        book.ForEachOrder([&writer, &ok, &written] (const orderbook::RestingOrder & order) {
+            SnapshotOrder record{};
+            record.OrderID_ = order.OrderID_;
+            record.Price_ = order.Price_;
+            record.Volume_ = order.Volume_;
+            record.instrument_ = order.instrument_;
+            record.OrderDirection_ = static_cast<uint8_t>(order.OrderDirection_);
+            record.OrderConstraints_ = static_cast<uint8_t>(order.OrderConstraints_);
+            ok = ok && writer.Write(&record, sizeof(record));
+            ++written;
+        });
+        ok = ok && writer.Flush() && written == header.orders_;
+        ok = ok && ::fsync(fd) == 0;
+        ok = (::close(fd) == 0) && ok;
+        ok = ok && ::rename(temporary, path.c_str()) == 0;
+        if (!ok) {
+            ::unlink(temporary);
+            return orderbook::ERR_IO;
+        }
+
+        // The rename is only durable once the directory holding it is synced too
+        auto slash = path.rfind('/');
+        if (slash == std::string::npos) {
+            std::memcpy(temporary, ".", 2);
+        } else {
+            std::memcpy(temporary, path.data(), slash + 1);
+            temporary[slash + 1] = '\0';
+        }
+        int directory = ::open(temporary, O_RDONLY | O_DIRECTORY);
+        ok = directory >= 0 && ::fsync(directory) == 0;
+        if (directory >= 0) {
+            ::close(directory);
+        }
+        return ok ? orderbook::SUCCESS : orderbook::ERR_IO;
+    }
+
+    Checkpointer::~Checkpointer() {
+        Wait();
+    }
+
+    int Checkpointer::Start(const std::string & path, const orderbook::Implementation & book, uint64_t journalPosition) {
+        if (Running()) {
+            return orderbook::ERR_IO;
+        }
+
+        // Anything buffered for stdio would otherwise be written twice
+        std::cout.flush();
+        std::cerr.flush();
+
+        auto child = ::fork();
+        if (child < 0) {
+            std::cerr<<"Could not fork to write snapshot "<<path<<'\n';
+            return orderbook::ERR_IO;
+        }
+        if (child == 0) {
+            // Only the thread that forked exists here, so nothing that might wait on another thread is used
+            ::_exit(WriteSnapshot(path, book, journalPosition) == orderbook::SUCCESS ? 0 : 1);
+        }
+        child_ = child;
+        rc_ = orderbook::SUCCESS;
+        return orderbook::SUCCESS;
+    }
+
+    int Checkpointer::Start(const std::string & path, const orderbook::Implementation & book, Journal & journal) {
+        if (Running()) {
+            return orderbook::ERR_IO;
+        }
+        auto rc = journal.Sync();
+        return rc == orderbook::SUCCESS ? Start(path, book, journal.Committed()) : rc;
+    }
+
+    bool Checkpointer::Running() {
+        if (child_ < 0) {
+            return false;
+        }
+        int status;
+        auto pid = ::waitpid(child_, &status, WNOHANG);
+        if (pid == 0) {
+            return true;
+        }
+        rc_ = (pid == child_ && WIFEXITED(status) && WEXITSTATUS(status) == 0) ? orderbook::SUCCESS : orderbook::ERR_IO;
+        child_ = -1;
+        return false;
+    }
+
+    int Checkpointer::Wait() {
+        if (child_ >= 0) {
+            int status;
+            pid_t pid;
+            while ((pid = ::waitpid(child_, &status, 0)) < 0 && errno == EINTR) {
+            }
+            rc_ = (pid == child_ && WIFEXITED(status) && WEXITSTATUS(status) == 0) ? orderbook::SUCCESS : orderbook::ERR_IO;
+            child_ = -1;
+        }
+        return rc_;
+    }
+
+    Journal::~Journal() {
+        Close();
+    }
+
+    int Journal::Open(const std::string & path, bool fresh) {
+        Close();
+
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | (fresh ? O_TRUNC : 0), 0644);
+        if (fd_ < 0) {
+            std::cerr<<"Could not open journal "<<path<<'\n';
+            return orderbook::ERR_IO;
+        }
+        path_ = path;
+        buffer_.reserve(BUFFER);
+
+        wire::FileHeader header{};
+        auto read = ::pread(fd_, &header, sizeof(header), 0);
+        if (read == 0) {
+            std::memcpy(header.magic_, wire::MAGIC, sizeof(wire::MAGIC));
+            header.version_ = wire::VERSION;
+            header.recordSize_ = sizeof(wire::Record);
+            header.count_ = 0;
+            header.ticksPerUnit_ = orderbook::TICKS_PER_UNIT;
+            if (!WriteAt(fd_, &header, sizeof(header), 0)) {
+                std::cerr<<"Could not write journal "<<path<<'\n';
+                Close();
+                return orderbook::ERR_IO;
+            }
+        } else if (read != sizeof(header) || std::memcmp(header.magic_, wire::MAGIC, sizeof(wire::MAGIC)) != 0 ||
+                   header.version_ != wire::VERSION || header.recordSize_ != sizeof(wire::Record) ||
+                   header.ticksPerUnit_ != orderbook::TICKS_PER_UNIT) {
+            std::cerr<<"Journal "<<path<<" has an unsupported format\n";
+            Close();
+            return orderbook::ERR_IO;
+        }
+
+        // Anything past the committed count is a torn write from before a crash
+        committed_ = header.count_;
+        if (::ftruncate(fd_, static_cast<off_t>(sizeof(header) + committed_ * sizeof(wire::Record))) != 0) {
+            std::cerr<<"Could not truncate journal "<<path<<'\n';
+            Close();
+            return orderbook::ERR_IO;
+        }
+        return orderbook::SUCCESS;
+    }
+
+    void Journal::Close() {
+        if (fd_ >= 0) {
+            Flush();
+            ::close(fd_);
+        }
+        fd_ = -1;
+        committed_ = 0;
+        buffer_.clear();
+    }
+
+    int Journal::Append(const orderbook::Order & order) {
+        buffer_.push_back(wire::Encode(order));
+        return buffer_.size() == BUFFER ? Flush() : orderbook::SUCCESS;
+    }
+
+    int Journal::Flush() {
+        if (fd_ < 0 || buffer_.empty()) {
+            return fd_ < 0 ? orderbook::ERR_IO : orderbook::SUCCESS;
+        }
+
+        // The records reach the disk first and the count after, so the count never covers a record that
+        // isn't there, even after a power loss
+        auto offset = static_cast<off_t>(sizeof(wire::FileHeader) + committed_ * sizeof(wire::Record));
+        if (!WriteAt(fd_, buffer_.data(), buffer_.size() * sizeof(wire::Record), offset) || ::fdatasync(fd_) != 0) {
+            std::cerr<<"Could not write journal "<<path_<<'\n';
+            return orderbook::ERR_IO;
+        }
+        uint64_t count = committed_ + buffer_.size();
+        if (!WriteAt(fd_, &count, sizeof(count), offsetof(wire::FileHeader, count_))) {
+            std::cerr<<"Could not commit journal "<<path_<<'\n';
+            return orderbook::ERR_IO;
+        }
+        committed_ = count;
+        buffer_.clear();
+        return orderbook::SUCCESS;
+    }
+
+    int Journal::Sync() {
+        auto rc = Flush();
+        if (rc == orderbook::SUCCESS && ::fdatasync(fd_) != 0) {
+            std::cerr<<"Could not sync journal "<<path_<<'\n';
+            return orderbook::ERR_IO;
+        }
+        return rc;
+    }
+
+    int Recover(const std::string & snapshot, const std::string & journal, orderbook::Implementation & book, RecoverStats & stats) {
+        auto start = std::chrono::steady_clock::now();
+
+        uint64_t position{0};
+        if (!snapshot.empty()) {
+            auto rc = LoadSnapshot(snapshot, book, position, stats.orders_);
+            if (rc != orderbook::SUCCESS) {
+                std::cerr<<"Could not load snapshot "<<snapshot<<'\n';
+                return rc;
+            }
+        }
+
+        if (!journal.empty()) {
+            wire::MappedFile file;
+            auto rc = file.Open(journal);
+            if (rc != orderbook::SUCCESS) {
+                return rc;
+            }
+            if (file.Count() < position) {
+                std::cerr<<"Journal "<<journal<<" is behind snapshot "<<snapshot<<'\n';
+                return orderbook::ERR_IO;
+            }
+            wire::Replay(file, position, book, stats.journal_);
+        }
+
+        stats.seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return orderbook::SUCCESS;
+    }
+
+} // namespace persist
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "orderbook.hpp"
+#include "wire.hpp"
+
+namespace persist {
+
+    // A snapshot is a SnapshotHeader, then symbols_ zero padded symbol keys in InstrumentID order, then
+    // orders_ SnapshotOrders in the order Implementation::ForEachOrder visits them. Everything is fixed
+    // size and aligned so a mapped snapshot is read in place.
+    constexpr char SNAPSHOT_MAGIC[8] = {'O', 'B', 'S', 'N', 'A', 'P', '\0', '\0'};
+    constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+    struct SnapshotHeader {
+        char magic_[8];
+        uint32_t version_;
+        uint32_t orderSize_;
+        uint64_t symbols_;
+        uint64_t orders_;
+        uint64_t journalPosition_;  // Journal records already reflected in the snapshot
+        int64_t ticksPerUnit_;
+    };
+
+    struct SnapshotOrder {
+        int64_t OrderID_;
+        int64_t Price_;
+        int64_t Volume_;
+        uint32_t instrument_;
+        uint8_t OrderDirection_;
+        uint8_t OrderConstraints_;
+        uint8_t padding_[2];
+    };
+
+    static_assert(sizeof(SnapshotHeader) == 48, "SnapshotHeader layout is part of the file format");
+    static_assert(sizeof(SnapshotOrder) == 32, "SnapshotOrder layout is part of the file format");
+
+    // Write the book as it stands, via a temporary file renamed into place once it is synced, so a
+    // crash mid write leaves the previous snapshot intact. Allocates nothing, so it is safe in a fork.
+    int WriteSnapshot(const std::string & path, const orderbook::Implementation & book, uint64_t journalPosition);
+
+    class Journal;
+
+    // Checkpoints from a forked child, which writes the copy on write image of the book while the
+    // parent carries on processing. The parent only pays for the fork and the pages it then dirties.
+    class Checkpointer {
+        public:
+            Checkpointer() = default;
+            // Waits for a checkpoint still being written
+            ~Checkpointer();
+
+            Checkpointer(const Checkpointer &) = delete;
+            Checkpointer & operator=(const Checkpointer &) = delete;
+
+            // Only one checkpoint is written at a time, returns ERR_IO if one is still running or the fork fails
+            int Start(const std::string & path, const orderbook::Implementation & book, uint64_t journalPosition);
+            // Syncs the journal first and stamps the snapshot with what it committed, so the journal can
+            // never be found behind the snapshot after a crash
+            int Start(const std::string & path, const orderbook::Implementation & book, Journal & journal);
+            bool Running();
+            // The result of the last checkpoint, once it has finished
+            int Wait();
+
+        private:
+            pid_t child_{-1};
+            int rc_{orderbook::SUCCESS};
+    };
+
+    // An append only log of the orders given to the book since the session began. A journal is a
+    // capture file whose header count is only advanced once the records before it are written, so the
+    // count marks what was committed and a torn tail after a crash is ignored.
+    class Journal {
+        public:
+            Journal() = default;
+            ~Journal();
+
+            Journal(const Journal &) = delete;
+            Journal & operator=(const Journal &) = delete;
+
+            // Opens an existing journal to append after its committed records, or creates a new one. A new
+            // session starts with a fresh journal, truncating anything already there.
+            int Open(const std::string & path, bool fresh = false);
+            void Close();
+
+            // Buffered, written out when the buffer fills or on Flush
+            int Append(const orderbook::Order & order);
+            // Write out and commit buffered records, the records reaching the disk before the count does
+            int Flush();
+            // Flush, then wait for the records to reach the disk
+            int Sync();
+
+            // Records appended so far, including any still buffered
+            uint64_t Position() const { return committed_ + buffer_.size(); }
+            // Records the header count covers, what recovery will find after a crash once synced
+            uint64_t Committed() const { return committed_; }
+
+        private:
+            static constexpr std::size_t BUFFER = 4096;
+
+            int fd_{-1};
+            std::string path_;
+            uint64_t committed_{0};
+            std::vector<wire::Record> buffer_;
+    };
+
+    struct RecoverStats {
+        std::size_t orders_{0};         // Resting orders restored from the snapshot
+        wire::ReplayStats journal_;     // Journal records replayed after it
+        double seconds_{0.0};
+    };
+
+    // Rebuild a book from the snapshot, if there is one, and the journal records written after it.
+    // The book should be empty and not matching, the snapshot's orders are added as they rested.
+    int Recover(const std::string & snapshot, const std::string & journal, orderbook::Implementation & book, RecoverStats & stats);
+
+} // namespace persist
@@ -0,0 +1,396 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include "engine.hpp"
+#include "pipeline.hpp"
+#include "text.hpp"
+#include "wire.hpp"
+
+namespace orderbook {
+
+    namespace {
+
+        constexpr int SPINS_BEFORE_SLEEP = 256;
+        constexpr std::size_t PAGE = 4096;
+        constexpr uint32_t NO_BATCH = UINT32_MAX;
+
+        class Waiter {
+            public:
+                explicit Waiter(const Pipeline::Config & config) : wait_(config.wait_), sleep_(config.sleep_) {}
+
+                void operator()() {
+                    if (wait_ == Pipeline::Wait::BUSY || ++spins_ < SPINS_BEFORE_SLEEP) {
+#if defined(__x86_64__) || defined(__i386__)
+                        __builtin_ia32_pause();
+#endif
+                    } else {
+                        std::this_thread::sleep_for(sleep_);
+                    }
+                }
+
+                void Reset() { spins_ = 0; }
+
+            private:
+                Pipeline::Wait wait_;
+                std::chrono::microseconds sleep_;
+                int spins_{0};
+        };
+
+        // Takes a slot from a ring, counting an empty ring once however long it takes to fill
+        uint32_t Take(SpscQueue<uint32_t> & ring, Waiter & wait, std::size_t & waits) {
+            uint32_t slot;
+            if (!ring.TryPop(slot)) {
+                ++waits;
+                do {
+                    wait();
+                } while (!ring.TryPop(slot));
+                wait.Reset();
+            }
+            return slot;
+        }
+
+        // Records how deep the ring feeding a stage was when it took an item from it
+        void Took(Pipeline::StageStats & stats, const SpscQueue<uint32_t> & ring) {
+            auto depth = ring.Size() + 1;
+            ++stats.items_;
+            stats.totalDepth_ += depth;
+            stats.maxDepth_ = std::max(stats.maxDepth_, depth);
+        }
+
+        void Pin(int cpu, const char * stage) {
+            if (cpu >= 0 && !PinThread(cpu)) {
+                std::cerr<<"Could not pin "<<stage<<" to cpu "<<cpu<<'\n';
+            }
+        }
+
+        // Reads until the buffer is full or the file ends, false on an error
+        bool ReadFully(int fd, char * buffer, std::size_t size, std::size_t & read) {
+            read = 0;
+            while (read < size) {
+                auto bytes = ::read(fd, buffer + read, size - read);
+                if (bytes < 0) {
+                    return false;
+                }
+                if (bytes == 0) {
+                    break;
+                }
+                read += static_cast<std::size_t>(bytes);
+            }
+            return true;
+        }
+
+    } // namespace
+
+    Pipeline::Pipeline(Implementation & book, const Config & config)
+        : book_(book), config_(config), blocks_(std::max<std::size_t>(config.blocks_, 2)), batches_(std::max<std::size_t>(config.batches_, 2)),
+          readBlocks_(blocks_.size()), freeBlocks_(blocks_.size()), decoded_(batches_.size()), freeBatches_(batches_.size()) {
+        // A block holds at least one record
+        config_.blockSize_ = std::max(config_.blockSize_, sizeof(wire::Record));
+        for (uint32_t slot = 0; slot < blocks_.size(); ++slot) {
+            if (!config_.map_) {
+                blocks_[slot].buffer_.reset(new char[config_.blockSize_]);
+            }
+            freeBlocks_.TryPush(slot);
+        }
+        for (uint32_t slot = 0; slot < batches_.size(); ++slot) {
+            freeBatches_.TryPush(slot);
+        }
+    }
+
+    Pipeline::~Pipeline() = default;
+
+    int Pipeline::Run(const std::string & path) {
+        auto start = std::chrono::steady_clock::now();
+        stats_ = Stats{};
+        rc_ = SUCCESS;
+        // Copied before the book thread starts registering securities in the book's own
+        symbols_ = book_.Symbols();
+
+        auto text = text::IsTextFile(path);
+        std::thread reader(&Pipeline::Read, this, std::cref(path), text);
+        std::thread decoder(&Pipeline::Decode, this, text);
+        std::thread applier(&Pipeline::Apply, this);
+        reader.join();
+        decoder.join();
+        applier.join();
+
+        if (mapping_ != nullptr) {
+            ::munmap(mapping_, mapped_);
+            mapping_ = nullptr;
+        }
+        stats_.seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return rc_;
+    }
+
+    void Pipeline::Read(const std::string & path, bool text) {
+        Pin(config_.readerCpu_, "reader");
+        Waiter wait(config_);
+        StageStats stats;
+        std::size_t bytes{0};
+
+        // Every block goes to the decoder, the last one marked so, even when the file can't be read
+        auto send = [this, &stats] (uint32_t slot, const char * data, std::size_t size, bool last, std::size_t dropped) {
+            auto & block = blocks_[slot];
+            block.data_ = data;
+            block.size_ = size;
+            block.last_ = last;
+            block.dropped_ = dropped;
+            readBlocks_.TryPush(slot);      // Never full, there are only as many blocks as it holds
+            ++stats.items_;
+        };
+        auto fail = [this, &wait, &stats, &send] {
+            rc_ = ERR_IO;
+            send(Take(freeBlocks_, wait, stats.stalls_), nullptr, 0, true, 0);
+        };
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr<<"Could not open order file "<<path<<'\n';
+            fail();
+            stats_.reader_ = stats;
+            return;
+        }
+
+        // A capture's records follow its header, up to the count it gives
+        std::size_t start{0};
+        std::size_t end{SIZE_MAX};
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            std::cerr<<"Could not read order file "<<path<<'\n';
+            ::close(fd);
+            fail();
+            stats_.reader_ = stats;
+            return;
+        }
+        auto size = static_cast<std::size_t>(info.st_size);
+        if (text) {
+            end = size;
+        } else {
+            wire::FileHeader header;
+            std::size_t read;
+            if (!ReadFully(fd, reinterpret_cast<char *>(&header), sizeof(header), read) || read != sizeof(header) || wire::Check(header, size, path) != SUCCESS) {
+                if (read != sizeof(header)) {
+                    std::cerr<<"Capture file "<<path<<" is too short\n";
+                }
+                ::close(fd);
+                fail();
+                stats_.reader_ = stats;
+                return;
+            }
+            start = sizeof(header);
+            end = start + header.count_ * sizeof(wire::Record);
+        }
+
+        if (config_.map_) {
+            // Slices of the mapping, each of whose pages the reader touches first, so the decoder never
+            // takes a page fault
+            void * data = size ? ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+            ::close(fd);
+            if (data == MAP_FAILED) {
+                std::cerr<<"Could not map order file "<<path<<'\n';
+                fail();
+                stats_.reader_ = stats;
+                return;
+            }
+            if (size) {
+                ::madvise(data, size, MADV_SEQUENTIAL);
+            }
+            mapping_ = data;
+            mapped_ = size;
+
+            const auto * file = static_cast<const char *>(data);
+            auto offset = start;
+            do {
+                auto slot = Take(freeBlocks_, wait, stats.stalls_);
+                auto limit = std::min(end, offset + config_.blockSize_);
+                if (limit != end) {
+                    if (text) {
+                        // Back to the end of the last whole line, or on to the end of the first if there isn't one
+                        const auto * newline = static_cast<const char *>(::memrchr(file + offset, '\n', limit - offset));
+                        if (newline == nullptr) {
+                            newline = static_cast<const char *>(std::memchr(file + limit, '\n', end - limit));
+                        }
+                        limit = newline != nullptr ? static_cast<std::size_t>(newline - file) + 1 : end;
+                    } else {
+                        limit = offset + (limit - offset) / sizeof(wire::Record) * sizeof(wire::Record);
+                    }
+                }
+                volatile char touched{0};
+                for (auto page = offset; page < limit; page += PAGE) {
+                    touched = touched + file[page];
+                }
+                bytes += limit - offset;
+                send(slot, file + offset, limit - offset, limit == end, 0);
+                offset = limit;
+            } while (offset != end);
+        } else {
+            // Whole lines or records a block at a time, with whatever is left over carried into the next.
+            // A line longer than a block can't be carried, so it is dropped through to its newline and
+            // counted as malformed rather than handed on in pieces.
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            std::unique_ptr<char[]> carry(new char[config_.blockSize_]);
+            std::size_t held{0};
+            auto remaining = end - start;
+            bool last{false};
+            bool dropping{false};
+            while (!last) {
+                auto slot = Take(freeBlocks_, wait, stats.stalls_);
+                auto * buffer = blocks_[slot].buffer_.get();
+                std::memcpy(buffer, carry.get(), held);
+                std::size_t read;
+                if (!ReadFully(fd, buffer + held, std::min(config_.blockSize_ - held, remaining), read)) {
+                    std::cerr<<"Could not read order file "<<path<<'\n';
+                    rc_ = ERR_IO;
+                    send(slot, buffer, 0, true, 0);
+                    break;
+                }
+                bytes += read;
+                remaining -= read;
+                auto filled = held + read;
+                last = remaining == 0 || filled < config_.blockSize_;
+
+                std::size_t skip{0}, dropped{0};
+                if (dropping) {
+                    const auto * newline = static_cast<const char *>(std::memchr(buffer, '\n', filled));
+                    skip = newline != nullptr ? static_cast<std::size_t>(newline - buffer) + 1 : filled;
+                    dropping = newline == nullptr;
+                }
+                auto keep = filled;
+                if (!last) {
+                    if (text) {
+                        const auto * newline = static_cast<const char *>(::memrchr(buffer + skip, '\n', filled - skip));
+                        keep = newline != nullptr ? static_cast<std::size_t>(newline - buffer) + 1 : skip;
+                        if (newline == nullptr && filled - skip == config_.blockSize_) {
+                            skip = keep = filled;
+                            dropping = true;
+                            ++dropped;
+                        }
+                    } else {
+                        keep = filled / sizeof(wire::Record) * sizeof(wire::Record);
+                    }
+                }
+                held = filled - keep;
+                std::memcpy(carry.get(), buffer + keep, held);
+                send(slot, buffer + skip, keep - skip, last, dropped);
+            }
+            ::close(fd);
+        }
+
+        stats_.reader_ = stats;
+        stats_.bytes_ = bytes;
+    }
+
+    void Pipeline::Decode(bool text) {
+        Pin(config_.decoderCpu_, "decoder");
+        Waiter wait(config_);
+        StageStats stats;
+
+        uint32_t current{NO_BATCH};
+        auto batch = [this, &wait, &stats, &current] () -> Batch & {
+            if (current == NO_BATCH) {
+                current = Take(freeBatches_, wait, stats.stalls_);
+                auto & fresh = batches_[current];
+                fresh.count_ = 0;
+                fresh.newSymbols_ = 0;
+                fresh.last_ = false;
+            }
+            return batches_[current];
+        };
+        auto flush = [this, &batch, &current] (bool last) {
+            if (current != NO_BATCH || last) {
+                batch().last_ = last;
+                decoded_.TryPush(current);  // Never full, there are only as many batches as it holds
+                current = NO_BATCH;
+            }
+        };
+
+        // Consecutive orders are often for the same security, so skip the lookup when it repeats
+        char lastSymbol[compact::ID_LEN] = {};
+        InstrumentID instrument{NO_INSTRUMENT};
+        auto decode = [&] (const wire::Record * records, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) {
+                const auto & record = records[i];
+                auto & out = batch();
+                if (instrument == NO_INSTRUMENT || std::memcmp(lastSymbol, record.SecurityID_, compact::ID_LEN) != 0) {
+                    auto known = symbols_.Size();
+                    instrument = symbols_.Intern(record.SecurityID_, compact::ID_LEN);
+                    if (symbols_.Size() != known) {
+                        std::memcpy(out.symbols_[out.newSymbols_++], record.SecurityID_, compact::ID_LEN);
+                    }
+                    std::memcpy(lastSymbol, record.SecurityID_, compact::ID_LEN);
+                }
+                out.messages_[out.count_++] = wire::Decode(record, instrument);
+                if (out.count_ == BATCH) {
+                    flush(false);
+                }
+            }
+        };
+
+        text::Parser parser;
+        std::vector<wire::Record> records(BATCH);
+        std::size_t dropped{0};
+        while (true) {
+            auto slot = Take(readBlocks_, wait, stats.idles_);
+            Took(stats, readBlocks_);
+            const auto & block = blocks_[slot];
+            if (text) {
+                std::size_t offset{0}, count;
+                while (offset < block.size_) {
+                    auto used = parser.Parse(block.data_ + offset, block.size_ - offset, records.data(), records.size(), count, block.last_);
+                    decode(records.data(), count);
+                    offset += used;
+                }
+                dropped += block.dropped_;
+            } else {
+                decode(reinterpret_cast<const wire::Record *>(block.data_), block.size_ / sizeof(wire::Record));
+            }
+
+            // Whatever the block held goes on now, so a quiet feed isn't held back waiting for a full batch
+            auto last = block.last_;
+            freeBlocks_.TryPush(slot);
+            flush(last);
+            if (last) {
+                break;
+            }
+        }
+
+        stats_.decoder_ = stats;
+        stats_.malformed_ = parser.Stats().malformed_ + dropped;
+    }
+
+    void Pipeline::Apply() {
+        Pin(config_.bookCpu_, "book");
+        Waiter wait(config_);
+        StageStats stats;
+        std::size_t messages{0}, rejected{0};
+
+        while (true) {
+            auto slot = Take(decoded_, wait, stats.idles_);
+            Took(stats, decoded_);
+            const auto & batch = batches_[slot];
+            for (std::size_t i = 0; i < batch.newSymbols_; ++i) {
+                book_.Register(batch.symbols_[i], compact::ID_LEN);
+            }
+            rejected += book_.ProcessBatch(batch.messages_, batch.count_, nullptr);
+            messages += batch.count_;
+
+            auto last = batch.last_;
+            freeBatches_.TryPush(slot);
+            if (last) {
+                break;
+            }
+        }
+
+        stats_.book_ = stats;
+        stats_.messages_ = messages;
+        stats_.rejected_ = rejected;
+    }
+
+} // namespace orderbook
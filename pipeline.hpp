@@ -0,0 +1,119 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "orderbook.hpp"
+#include "spsc.hpp"
+
+namespace orderbook {
+
+    // Applies a capture or text order file to a book with reading, decoding and applying each on a
+    // thread of its own, so the book thread only ever calls ProcessBatch. The reader hands the decoder
+    // blocks of whole records or lines, read a block at a time into a fixed set of buffers or sliced
+    // from a mapping of the file. The decoder parses them into Messages, resolving securities against
+    // its own copy of the book's symbols, and hands the book batches that list the securities first
+    // seen in them, which the book registers before applying the batch so both number them alike.
+    // Blocks and batches are preallocated, and each stage passes them on, and back once done, through
+    // single producer single consumer rings, so nothing is allocated or locked once running.
+    class Pipeline {
+        public:
+            // How a stage waits on an empty or full ring: polling it, for stages on cores of their own, or
+            // after a short spin sleeping
+            enum class Wait : uint8_t {
+                BUSY, SLEEP
+            };
+
+            struct Config {
+                std::size_t blockSize_{std::size_t{1} << 20};     // Bytes the reader hands the decoder at a time
+                std::size_t blocks_{8};                             // Blocks in flight between reader and decoder
+                std::size_t batches_{64};                           // Batches in flight between decoder and book
+                bool map_{false};                                   // Slice a mapping of the file rather than reading it
+                Wait wait_{Wait::BUSY};
+                std::chrono::microseconds sleep_{50};
+                int readerCpu_{-1};                                 // Cpus to pin each stage to, -1 to leave it unpinned
+                int decoderCpu_{-1};
+                int bookCpu_{-1};
+            };
+
+            // What each stage did, and how deep the ring feeding it was each time it took from it.
+            // Stalls are the times a stage found the next stage's ring full, idles the times it found
+            // its own empty, each counted once however long it then waited.
+            struct StageStats {
+                std::size_t items_{0};
+                std::size_t maxDepth_{0};
+                uint64_t totalDepth_{0};
+                std::size_t stalls_{0};
+                std::size_t idles_{0};
+
+                double MeanDepth() const { return items_ ? static_cast<double>(totalDepth_) / static_cast<double>(items_) : 0.0; }
+            };
+
+            struct Stats {
+                StageStats reader_;
+                StageStats decoder_;
+                StageStats book_;
+                std::size_t messages_{0};
+                std::size_t rejected_{0};
+                std::size_t malformed_{0};
+                std::size_t bytes_{0};
+                double seconds_{0.0};
+            };
+
+            // A batch holds up to BATCH messages
+            static constexpr std::size_t BATCH = 256;
+
+            Pipeline(Implementation & book, const Config & config);
+            ~Pipeline();
+
+            Pipeline(const Pipeline &) = delete;
+            Pipeline & operator=(const Pipeline &) = delete;
+
+            // Applies every order in the file, text if text::IsTextFile names it so and a capture
+            // otherwise, returning once the book has applied the last of them. Nothing else may use
+            // the book meanwhile.
+            int Run(const std::string & path);
+            const Stats & Statistics() const { return stats_; }
+
+        private:
+            // Each on its own cache lines, so the stage filling one doesn't share a line with the stage
+            // reading the one before it
+            struct alignas(CACHE_LINE) Block {
+                std::unique_ptr<char[]> buffer_;    // Only when reading rather than mapping
+                const char * data_{nullptr};
+                std::size_t size_{0};
+                bool last_{false};
+                std::size_t dropped_{0};            // Lines longer than a block the reader dropped before it
+            };
+
+            struct alignas(CACHE_LINE) Batch {
+                Message messages_[BATCH];
+                char symbols_[BATCH][compact::ID_LEN];  // Securities first seen in this batch, in the order they were
+                std::size_t count_{0};
+                std::size_t newSymbols_{0};
+                bool last_{false};
+            };
+
+            void Read(const std::string & path, bool text);
+            void Decode(bool text);
+            void Apply();
+
+            Implementation & book_;
+            Config config_;
+            std::vector<Block> blocks_;
+            std::vector<Batch> batches_;
+            SpscQueue<uint32_t> readBlocks_;    // Reader to decoder
+            SpscQueue<uint32_t> freeBlocks_;    // And back
+            SpscQueue<uint32_t> decoded_;       // Decoder to book
+            SpscQueue<uint32_t> freeBatches_;   // And back
+            SymbolRegistry symbols_;            // The decoder's copy of the book's
+            void * mapping_{nullptr};
+            std::size_t mapped_{0};
+            int rc_{SUCCESS};
+            Stats stats_;
+    };
+
+} // namespace orderbook
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+namespace orderbook {
+
+    constexpr uint32_t NIL = UINT32_MAX;
+
+    // The orders resting at one price, a FIFO queue of pool nodes linked through their prev_/next_ indices.
+    // The head's prev_ is the tail rather than NIL, which leaves room for the level's total volume in 16
+    // bytes. The book keeps volume_ as the sum of the orders' volumes as they are added, amended and removed.
+    struct Level {
+        uint32_t head_{NIL};
+        uint32_t count_{0};
+        int64_t volume_{0};
+
+        bool empty() const { return count_ == 0; }
+        std::size_t size() const { return count_; }
+    };
+
+    // Fixed size nodes handed out from one contiguous slab. Released nodes go on a free list and are
+    // reused before the slab grows, so once reserved for the day, adding and removing orders never
+    // touches the allocator. Nodes are referred to by index, which stays valid when the slab grows.
+    template<typename Node>
+    class Pool {
+        public:
+            void Reserve(std::size_t size) {
+                if (size > nodes_.size()) {
+                    nodes_.resize(size);
+                }
+            }
+
+            uint32_t Allocate() {
+                uint32_t index = free_;
+                if (index != NIL) {
+                    free_ = nodes_[index].next_;
+                } else {
+                    if (used_ == nodes_.size()) {
+                        nodes_.resize(nodes_.empty() ? 1024 : nodes_.size() * 2);
+                    }
+                    index = static_cast<uint32_t>(used_++);
+                }
+                ++live_;
+                return index;
+            }
+
+            void Release(uint32_t index) {
+                nodes_[index].next_ = free_;
+                free_ = index;
+                --live_;
+            }
+
+            // Hands every node back at once, keeping the slab for the next day
+            void Reset() {
+                free_ = NIL;
+                used_ = 0;
+                live_ = 0;
+            }
+
+            // Link a node onto the back of a level
+            void Append(Level & level, uint32_t index) {
+                auto & node = nodes_[index];
+                node.next_ = NIL;
+                if (level.head_ != NIL) {
+                    auto & head = nodes_[level.head_];
+                    node.prev_ = head.prev_;
+                    nodes_[head.prev_].next_ = index;
+                    head.prev_ = index;
+                } else {
+                    node.prev_ = index;
+                    level.head_ = index;
+                }
+                ++level.count_;
+            }
+
+            // Unlink a node from anywhere in its level
+            void Remove(Level & level, uint32_t index) {
+                auto & node = nodes_[index];
+                if (index == level.head_) {
+                    level.head_ = node.next_;
+                } else {
+                    nodes_[node.prev_].next_ = node.next_;
+                }
+                // Whatever follows takes over the prev_, the head's if this was the tail
+                auto next = node.next_ != NIL ? node.next_ : level.head_;
+                if (next != NIL) {
+                    nodes_[next].prev_ = node.prev_;
+                }
+                --level.count_;
+            }
+
+            Node & operator[](uint32_t index) { return nodes_[index]; }
+            const Node & operator[](uint32_t index) const { return nodes_[index]; }
+
+            std::size_t Size() const { return live_; }
+            std::size_t Capacity() const { return nodes_.size(); }
+            std::size_t Bytes() const { return nodes_.capacity() * sizeof(Node); }
+
+        private:
+            std::vector<Node> nodes_;
+            uint32_t free_{NIL};
+            std::size_t used_{0};
+            std::size_t live_{0};
+    };
+
+    // Walks the orders in a level from the front of the queue
+    template<typename Node>
+    class PoolIterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = Node;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const Node *;
+            using reference = const Node &;
+
+            PoolIterator() = default;
+            PoolIterator(const Pool<Node> * pool, uint32_t index) : pool_(pool), index_(index) {}
+
+            reference operator*() const { return (*pool_)[index_]; }
+            pointer operator->() const { return &(*pool_)[index_]; }
+
+            PoolIterator & operator++() {
+                index_ = (*pool_)[index_].next_;
+                return *this;
+            }
+
+            PoolIterator operator++(int) {
+                auto it = *this;
+                ++*this;
+                return it;
+            }
+
+            bool operator==(const PoolIterator & rhs) const { return index_ == rhs.index_; }
+            bool operator!=(const PoolIterator & rhs) const { return index_ != rhs.index_; }
+
+        private:
+            const Pool<Node> * pool_{nullptr};
+            uint32_t index_{NIL};
+    };
+
+} // namespace orderbook
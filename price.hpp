@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+
+namespace orderbook {
+
+    // Prices are held internally as an integer number of ticks, so price levels compare exactly
+    using Tick = int_fast64_t;
+
+    constexpr int_fast64_t TICKS_PER_UNIT = 100;
+
+    inline Tick ToTick(float price) {
+        return static_cast<Tick>(std::llround(static_cast<double>(price) * TICKS_PER_UNIT));
+    }
+
+    inline float ToPrice(Tick tick) {
+        return static_cast<float>(static_cast<double>(tick) / TICKS_PER_UNIT);
+    }
+
+    // Bids are best at the highest price, asks at the lowest
+    struct BidSide {
+        using Compare = std::greater<Tick>;
+        static constexpr bool ASCENDING = false;
+        static bool Better(Tick lhs, Tick rhs) { return lhs > rhs; }
+    };
+
+    struct AskSide {
+        using Compare = std::less<Tick>;
+        static constexpr bool ASCENDING = true;
+        static bool Better(Tick lhs, Tick rhs) { return lhs < rhs; }
+    };
+
+} // namespace orderbook
@@ -0,0 +1,29 @@
+#include <thread>
+
+#include "quotes.hpp"
+
+namespace orderbook {
+
+    QuoteBoard::QuoteBoard(std::size_t capacity) : capacity_(capacity), slots_(new Slot[capacity]) {
+    }
+
+    bool QuoteBoard::Read(InstrumentID instrument, TopOfBook & top) const {
+        if (instrument >= capacity_) {
+            return false;
+        }
+        const auto & slot = slots_[instrument];
+        while (true) {
+            auto before = slot.sequence_.load(std::memory_order_acquire);
+            if (before & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            top = slot.top_;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence_.load(std::memory_order_relaxed) == before) {
+                return true;
+            }
+        }
+    }
+
+} // namespace orderbook
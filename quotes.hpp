@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "price.hpp"
+#include "spsc.hpp"
+#include "symbols.hpp"
+
+namespace orderbook {
+
+    // One aggregated price level
+    struct Quote {
+        Tick Price_;
+        int64_t Volume_;
+        uint32_t Orders_;
+    };
+
+    // The best DEPTH levels each side of one security, best first, as they stood after a whole message
+    struct TopOfBook {
+        static constexpr std::size_t DEPTH = 5;
+
+        uint64_t Updates_;          // How many times the snapshot has been published, 0 if never
+        uint32_t BidLevels_;
+        uint32_t AskLevels_;
+        Quote Bids_[DEPTH];
+        Quote Asks_[DEPTH];
+    };
+
+    // Top of book snapshots that other threads can read while the book thread is processing. Each
+    // security's snapshot is a seqlock on its own cache lines: the book thread never waits for readers,
+    // it only marks the snapshot as being written, rewrites the sides a message changed and marks it
+    // written again. A reader copies the snapshot and retries if it was being written meanwhile, so it
+    // takes no lock and always gets a snapshot that was whole, but may retry while one security is busy.
+    // Securities are held densely by InstrumentID up to a capacity fixed at construction, so a snapshot
+    // never moves while it is being read.
+    class QuoteBoard {
+        public:
+            explicit QuoteBoard(std::size_t capacity);
+
+            QuoteBoard(const QuoteBoard &) = delete;
+            QuoteBoard & operator=(const QuoteBoard &) = delete;
+
+            // Any thread. False if the instrument is beyond the board's capacity.
+            bool Read(InstrumentID instrument, TopOfBook & top) const;
+
+            std::size_t Capacity() const { return capacity_; }
+
+            // Only the book thread writes, Begin and End bracket its changes to a security's snapshot
+            TopOfBook & Begin(InstrumentID instrument) {
+                auto & slot = slots_[instrument];
+                slot.sequence_.store(slot.sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                return slot.top_;
+            }
+
+            void End(InstrumentID instrument) {
+                auto & slot = slots_[instrument];
+                auto sequence = slot.sequence_.load(std::memory_order_relaxed) + 1;
+                slot.top_.Updates_ = sequence / 2;
+                slot.sequence_.store(sequence, std::memory_order_release);
+            }
+
+            const TopOfBook & Current(InstrumentID instrument) const { return slots_[instrument].top_; }
+
+        private:
+            struct alignas(CACHE_LINE) Slot {
+                std::atomic<uint64_t> sequence_{0};     // Odd while the snapshot is being written
+                TopOfBook top_{};
+            };
+
+            std::size_t capacity_;
+            std::unique_ptr<Slot[]> slots_;
+    };
+
+} // namespace orderbook
@@ -0,0 +1,84 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "harness.hpp"
+
+// Replays many days of capture or text order files at once, a book per day or per symbol partition
+// of a day, across a pool of threads. Every run keeps its book's fingerprint as it goes, and the end
+// of day fingerprints are checked against a golden file written by an earlier, trusted build.
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    std::size_t threads = std::thread::hardware_concurrency();
+    uint32_t partitions = 1;
+    bool mapopt = false;
+    std::string goldenfile;
+    std::string writefile;
+
+    while ((opt = getopt(argc, argv, "j:P:g:w:Mh")) != -1) {
+        switch (opt) {
+            case 'j':
+                threads = std::stoul(optarg);
+            break;
+            case 'P':
+                partitions = std::max(1u, static_cast<uint32_t>(std::stoul(optarg)));
+            break;
+            case 'g':
+                goldenfile = optarg;
+            break;
+            case 'w':
+                writefile = optarg;
+            break;
+            case 'M':
+                mapopt = true;
+            break;
+            case 'h':
+            default:
+                std::cout<<argv[0]<<" -j (threads) <n> -P (symbol partitions per day) <n> -g (check against golden) <file> -w (write golden) <file> -M (map text files) <capture or text files>"<<'\n';
+                return 0;
+        }
+    }
+
+    threads = std::max<std::size_t>(threads, 1);
+
+    std::vector<harness::Run> runs;
+    for (auto i = optind; i < argc; ++i) {
+        for (uint32_t partition = 0; partition < partitions; ++partition) {
+            runs.push_back(harness::Run{argv[i], partition, partitions, mapopt});
+        }
+    }
+    if (runs.empty()) {
+        std::cerr<<"No files to replay"<<'\n';
+        return 1;
+    }
+
+    std::map<std::string, uint64_t> golden;
+    if (!goldenfile.empty() && harness::ReadGolden(goldenfile, golden) != orderbook::SUCCESS) {
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto results = harness::Replay(runs, threads);
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    auto failed = harness::Report(results, golden, std::cout);
+    std::size_t messages{0};
+    for (const auto & result : results) {
+        messages += result.messages_;
+    }
+    std::cout<<runs.size()<<" runs, "<<messages<<" messages in "<<seconds<<"s on "<<std::min(threads, runs.size())<<" threads, "
+             <<static_cast<uint64_t>(messages / (seconds > 0 ? seconds : 1e-9))<<" msgs/s, "<<failed<<" failed"<<'\n';
+
+    if (!writefile.empty() && harness::WriteGolden(writefile, results) != orderbook::SUCCESS) {
+        return 1;
+    }
+    return failed ? 1 : 0;
+}
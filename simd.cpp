@@ -0,0 +1,35 @@
+#include "simd.hpp"
+
+namespace orderbook {
+namespace simd {
+
+    bool Supported(Isa isa) {
+#ifdef ORDERBOOK_X86
+        // Kernels are picked while static objects are constructed, which can be before the CPU is probed
+        __builtin_cpu_init();
+        switch (isa) {
+            case Isa::AVX2: return __builtin_cpu_supports("avx2");
+            case Isa::SSE42: return __builtin_cpu_supports("sse4.2");
+            case Isa::SCALAR: return true;
+        }
+        return false;
+#else
+        return isa == Isa::SCALAR;
+#endif
+    }
+
+    Isa Widest() {
+        return Supported(Isa::AVX2) ? Isa::AVX2 : Supported(Isa::SSE42) ? Isa::SSE42 : Isa::SCALAR;
+    }
+
+    const char * Name(Isa isa) {
+        switch (isa) {
+            case Isa::AVX2: return "avx2";
+            case Isa::SSE42: return "sse4.2";
+            case Isa::SCALAR: return "scalar";
+        }
+        return "unknown";
+    }
+
+} // namespace simd
+} // namespace orderbook
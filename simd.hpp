@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ORDERBOOK_X86
+#endif
+
+namespace orderbook {
+namespace simd {
+
+    // The instruction sets the vectorised kernels are built for. Each set of kernels starts on the
+    // widest one the CPU supports and can be switched to a narrower one to compare them.
+    enum class Isa : uint8_t {
+        SCALAR, SSE42, AVX2
+    };
+
+    bool Supported(Isa isa);
+    Isa Widest();
+    const char * Name(Isa isa);
+
+    // A module's kernels, a struct of function pointers starting with the Isa isa_ they were built
+    // for, as Select returns them for each Isa. Starts on the widest the CPU supports.
+    template<typename Kernels, Kernels (*Select)(Isa)>
+    class Dispatch {
+        public:
+            Dispatch() : active_(Select(Widest())) {}
+
+            const Kernels * operator->() const { return &active_; }
+            Isa Active() const { return active_.isa_; }
+
+            // Switches every kernel to isa, false and nothing changed if the CPU doesn't support it
+            bool Use(Isa isa) {
+                if (!Supported(isa)) {
+                    return false;
+                }
+                active_ = Select(isa);
+                return true;
+            }
+
+        private:
+            Kernels active_;
+    };
+
+#ifdef ORDERBOOK_X86
+
+    // The sum of the 64 bit lanes
+    __attribute__((target("sse4.2")))
+    inline int64_t Sum(__m128i v) {
+        return _mm_cvtsi128_si64(v) + _mm_extract_epi64(v, 1);
+    }
+
+    __attribute__((target("avx2")))
+    inline int64_t Sum(__m256i v) {
+        return Sum(_mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+    }
+
+#endif
+
+} // namespace simd
+} // namespace orderbook
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace orderbook {
+
+    constexpr std::size_t CACHE_LINE = 64;
+
+    // A bounded lock free ring for exactly one producer thread and one consumer thread. The head and
+    // tail live on their own cache lines, and each side keeps a cached copy of the other's index so it
+    // only touches the shared line when the ring looks full or empty.
+    template<typename T>
+    class SpscQueue {
+        public:
+            explicit SpscQueue(std::size_t capacity) {
+                std::size_t size = 2;
+                while (size < capacity) {
+                    size *= 2;
+                }
+                slots_.reset(new T[size]);
+                mask_ = size - 1;
+            }
+
+            SpscQueue(const SpscQueue &) = delete;
+            SpscQueue & operator=(const SpscQueue &) = delete;
+
+            bool TryPush(const T & item) {
+                auto tail = tail_.load(std::memory_order_relaxed);
+                if (tail - headCache_ > mask_) {
+                    headCache_ = head_.load(std::memory_order_acquire);
+                    if (tail - headCache_ > mask_) {
+                        return false;
+                    }
+                }
+                slots_[tail & mask_] = item;
+                tail_.store(tail + 1, std::memory_order_release);
+                return true;
+            }
+
+            bool TryPop(T & item) {
+                auto head = head_.load(std::memory_order_relaxed);
+                if (head == tailCache_) {
+                    tailCache_ = tail_.load(std::memory_order_acquire);
+                    if (head == tailCache_) {
+                        return false;
+                    }
+                }
+                item = std::move(slots_[head & mask_]);
+                head_.store(head + 1, std::memory_order_release);
+                return true;
+            }
+
+            // Only a snapshot when called from a third thread
+            std::size_t Size() const {
+                return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+            }
+
+            bool Empty() const { return Size() == 0; }
+            std::size_t Capacity() const { return mask_ + 1; }
+
+        private:
+            alignas(CACHE_LINE) std::atomic<std::size_t> head_{0};
+            std::size_t tailCache_{0};
+            alignas(CACHE_LINE) std::atomic<std::size_t> tail_{0};
+            std::size_t headCache_{0};
+            alignas(CACHE_LINE) std::unique_ptr<T[]> slots_;
+            std::size_t mask_{0};
+    };
+
+} // namespace orderbook
@@ -0,0 +1,156 @@
+#include <iomanip>
+
+#include "orderbook.hpp"
+#include "stats.hpp"
+
+namespace orderbook {
+namespace stats {
+
+    namespace {
+
+        // Threads push their stats on a list that is never shrunk, so readers can walk it without a lock
+        std::atomic<ThreadStats *> threads{nullptr};
+
+        std::atomic<uint32_t> sampleRate{64};
+
+#ifdef ORDERBOOK_STATS
+        double NanosPerCycle() {
+            static const double rate = [] {
+                auto start = std::chrono::steady_clock::now();
+                auto cycles = Cycles();
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+                return elapsed / static_cast<double>(Cycles() - cycles);
+            }();
+            return rate;
+        }
+
+        const char * StageName(int stage) {
+            static const char * names[STAGES] = {"add", "modify", "delete", "security", "order", "level", "queue", "match"};
+            return names[stage];
+        }
+
+        const char * RejectName(int rc) {
+            switch (rc) {
+                case ERR_ORD_ACTION: return "ERR_ORD_ACTION";
+                case ERR_ORD_DIR: return "ERR_ORD_DIR";
+                case ERR_ORD_SECID: return "ERR_ORD_SECID";
+                case ERR_ORD_PRICE: return "ERR_ORD_PRICE";
+                case ERR_ORD_ORDERID: return "ERR_ORD_ORDERID";
+                case ERR_IO: return "ERR_IO";
+                case ERR_ORD_FILLS: return "ERR_ORD_FILLS";
+                case ERR_NOT_RUNNING: return "ERR_NOT_RUNNING";
+                default: return "other";
+            }
+        }
+#endif
+
+    } // namespace
+
+    ThreadStats * Register() {
+        auto * local = new ThreadStats;
+        auto * head = threads.load(std::memory_order_relaxed);
+        do {
+            local->next_ = head;
+        } while (!threads.compare_exchange_weak(head, local, std::memory_order_release, std::memory_order_relaxed));
+        return local;
+    }
+
+    void SetSampleRate(uint32_t rate) {
+        sampleRate.store(rate ? rate : 1, std::memory_order_relaxed);
+    }
+
+    uint32_t SampleRate() {
+        return sampleRate.load(std::memory_order_relaxed);
+    }
+
+    void Record(ThreadStats & stats, Stage stage, uint64_t start) {
+        stats.stages_[stage].Record(Cycles() - start);
+    }
+
+    void Dump(std::ostream & out) {
+#ifndef ORDERBOOK_STATS
+        out << "Stats were not compiled in, build with -DORDERBOOK_STATS=ON\n";
+#else
+        Histogram merged[STAGES];
+        uint64_t rejects[REJECT_CODES] = {};
+
+        for (auto * thread = threads.load(std::memory_order_acquire); thread != nullptr; thread = thread->next_) {
+            for (int stage = 0; stage < STAGES; ++stage) {
+                const auto & from = thread->stages_[stage];
+                auto & to = merged[stage];
+                for (int bucket = 0; bucket < Histogram::BUCKETS; ++bucket) {
+                    to.counts_[bucket].fetch_add(from.counts_[bucket].load(std::memory_order_relaxed), std::memory_order_relaxed);
+                }
+                to.total_.fetch_add(from.total_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                to.sum_.fetch_add(from.sum_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                to.max_.store(std::max(to.max_.load(std::memory_order_relaxed), from.max_.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+            }
+            for (int rc = 0; rc < REJECT_CODES; ++rc) {
+                rejects[rc] += thread->rejects_[rc].load(std::memory_order_relaxed);
+            }
+        }
+
+        auto nanos = NanosPerCycle();
+        out << "timing 1 in " << SampleRate() << " messages\n";
+        out << std::left << std::setw(10) << "stage" << std::right << std::setw(12) << "count"
+            << std::setw(9) << "mean" << std::setw(9) << "p50" << std::setw(9) << "p99"
+            << std::setw(9) << "p99.9" << std::setw(10) << "max" << "  (ns)\n";
+
+        for (int stage = 0; stage < STAGES; ++stage) {
+            const auto & histogram = merged[stage];
+            auto total = histogram.total_.load();
+            if (total == 0) {
+                continue;
+            }
+
+            auto percentile = [&histogram, total, nanos] (double q) {
+                auto target = static_cast<uint64_t>(q * static_cast<double>(total));
+                uint64_t seen{0};
+                for (int bucket = 0; bucket < Histogram::BUCKETS; ++bucket) {
+                    seen += histogram.counts_[bucket].load();
+                    if (seen > target) {
+                        return static_cast<double>(Histogram::Lowest(static_cast<std::size_t>(bucket))) * nanos;
+                    }
+                }
+                return static_cast<double>(histogram.max_.load()) * nanos;
+            };
+
+            out << std::left << std::setw(10) << StageName(stage) << std::right << std::setw(12) << total
+                << std::fixed << std::setprecision(0)
+                << std::setw(9) << static_cast<double>(histogram.sum_.load()) / static_cast<double>(total) * nanos
+                << std::setw(9) << percentile(0.5)
+                << std::setw(9) << percentile(0.99)
+                << std::setw(9) << percentile(0.999)
+                << std::setw(10) << static_cast<double>(histogram.max_.load()) * nanos << '\n';
+        }
+
+        for (int rc = 0; rc < REJECT_CODES; ++rc) {
+            if (rejects[rc]) {
+                out << "rejected " << RejectName(rc) << ": " << rejects[rc] << '\n';
+            }
+        }
+#endif
+    }
+
+    Reporter::Reporter(std::ostream & out, std::chrono::milliseconds interval) : out_(out), interval_(interval) {
+        thread_ = std::thread([this] {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!wake_.wait_for(lock, interval_, [this] { return stop_; })) {
+                Dump(out_);
+                out_.flush();
+            }
+        });
+    }
+
+    Reporter::~Reporter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_one();
+        thread_.join();
+    }
+
+} // namespace stats
+} // namespace orderbook
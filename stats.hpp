@@ -0,0 +1,201 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Hot path instrumentation, compiled in with ORDERBOOK_STATS. Each stage of applying an order is timed
+// in TSC cycles and recorded into histograms owned by the calling thread, so recording is a couple of
+// uncontended stores, and rejects are counted by error code. Reading the TSC costs more than some of the
+// stages it measures, so only one message in SampleRate() is timed; the rest pay for a thread local
+// check per stage. Every reject is counted. Without ORDERBOOK_STATS the macros expand to nothing.
+#ifdef ORDERBOOK_STATS
+#define OB_STATS_CONCAT_(a, b) a##b
+#define OB_STATS_CONCAT(a, b) OB_STATS_CONCAT_(a, b)
+#define OB_STATS_SAMPLE() ::orderbook::stats::SampleScope OB_STATS_CONCAT(obStatsSample, __LINE__)
+#define OB_STATS_TIMER(stage) ::orderbook::stats::ScopedTimer OB_STATS_CONCAT(obStatsTimer, __LINE__)(::orderbook::stats::stage)
+#define OB_STATS_REJECT(rc) ::orderbook::stats::Reject(rc)
+#else
+#define OB_STATS_SAMPLE() do {} while (0)
+#define OB_STATS_TIMER(stage) do {} while (0)
+#define OB_STATS_REJECT(rc) do {} while (0)
+#endif
+
+namespace orderbook {
+namespace stats {
+
+    enum Stage {
+        ADD,            // Whole of an add
+        MODIFY,         // Whole of a modify
+        DELETE,         // Whole of a delete
+        SECURITY,       // Resolving a SecurityID to an InstrumentID
+        ORDER,          // Finding a resting order by OrderID
+        LEVEL,          // Finding or creating a price level
+        QUEUE,          // Linking or unlinking an order in its level
+        MATCH,          // Sweeping the other side of the book with a crossing order
+        STAGES
+    };
+
+    constexpr int REJECT_CODES = 16;
+
+    inline uint64_t Cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+
+    // Log linear buckets in the style of an HDR histogram: 16 linear sub buckets per power of two,
+    // so any value is recorded to within 1/16th of itself, from 1 cycle up to 2^64
+    class Histogram {
+        public:
+            static constexpr int SUB_BITS = 4;
+            static constexpr int BUCKETS = 64 << SUB_BITS;
+
+            // Only the owning thread records, so plain loads and stores are enough
+            void Record(uint64_t value) {
+                auto & count = counts_[Bucket(value)];
+                count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                total_.store(total_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                sum_.store(sum_.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+                if (value > max_.load(std::memory_order_relaxed)) {
+                    max_.store(value, std::memory_order_relaxed);
+                }
+            }
+
+            static std::size_t Bucket(uint64_t value) {
+                if (value < (1u << SUB_BITS)) {
+                    return static_cast<std::size_t>(value);
+                }
+                auto msb = 63 - __builtin_clzll(value);
+                auto group = msb - SUB_BITS + 1;
+                auto sub = (value >> (msb - SUB_BITS)) & ((1u << SUB_BITS) - 1);
+                return (static_cast<std::size_t>(group) << SUB_BITS) + static_cast<std::size_t>(sub);
+            }
+
+            // The smallest value that falls in a bucket
+            static uint64_t Lowest(std::size_t bucket) {
+                auto group = bucket >> SUB_BITS;
+                auto sub = bucket & ((1u << SUB_BITS) - 1);
+                if (group == 0) {
+                    return sub;
+                }
+                return (uint64_t{(1u << SUB_BITS)} + sub) << (group - 1);
+            }
+
+            std::atomic<uint64_t> counts_[BUCKETS] = {};
+            std::atomic<uint64_t> total_{0};
+            std::atomic<uint64_t> sum_{0};
+            std::atomic<uint64_t> max_{0};
+    };
+
+    struct ThreadStats {
+        Histogram stages_[STAGES];
+        std::atomic<uint64_t> rejects_[REJECT_CODES] = {};
+        ThreadStats * next_{nullptr};
+        uint32_t countdown_{1};
+        uint32_t depth_{0};
+        bool sampling_{false};
+    };
+
+    ThreadStats * Register();
+
+    inline thread_local ThreadStats * current = nullptr;
+
+    // The calling thread's stats, registered on first use and kept for the life of the process
+    inline ThreadStats & Local() {
+        auto * local = current;
+        if (local == nullptr) {
+            local = current = Register();
+        }
+        return *local;
+    }
+
+    // Time one message in every rate, 1 times them all
+    void SetSampleRate(uint32_t rate);
+    uint32_t SampleRate();
+
+    // Decides whether the message being applied is timed, only the outermost scope on a thread counts
+    class SampleScope {
+        public:
+            SampleScope() : stats_(Local()) {
+                if (stats_.depth_++ == 0 && --stats_.countdown_ == 0) {
+                    stats_.countdown_ = SampleRate();
+                    stats_.sampling_ = true;
+                }
+            }
+
+            ~SampleScope() {
+                if (--stats_.depth_ == 0) {
+                    stats_.sampling_ = false;
+                }
+            }
+
+        private:
+            ThreadStats & stats_;
+    };
+
+    inline void Reject(int rc) {
+        if (rc != 0) {
+            auto & count = Local().rejects_[(rc > 0 && rc < REJECT_CODES) ? rc : 0];
+            count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+
+    // Out of line so an unsampled timer is a load and a branch
+    void Record(ThreadStats & stats, Stage stage, uint64_t start);
+
+    class ScopedTimer {
+        public:
+            explicit ScopedTimer(Stage stage) : stats_(current), stage_(stage) {
+                if (__builtin_expect(stats_ != nullptr && stats_->sampling_, 0)) {
+                    start_ = Cycles();
+                } else {
+                    stats_ = nullptr;
+                }
+            }
+
+            ~ScopedTimer() {
+                if (__builtin_expect(stats_ != nullptr, 0)) {
+                    Record(*stats_, stage_, start_);
+                }
+            }
+
+        private:
+            ThreadStats * stats_;
+            Stage stage_;
+            uint64_t start_{0};
+    };
+
+    // Summaries across every thread, latencies converted to nanoseconds
+    void Dump(std::ostream & out);
+
+    // Writes Dump to a stream at a fixed interval from a background thread until destroyed
+    class Reporter {
+        public:
+            Reporter(std::ostream & out, std::chrono::milliseconds interval);
+            ~Reporter();
+
+            Reporter(const Reporter &) = delete;
+            Reporter & operator=(const Reporter &) = delete;
+
+        private:
+            std::ostream & out_;
+            std::chrono::milliseconds interval_;
+            std::mutex mutex_;
+            std::condition_variable wake_;
+            bool stop_{false};
+            std::thread thread_;
+    };
+
+} // namespace stats
+} // namespace orderbook
@@ -0,0 +1,57 @@
+#include <fstream>
+#include <iostream>
+
+#include "orderbook.hpp"
+#include "symbols.hpp"
+
+namespace orderbook {
+
+    void SymbolRegistry::Reserve(std::size_t size) {
+        symbols_.reserve(size);
+
+        std::size_t capacity = 1024;
+        while (capacity < size * 2) {
+            capacity *= 2;
+        }
+        if (capacity > table_.size()) {
+            Rehash(capacity);
+        }
+    }
+
+    int SymbolRegistry::Load(const std::string & path) {
+        std::ifstream master(path);
+        if (!master) {
+            std::cerr<<"Could not open securities master "<<path<<'\n';
+            return ERR_IO;
+        }
+
+        std::string line;
+        while (std::getline(master, line)) {
+            auto end = line.find_first_of(",\r");
+            auto symbol = line.substr(0, end);
+            if (symbol.empty() || symbol[0] == '#') {
+                continue;
+            }
+            if (Intern(symbol) == NO_INSTRUMENT) {
+                std::cerr<<"Invalid SecurityID ["<<symbol<<"] in securities master "<<path<<'\n';
+            }
+        }
+
+        return SUCCESS;
+    }
+
+    void SymbolRegistry::Rehash(std::size_t capacity) {
+        table_.assign(capacity, NO_INSTRUMENT);
+        mask_ = capacity - 1;
+        shift_ = 64 - static_cast<unsigned>(__builtin_ctzll(capacity));
+
+        for (InstrumentID id = 0; id < symbols_.size(); ++id) {
+            auto pos = Home(symbols_[id]);
+            while (table_[pos] != NO_INSTRUMENT) {
+                pos = (pos + 1) & mask_;
+            }
+            table_[pos] = id;
+        }
+    }
+
+} // namespace orderbook
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "compact.hpp"
+
+namespace orderbook {
+
+    // Securities are numbered densely from zero in the order they are first seen
+    using InstrumentID = uint32_t;
+    constexpr InstrumentID NO_INSTRUMENT = UINT32_MAX;
+
+    // Interns security ids such as ISINs into InstrumentIDs. Each symbol is stored as a fixed 16 byte
+    // key, so hashing and comparing one is a couple of word loads, and the hash table is a flat array
+    // of InstrumentIDs rather than a bucket of nodes per symbol.
+    class SymbolRegistry {
+        public:
+            static constexpr std::size_t SYMBOL_LEN = 16;
+            static_assert(compact::ID_LEN <= SYMBOL_LEN, "A compact security id must fit in a symbol key");
+
+            void Reserve(std::size_t size);
+
+            // Load a securities master file, one security per line, the id being the first comma separated field
+            int Load(const std::string & path);
+
+            InstrumentID Find(const char * symbol, std::size_t length) const {
+                Key key;
+                if (!MakeKey(symbol, length, key) || table_.empty()) {
+                    return NO_INSTRUMENT;
+                }
+                for (auto pos = Home(key); ; pos = (pos + 1) & mask_) {
+                    auto id = table_[pos];
+                    if (id == NO_INSTRUMENT || symbols_[id] == key) {
+                        return id;
+                    }
+                }
+            }
+
+            InstrumentID Find(const std::string & symbol) const {
+                return Find(symbol.data(), symbol.size());
+            }
+
+            // The id for a symbol, registering it if it hasn't been seen before
+            InstrumentID Intern(const char * symbol, std::size_t length) {
+                Key key;
+                if (!MakeKey(symbol, length, key)) {
+                    return NO_INSTRUMENT;
+                }
+                if ((symbols_.size() + 1) * 2 > table_.size()) {
+                    Rehash(table_.empty() ? 1024 : table_.size() * 2);
+                }
+                for (auto pos = Home(key); ; pos = (pos + 1) & mask_) {
+                    auto & id = table_[pos];
+                    if (id == NO_INSTRUMENT) {
+                        id = static_cast<InstrumentID>(symbols_.size());
+                        symbols_.push_back(key);
+                        return id;
+                    }
+                    if (symbols_[id] == key) {
+                        return id;
+                    }
+                }
+            }
+
+            InstrumentID Intern(const std::string & symbol) {
+                return Intern(symbol.data(), symbol.size());
+            }
+
+            std::string Symbol(InstrumentID id) const {
+                const auto & key = symbols_[id];
+                return std::string(key.symbol_, strnlen(key.symbol_, SYMBOL_LEN));
+            }
+
+            // The zero padded SYMBOL_LEN byte key, not necessarily terminated
+            const char * Data(InstrumentID id) const {
+                return symbols_[id].symbol_;
+            }
+
+            std::size_t Size() const { return symbols_.size(); }
+            std::size_t Bytes() const { return symbols_.capacity() * sizeof(Key) + table_.capacity() * sizeof(InstrumentID); }
+
+        private:
+            struct Key {
+                union {
+                    char symbol_[SYMBOL_LEN];
+                    uint64_t words_[2];
+                };
+
+                bool operator==(const Key & rhs) const {
+                    return words_[0] == rhs.words_[0] && words_[1] == rhs.words_[1];
+                }
+            };
+
+            // Symbols are zero padded to the key length, ids longer than a key can't be held
+            static bool MakeKey(const char * symbol, std::size_t length, Key & key) {
+                length = strnlen(symbol, length);
+                if (length == 0 || length > SYMBOL_LEN) {
+                    return false;
+                }
+                key.words_[0] = key.words_[1] = 0;
+                std::memcpy(key.symbol_, symbol, length);
+                return true;
+            }
+
+            std::size_t Home(const Key & key) const {
+                auto hash = (key.words_[0] ^ (key.words_[1] * 0xC2B2AE3D27D4EB4Full)) * 0x9E3779B97F4A7C15ull;
+                return static_cast<std::size_t>(hash >> shift_);
+            }
+
+            void Rehash(std::size_t capacity);
+
+            std::vector<Key> symbols_;
+            std::vector<InstrumentID> table_;
+            std::size_t mask_{0};
+            unsigned shift_{64};
+    };
+
+} // namespace orderbook
@@ -0,0 +1,534 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+
+#include "text.hpp"
+
+namespace text {
+
+    namespace {
+
+        constexpr std::size_t BLOCK = 64;
+        constexpr std::size_t RECORDS = 1024;                  // Records parsed before they are applied as a batch
+        constexpr std::size_t READ_SIZE = std::size_t{4} << 20;
+
+        constexpr int Decimals(int_fast64_t ticks) {
+            return ticks > 1 ? 1 + Decimals(ticks / 10) : 0;
+        }
+
+        constexpr int_fast64_t Power(int decimals) {
+            return decimals ? 10 * Power(decimals - 1) : 1;
+        }
+
+        // Prices are read as decimals, so a tick has to be a whole number of decimal places
+        constexpr int DECIMALS = Decimals(orderbook::TICKS_PER_UNIT);
+        static_assert(Power(DECIMALS) == orderbook::TICKS_PER_UNIT, "Text prices need a decimal tick");
+
+        // FIX tags the parser reads, as their bit in the tags seen on a line
+        enum Tag : uint32_t {
+            MSG_TYPE = 1 << 0, CL_ORD_ID = 1 << 1, ORIG_CL_ORD_ID = 1 << 2, SIDE = 1 << 3,
+            ORD_TYPE = 1 << 4, SYMBOL = 1 << 5, PRICE = 1 << 6, ORDER_QTY = 1 << 7
+        };
+
+        constexpr uint32_t CSV_FIELDS = 7;
+
+        // A bit for each byte of the block that is a newline, the separator or the alternate separator
+        uint64_t MaskScalar(const char * block, char separator, char alternate) {
+            uint64_t bits{0};
+            for (std::size_t i = 0; i < BLOCK; ++i) {
+                auto c = block[i];
+                bits |= static_cast<uint64_t>(c == '\n' || c == separator || c == alternate) << i;
+            }
+            return bits;
+        }
+
+#ifdef ORDERBOOK_X86
+
+        __attribute__((target("sse4.2")))
+        uint64_t MaskSse(const char * block, char separator, char alternate) {
+            auto newline = _mm_set1_epi8('\n');
+            auto first = _mm_set1_epi8(separator);
+            auto second = _mm_set1_epi8(alternate);
+            uint64_t bits{0};
+            for (std::size_t i = 0; i < BLOCK; i += 16) {
+                auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + i));
+                auto hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, newline), _mm_cmpeq_epi8(bytes, first)), _mm_cmpeq_epi8(bytes, second));
+                bits |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(hit))) << i;
+            }
+            return bits;
+        }
+
+        __attribute__((target("avx2")))
+        uint64_t MaskAvx2(const char * block, char separator, char alternate) {
+            auto newline = _mm256_set1_epi8('\n');
+            auto first = _mm256_set1_epi8(separator);
+            auto second = _mm256_set1_epi8(alternate);
+            uint64_t bits{0};
+            for (std::size_t i = 0; i < BLOCK; i += 32) {
+                auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + i));
+                auto hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, newline), _mm256_cmpeq_epi8(bytes, first)), _mm256_cmpeq_epi8(bytes, second));
+                bits |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hit))) << i;
+            }
+            _mm256_zeroupper();
+            return bits;
+        }
+
+#endif
+
+        struct Kernels {
+            Isa isa_;
+            uint64_t (*mask_)(const char *, char, char);
+        };
+
+        Kernels Select(Isa isa) {
+#ifdef ORDERBOOK_X86
+            switch (isa) {
+                case Isa::AVX2: return Kernels{isa, MaskAvx2};
+                case Isa::SSE42: return Kernels{isa, MaskSse};
+                case Isa::SCALAR: break;
+            }
+#endif
+            return Kernels{Isa::SCALAR, MaskScalar};
+        }
+
+        orderbook::simd::Dispatch<Kernels, Select> active;
+
+        // Unsigned decimal digits, an empty field being 0
+        bool ParseInt(const char * p, const char * end, int64_t & value) {
+            value = 0;
+            if (end - p > 18) {
+                return false;
+            }
+            for (; p != end; ++p) {
+                auto digit = static_cast<unsigned>(static_cast<unsigned char>(*p) - '0');
+                if (digit > 9) {
+                    return false;
+                }
+                value = value * 10 + digit;
+            }
+            return true;
+        }
+
+        // A decimal price straight to ticks, rounding half away from zero as ToTick does
+        bool ParsePrice(const char * p, const char * end, int64_t & ticks) {
+            auto negative = p != end && *p == '-';
+            p += negative;
+            auto point = std::find(p, end, '.');
+            int64_t whole, fraction{0};
+            // Garbage with a long whole part would overflow once scaled to ticks
+            if (!ParseInt(p, point, whole) || whole > std::numeric_limits<int64_t>::max() / orderbook::TICKS_PER_UNIT - 1) {
+                return false;
+            }
+            int decimals{0};
+            bool up{false};
+            for (auto digit = point + (point != end); digit != end; ++digit) {
+                auto value = static_cast<unsigned>(static_cast<unsigned char>(*digit) - '0');
+                if (value > 9) {
+                    return false;
+                }
+                if (decimals < DECIMALS) {
+                    fraction = fraction * 10 + value;
+                    ++decimals;
+                } else if (decimals++ == DECIMALS) {
+                    up = value >= 5;
+                }
+            }
+            for (; decimals < DECIMALS; ++decimals) {
+                fraction *= 10;
+            }
+            ticks = whole * orderbook::TICKS_PER_UNIT + fraction + up;
+            ticks = negative ? -ticks : ticks;
+            return true;
+        }
+
+        bool ParseSymbol(const char * begin, const char * end, char * symbol) {
+            auto length = static_cast<std::size_t>(end - begin);
+            if (length >= compact::ID_LEN) {
+                return false;
+            }
+            std::memcpy(symbol, begin, length);
+            return true;
+        }
+
+        int FormatPrice(char * out, std::size_t size, orderbook::Tick ticks) {
+            auto magnitude = ticks < 0 ? -ticks : ticks;
+            return std::snprintf(out, size, "%s%" PRIdFAST64 ".%0*" PRIdFAST64, ticks < 0 ? "-" : "", magnitude / orderbook::TICKS_PER_UNIT,
+                                 DECIMALS, magnitude % orderbook::TICKS_PER_UNIT);
+        }
+
+    } // namespace
+
+    Isa Active() {
+        return active.Active();
+    }
+
+    bool Use(Isa isa) {
+        return active.Use(isa);
+    }
+
+    std::size_t Parser::Parse(const char * data, std::size_t size, wire::Record * records, std::size_t capacity, std::size_t & count, bool last) {
+        count = 0;
+        if (format_ == Format::AUTO) {
+            const auto * first = std::find_if(data, data + size, [] (char c) { return c == '=' || c == ','; });
+            if (first == data + size && !last) {
+                return 0;
+            }
+            format_ = first != data + size && *first == '=' ? Format::FIX : Format::CSV;
+        }
+        auto separator = format_ == Format::FIX ? '\x01' : ',';
+        auto alternate = format_ == Format::FIX ? '|' : ',';
+
+        // Every call starts on a line, whatever was left of one last time is parsed again
+        record_ = wire::Record{};
+        fields_ = seen_ = 0;
+        skip_ = bad_ = false;
+
+        std::size_t line{0}, field{0};
+        for (std::size_t block = 0; block < size; block += BLOCK) {
+            uint64_t bits;
+            if (size - block >= BLOCK) {
+                bits = active->mask_(data + block, separator, alternate);
+            } else {
+                // The tail is padded with NULs, which are never a delimiter
+                char tail[BLOCK] = {};
+                std::memcpy(tail, data + block, size - block);
+                bits = active->mask_(tail, separator, alternate);
+            }
+
+            while (bits) {
+                auto pos = block + static_cast<std::size_t>(__builtin_ctzll(bits));
+                bits &= bits - 1;
+                Field(data + field, data + pos);
+                field = pos + 1;
+                if (data[pos] == '\n') {
+                    count += End(records[count]);
+                    line = field;
+                    if (count == capacity) {
+                        return line;
+                    }
+                }
+            }
+        }
+
+        if (last && line < size) {
+            Field(data + field, data + size);
+            count += End(records[count]);
+            line = size;
+        }
+        return line;
+    }
+
+    void Parser::Field(const char * begin, const char * end) {
+        if (end != begin && end[-1] == '\r') {
+            --end;
+        }
+        if (format_ == Format::FIX) {
+            FixField(begin, end);
+        } else {
+            CsvField(begin, end);
+        }
+    }
+
+    void Parser::CsvField(const char * begin, const char * end) {
+        if (skip_ || bad_) {
+            return;
+        }
+        int64_t value;
+        switch (fields_++) {
+            case 0:
+                if (begin == end || static_cast<unsigned>(static_cast<unsigned char>(*begin) - '0') > 9) {
+                    skip_ = true;
+                    return;
+                }
+                bad_ = !ParseInt(begin, end, value);
+                record_.OrderID_ = value;
+                break;
+            case 1:
+                switch (begin != end ? *begin : '\0') {
+                    case 'A': record_.OrderAction_ = compact::ORDER_ACTION_ADD; break;
+                    case 'M': record_.OrderAction_ = compact::ORDER_ACTION_MODIFY; break;
+                    case 'D': record_.OrderAction_ = compact::ORDER_ACTION_DELETE; break;
+                    default: bad_ = true; break;
+                }
+                break;
+            case 2:
+                switch (begin != end ? *begin : 'B') {
+                    case 'B': record_.OrderDirection_ = compact::ORDER_DIRECTION_BUY; break;
+                    case 'S': record_.OrderDirection_ = compact::ORDER_DIRECTION_SELL; break;
+                    default: bad_ = true; break;
+                }
+                break;
+            case 3:
+                switch (begin != end ? *begin : 'L') {
+                    case 'L': record_.OrderConstraints_ = compact::ORDER_CONSTRAINT_LIMIT; break;
+                    case 'M': record_.OrderConstraints_ = compact::ORDER_CONSTRAINT_MARKET; break;
+                    default: bad_ = true; break;
+                }
+                break;
+            case 4:
+                bad_ = !ParseSymbol(begin, end, record_.SecurityID_);
+                break;
+            case 5:
+                bad_ = !ParsePrice(begin, end, value);
+                record_.Price_ = value;
+                break;
+            case 6:
+                bad_ = !ParseInt(begin, end, value);
+                record_.Volume_ = value;
+                break;
+            default:
+                bad_ = true;
+                break;
+        }
+    }
+
+    void Parser::FixField(const char * begin, const char * end) {
+        if (begin == end || bad_) {
+            return;
+        }
+        ++fields_;
+        auto equals = std::find(begin, end, '=');
+        int64_t tag;
+        if (equals == end || equals == begin || !ParseInt(begin, equals, tag)) {
+            bad_ = true;
+            return;
+        }
+        auto value = equals + 1;
+        int64_t number{0};
+        switch (tag) {
+            case 35:
+                seen_ |= MSG_TYPE;
+                switch (value != end ? *value : '\0') {
+                    case 'D': record_.OrderAction_ = compact::ORDER_ACTION_ADD; break;
+                    case 'G': record_.OrderAction_ = compact::ORDER_ACTION_MODIFY; break;
+                    case 'F': record_.OrderAction_ = compact::ORDER_ACTION_DELETE; break;
+                    default: bad_ = true; break;
+                }
+                break;
+            case 11:
+                seen_ |= CL_ORD_ID;
+                bad_ = value == end || !ParseInt(value, end, clOrdID_);
+                break;
+            case 41:
+                seen_ |= ORIG_CL_ORD_ID;
+                bad_ = value == end || !ParseInt(value, end, number);
+                record_.OrderID_ = number;
+                break;
+            case 54:
+                seen_ |= SIDE;
+                switch (value != end ? *value : '\0') {
+                    case '1': record_.OrderDirection_ = compact::ORDER_DIRECTION_BUY; break;
+                    case '2': record_.OrderDirection_ = compact::ORDER_DIRECTION_SELL; break;
+                    default: bad_ = true; break;
+                }
+                break;
+            case 40:
+                seen_ |= ORD_TYPE;
+                switch (value != end ? *value : '\0') {
+                    case '1': record_.OrderConstraints_ = compact::ORDER_CONSTRAINT_MARKET; break;
+                    case '2': record_.OrderConstraints_ = compact::ORDER_CONSTRAINT_LIMIT; break;
+                    default: bad_ = true; break;
+                }
+                break;
+            case 55:
+                seen_ |= SYMBOL;
+                bad_ = !ParseSymbol(value, end, record_.SecurityID_);
+                break;
+            case 44:
+                seen_ |= PRICE;
+                bad_ = !ParsePrice(value, end, number);
+                record_.Price_ = number;
+                break;
+            case 38:
+                seen_ |= ORDER_QTY;
+                bad_ = !ParseInt(value, end, number);
+                record_.Volume_ = number;
+                break;
+            default:
+                break;
+        }
+    }
+
+    bool Parser::End(wire::Record & record) {
+        // Blank lines aren't counted, and neither are the CSV lines that are skipped
+        auto blank = fields_ == 0 || (format_ == Format::CSV && skip_);
+        bool held{false};
+        if (!blank) {
+            ++stats_.lines_;
+            if (format_ == Format::FIX && !(seen_ & ORIG_CL_ORD_ID)) {
+                record_.OrderID_ = clOrdID_;
+            }
+            auto whole = format_ == Format::FIX ? (seen_ & MSG_TYPE) && (seen_ & (CL_ORD_ID | ORIG_CL_ORD_ID)) : fields_ == CSV_FIELDS;
+            if (bad_ || !whole) {
+                ++stats_.malformed_;
+            } else {
+                record = record_;
+                ++stats_.orders_;
+                held = true;
+            }
+        }
+
+        record_ = wire::Record{};
+        fields_ = seen_ = 0;
+        skip_ = bad_ = false;
+        return held;
+    }
+
+    int Read(const std::string & path, LoadStats & stats, const std::function<void(const wire::Record *, std::size_t)> & batch, Format format, bool map) {
+        auto start = std::chrono::steady_clock::now();
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr<<"Could not open order file "<<path<<'\n';
+            return orderbook::ERR_IO;
+        }
+
+        Parser parser(format);
+        std::vector<wire::Record> records(RECORDS);
+        auto apply = [&records, &batch] (std::size_t count) {
+            if (count) {
+                batch(records.data(), count);
+            }
+        };
+
+        auto rc = orderbook::SUCCESS;
+        std::size_t count;
+        if (map) {
+            struct stat info;
+            if (::fstat(fd, &info) != 0) {
+                ::close(fd);
+                std::cerr<<"Could not read order file "<<path<<'\n';
+                return orderbook::ERR_IO;
+            }
+            auto size = static_cast<std::size_t>(info.st_size);
+            void * data = size ? ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0) : nullptr;
+            if (data == MAP_FAILED) {
+                ::close(fd);
+                std::cerr<<"Could not map order file "<<path<<'\n';
+                return orderbook::ERR_IO;
+            }
+            if (size) {
+                ::madvise(data, size, MADV_SEQUENTIAL);
+            }
+            const auto * text = static_cast<const char *>(data);
+            for (std::size_t offset = 0; offset < size; ) {
+                offset += parser.Parse(text + offset, size - offset, records.data(), RECORDS, count, true);
+                apply(count);
+            }
+            if (size) {
+                ::munmap(data, size);
+            }
+            stats.bytes_ += size;
+        } else {
+            // Large sequential reads, with whatever is left of a line carried to the front of the buffer
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            std::vector<char> buffer(READ_SIZE);
+            std::size_t held{0};
+            bool eof{false};
+            while (!eof) {
+                if (held == buffer.size()) {
+                    buffer.resize(buffer.size() * 2);   // A line longer than the buffer
+                }
+                auto bytes = ::read(fd, buffer.data() + held, buffer.size() - held);
+                if (bytes < 0) {
+                    std::cerr<<"Could not read order file "<<path<<'\n';
+                    rc = orderbook::ERR_IO;
+                    break;
+                }
+                eof = bytes == 0;
+                held += static_cast<std::size_t>(bytes);
+                stats.bytes_ += static_cast<std::size_t>(bytes);
+
+                std::size_t offset{0};
+                do {
+                    offset += parser.Parse(buffer.data() + offset, held - offset, records.data(), RECORDS, count, eof);
+                    apply(count);
+                } while (count == RECORDS);
+                std::memmove(buffer.data(), buffer.data() + offset, held - offset);
+                held -= offset;
+            }
+        }
+        ::close(fd);
+
+        stats.malformed_ += parser.Stats().malformed_;
+        stats.seconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return rc;
+    }
+
+    int Load(const std::string & path, orderbook::Implementation & book, LoadStats & stats, Format format, bool map) {
+        std::vector<orderbook::Message> messages(RECORDS);
+
+        // Consecutive orders are often for the same security, so skip the symbol lookup when it repeats
+        char lastSymbol[compact::ID_LEN] = {};
+        orderbook::InstrumentID instrument{orderbook::NO_INSTRUMENT};
+        return Read(path, stats, [&] (const wire::Record * records, std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) {
+                const auto & record = records[i];
+                if (instrument == orderbook::NO_INSTRUMENT || std::memcmp(lastSymbol, record.SecurityID_, compact::ID_LEN) != 0) {
+                    instrument = book.Register(record.SecurityID_, compact::ID_LEN);
+                    std::memcpy(lastSymbol, record.SecurityID_, compact::ID_LEN);
+                }
+                messages[i] = wire::Decode(record, instrument);
+            }
+            stats.rejected_ += book.ProcessBatch(messages.data(), count, nullptr);
+            stats.messages_ += count;
+        }, format, map);
+    }
+
+    bool IsTextFile(const std::string & path) {
+        auto dot = path.find_last_of('.');
+        auto extension = dot == std::string::npos ? std::string() : path.substr(dot);
+        return extension == ".csv" || extension == ".fix" || extension == ".txt";
+    }
+
+    int Write(const std::string & path, const std::vector<orderbook::Order> & orders, Format format) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cerr<<"Could not create order file "<<path<<'\n';
+            return orderbook::ERR_IO;
+        }
+
+        static const char * actions[] = {"Add", "Modify", "Delete"};
+        static const char * directions[] = {"BUY", "SELL"};
+        static const char * constraints[] = {"LIMIT", "MARKET"};
+        static const char types[] = {'D', 'G', 'F'};
+        char price[32];
+        char line[256];
+        if (format != Format::FIX) {
+            file<<"OrderID,Action,Direction,Constraints,SecurityID,Price,Volume\n";
+        }
+        for (const auto & order : orders) {
+            FormatPrice(price, sizeof(price), orderbook::ToTick(order.Price_));
+            auto action = static_cast<std::size_t>(order.OrderAction_);
+            auto direction = static_cast<std::size_t>(order.OrderDirection_);
+            auto constraint = static_cast<std::size_t>(order.OrderConstraints_);
+            int length;
+            if (format == Format::FIX) {
+                length = std::snprintf(line, sizeof(line), "35=%c\x01" "11=%" PRIdFAST64 "\x01" "54=%c\x01" "40=%c\x01" "55=%s\x01" "44=%s\x01" "38=%" PRIdFAST64 "\n",
+                                       types[action], order.OrderID_, direction ? '2' : '1', constraint ? '1' : '2', order.SecurityID_.c_str(), price, order.Volume_);
+            } else {
+                length = std::snprintf(line, sizeof(line), "%" PRIdFAST64 ",%s,%s,%s,%s,%s,%" PRIdFAST64 "\n",
+                                       order.OrderID_, actions[action], directions[direction], constraints[constraint], order.SecurityID_.c_str(), price, order.Volume_);
+            }
+            file.write(line, std::min<int>(length, static_cast<int>(sizeof(line)) - 1));
+        }
+
+        if (!file) {
+            std::cerr<<"Could not write order file "<<path<<'\n';
+            return orderbook::ERR_IO;
+        }
+        return orderbook::SUCCESS;
+    }
+
+} // namespace text
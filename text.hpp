@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "orderbook.hpp"
+#include "simd.hpp"
+#include "wire.hpp"
+
+namespace text {
+
+    // Order files as delimited text, one order a line. A CSV line is
+    //   OrderID,Action,Direction,Constraints,SecurityID,Price,Volume
+    // with the action Add/Modify/Delete, the direction BUY/SELL and the constraints LIMIT/MARKET, of
+    // which only the first letter is read. Lines that don't start with a digit, such as a header, are
+    // skipped. A FIX line is tag=value fields separated by SOH or '|': 35 MsgType (D add, G modify,
+    // F delete), 11 ClOrdID, 41 OrigClOrdID, which names the order a modify or delete is for when
+    // present, 54 Side (1 buy, 2 sell), 40 OrdType (1 market, 2 limit, the default), 55 Symbol,
+    // 44 Price and 38 OrderQty. Other tags are ignored. In both, fields other than the order id and
+    // action may be empty, and prices are read to the nearest tick.
+    enum class Format : uint8_t {
+        AUTO, CSV, FIX
+    };
+
+    // The delimiter search runs on whichever simd::Isa is active, the widest supported to start with
+    using Isa = orderbook::simd::Isa;
+
+    Isa Active();
+    bool Use(Isa isa);
+
+    struct ParseStats {
+        std::size_t lines_{0};
+        std::size_t orders_{0};
+        std::size_t malformed_{0};
+    };
+
+    // Parses whole lines of text into capture Records, with prices straight to ticks and security ids
+    // into the record's fixed buffer, so nothing is allocated per line. Newlines and field separators
+    // are found a 64 byte block at a time with vector compares, and each field is parsed in place.
+    // AUTO settles on FIX if the first line has an '=' before any ',', and CSV otherwise.
+    class Parser {
+        public:
+            explicit Parser(Format format = Format::AUTO) : format_(format) {}
+
+            // Parses the whole lines at the front of data into at most capacity records, returning the
+            // bytes consumed, which end on a line. A last line with no newline is only parsed if last.
+            std::size_t Parse(const char * data, std::size_t size, wire::Record * records, std::size_t capacity, std::size_t & count, bool last = false);
+
+            Format Detected() const { return format_; }
+            const ParseStats & Stats() const { return stats_; }
+
+        private:
+            void Field(const char * begin, const char * end);
+            void CsvField(const char * begin, const char * end);
+            void FixField(const char * begin, const char * end);
+            // Finishes the line, true if it held an order
+            bool End(wire::Record & record);
+
+            Format format_;
+            ParseStats stats_;
+
+            // The line being parsed
+            wire::Record record_{};
+            uint32_t fields_{0};
+            uint32_t seen_{0};      // CSV fields or FIX tags found, as a bit each
+            bool skip_{false};
+            bool bad_{false};
+            int64_t clOrdID_{0};
+    };
+
+    struct LoadStats {
+        std::size_t messages_{0};
+        std::size_t rejected_{0};
+        std::size_t malformed_{0};
+        std::size_t bytes_{0};
+        double seconds_{0.0};
+    };
+
+    // Parses a text file, reading it in large sequential blocks or, with map, through a read only
+    // mapping, and hands batch the records a block at a time
+    int Read(const std::string & path, LoadStats & stats, const std::function<void(const wire::Record *, std::size_t)> & batch,
+             Format format = Format::AUTO, bool map = false);
+
+    // Applies every order in a text file to the book, as Read parses it
+    int Load(const std::string & path, orderbook::Implementation & book, LoadStats & stats, Format format = Format::AUTO, bool map = false);
+
+    // Whether a file is named as text orders, .csv, .fix or .txt, rather than a capture
+    bool IsTextFile(const std::string & path);
+
+    // Writes orders as CSV, or as FIX with SOH separators
+    int Write(const std::string & path, const std::vector<orderbook::Order> & orders, Format format);
+
+} // namespace text
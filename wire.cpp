@@ -0,0 +1,162 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "wire.hpp"
+
+namespace wire {
+
+    Record Encode(const orderbook::Order & order) {
+        Record record{};
+        record.OrderID_ = order.OrderID_;
+        record.Price_ = orderbook::ToTick(order.Price_);
+        record.Volume_ = order.Volume_;
+        std::strncpy(record.SecurityID_, order.SecurityID_.c_str(), compact::ID_LEN - 1);
+        record.OrderAction_ = static_cast<uint8_t>(compact::ORDER_ACTION_ADD + static_cast<uint8_t>(order.OrderAction_));
+        record.OrderDirection_ = static_cast<uint8_t>(order.OrderDirection_);
+        record.OrderConstraints_ = static_cast<uint8_t>(order.OrderConstraints_);
+        return record;
+    }
+
+    int Write(const std::string & path, const std::vector<orderbook::Order> & orders) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cerr<<"Could not create capture file "<<path<<'\n';
+            return orderbook::ERR_IO;
+        }
+
+        FileHeader header{};
+        std::memcpy(header.magic_, MAGIC, sizeof(MAGIC));
+        header.version_ = VERSION;
+        header.recordSize_ = sizeof(Record);
+        header.count_ = orders.size();
+        header.ticksPerUnit_ = orderbook::TICKS_PER_UNIT;
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+        for (const auto & order : orders) {
+            auto record = Encode(order);
+            file.write(reinterpret_cast<const char *>(&record), sizeof(record));
+        }
+
+        if (!file) {
+            std::cerr<<"Could not write capture file "<<path<<'\n';
+            return orderbook::ERR_IO;
+        }
+        return orderbook::SUCCESS;
+    }
+
+    MappedFile::~MappedFile() {
+        Close();
+    }
+
+    int Check(const FileHeader & header, std::size_t size, const std::string & path) {
+        if (std::memcmp(header.magic_, MAGIC, sizeof(MAGIC)) != 0 || header.version_ != VERSION || header.recordSize_ != sizeof(Record)) {
+            std::cerr<<"Capture file "<<path<<" has an unsupported format\n";
+            return orderbook::ERR_IO;
+        }
+        if (header.ticksPerUnit_ != orderbook::TICKS_PER_UNIT) {
+            std::cerr<<"Capture file "<<path<<" has prices in "<<header.ticksPerUnit_<<" ticks per unit, expected "<<orderbook::TICKS_PER_UNIT<<'\n';
+            return orderbook::ERR_IO;
+        }
+        if (header.count_ > (size - sizeof(FileHeader)) / sizeof(Record)) {
+            std::cerr<<"Capture file "<<path<<" is truncated\n";
+            return orderbook::ERR_IO;
+        }
+        return orderbook::SUCCESS;
+    }
+
+    int MappedFile::Open(const std::string & path) {
+        Close();
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr<<"Could not open capture file "<<path<<'\n';
+            return orderbook::ERR_IO;
+        }
+
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(FileHeader)) {
+            ::close(fd);
+            std::cerr<<"Capture file "<<path<<" is too short\n";
+            return orderbook::ERR_IO;
+        }
+
+        size_ = static_cast<std::size_t>(info.st_size);
+        data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        ::close(fd);
+        if (data_ == MAP_FAILED) {
+            data_ = nullptr;
+            std::cerr<<"Could not map capture file "<<path<<'\n';
+            return orderbook::ERR_IO;
+        }
+        ::madvise(data_, size_, MADV_SEQUENTIAL);
+
+        const auto & header = *static_cast<const FileHeader *>(data_);
+        if (Check(header, size_, path) != orderbook::SUCCESS) {
+            Close();
+            return orderbook::ERR_IO;
+        }
+
+        records_ = reinterpret_cast<const Record *>(static_cast<const char *>(data_) + sizeof(FileHeader));
+        count_ = header.count_;
+        return orderbook::SUCCESS;
+    }
+
+    void MappedFile::Close() {
+        if (data_ != nullptr) {
+            ::munmap(data_, size_);
+        }
+        data_ = nullptr;
+        size_ = 0;
+        records_ = nullptr;
+        count_ = 0;
+    }
+
+    int Replay(const std::string & path, orderbook::Implementation & book, ReplayStats & stats) {
+        MappedFile file;
+        auto rc = file.Open(path);
+        if (rc != orderbook::SUCCESS) {
+            return rc;
+        }
+
+        Replay(file, 0, book, stats);
+        return orderbook::SUCCESS;
+    }
+
+    void Replay(const MappedFile & file, std::size_t first, orderbook::Implementation & book, ReplayStats & stats) {
+        auto start = std::chrono::steady_clock::now();
+
+        // Consecutive messages are often for the same security, so skip the symbol lookup when it repeats
+        const char * lastSymbol = nullptr;
+        orderbook::InstrumentID instrument{orderbook::NO_INSTRUMENT};
+
+        // Records are decoded a window at a time and applied as a batch, so the book can prefetch ahead
+        orderbook::Message messages[orderbook::Implementation::BATCH_WINDOW];
+        std::size_t pending{0};
+
+        const auto * records = file.Records();
+        for (std::size_t i = first; i < file.Count(); ++i) {
+            const auto & record = records[i];
+            if (lastSymbol == nullptr || std::memcmp(lastSymbol, record.SecurityID_, compact::ID_LEN) != 0) {
+                instrument = book.Register(record.SecurityID_, compact::ID_LEN);
+                lastSymbol = record.SecurityID_;
+            }
+            messages[pending++] = Decode(record, instrument);
+            if (pending == orderbook::Implementation::BATCH_WINDOW) {
+                stats.rejected_ += book.ProcessBatch(messages, pending, nullptr);
+                pending = 0;
+            }
+        }
+        stats.rejected_ += book.ProcessBatch(messages, pending, nullptr);
+
+        stats.messages_ += file.Count() > first ? file.Count() - first : 0;
+        stats.seconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+} // namespace wire
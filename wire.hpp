@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "compact.hpp"
+#include "orderbook.hpp"
+
+namespace wire {
+
+    // A capture file is a FileHeader followed by count_ fixed size Records. Records are naturally
+    // aligned, so a mapped file can be read in place without copying or parsing.
+    constexpr char MAGIC[8] = {'O', 'B', 'F', 'E', 'E', 'D', '\0', '\0'};
+    constexpr uint32_t VERSION = 1;
+
+    struct FileHeader {
+        char magic_[8];
+        uint32_t version_;
+        uint32_t recordSize_;
+        uint64_t count_;
+        int64_t ticksPerUnit_;      // Scale of Record::Price_, so files stay readable if the tick scale changes
+    };
+
+    // The compact::Order layout, with the price in fixed point ticks rather than a float
+    struct Record {
+        int64_t OrderID_;
+        int64_t Price_;
+        int64_t Volume_;
+        char SecurityID_[compact::ID_LEN];
+        uint8_t OrderAction_ : 2;
+        uint8_t OrderDirection_ : 1;
+        uint8_t OrderConstraints_ : 1;
+        uint8_t reserved_ : 4;
+        uint8_t padding_[2];
+    };
+
+    static_assert(sizeof(FileHeader) == 32, "FileHeader layout is part of the file format");
+    static_assert(sizeof(Record) == 40, "Record layout is part of the file format");
+
+    Record Encode(const orderbook::Order & order);
+
+    // Decode everything but the security, which the caller resolves to an InstrumentID
+    inline orderbook::Message Decode(const Record & record, orderbook::InstrumentID instrument) {
+        return orderbook::Message{
+            record.OrderID_,
+            static_cast<orderbook::OrderAction_t>(record.OrderAction_ - compact::ORDER_ACTION_ADD),
+            static_cast<orderbook::OrderDirection_t>(record.OrderDirection_),
+            static_cast<orderbook::OrderConstraints_t>(record.OrderConstraints_),
+            instrument,
+            record.Price_,
+            record.Volume_
+        };
+    }
+
+    // Convert orders to a capture file
+    int Write(const std::string & path, const std::vector<orderbook::Order> & orders);
+
+    // Whether a capture file of size bytes starting with header can be read by this build
+    int Check(const FileHeader & header, std::size_t size, const std::string & path);
+
+    // A read only mapping of a capture file
+    class MappedFile {
+        public:
+            MappedFile() = default;
+            ~MappedFile();
+
+            MappedFile(const MappedFile &) = delete;
+            MappedFile & operator=(const MappedFile &) = delete;
+
+            int Open(const std::string & path);
+            void Close();
+
+            const Record * Records() const { return records_; }
+            std::size_t Count() const { return count_; }
+
+        private:
+            void * data_{nullptr};
+            std::size_t size_{0};
+            const Record * records_{nullptr};
+            std::size_t count_{0};
+    };
+
+    struct ReplayStats {
+        std::size_t messages_{0};
+        std::size_t rejected_{0};
+        double seconds_{0.0};
+    };
+
+    // Map a capture file and apply every record to the book
+    int Replay(const std::string & path, orderbook::Implementation & book, ReplayStats & stats);
+    // Apply the records of an open capture file from first onwards
+    void Replay(const MappedFile & file, std::size_t first, orderbook::Implementation & book, ReplayStats & stats);
+
+} // namespace wire